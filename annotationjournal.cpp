@@ -0,0 +1,203 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDateTime>
+#include <QDebug>
+#include <QSettings>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+#include "annotationjournal.h"
+#include "streamposition.h"
+#include "masterclock.h"
+#include "metrics.h"
+
+// ---------------------------------------------------------------------
+
+AnnotationJournal::AnnotationJournal(QObject *parent)
+    : QThread(parent), policy(SyncBatch), directory_changed(false),
+      stopping(false)
+{
+    QSettings settings;
+    flush_ms = qMax(10, settings.value("annotations/flush_ms", 500).toInt());
+    QString p = settings.value("annotations/fsync", "batch").toString();
+    if (p == "never")
+        policy = SyncNever;
+    else if (p == "always")
+        policy = SyncAlways;
+}
+
+// ---------------------------------------------------------------------
+
+void AnnotationJournal::setDirectory(const QString &dir) {
+    QMutexLocker locker(&mutex);
+    // Lines queued until now still belong to the old meeting:
+    previous += pending;
+    pending.clear();
+    directory = dir;
+    directory_changed = true;
+    queued.wakeOne();
+}
+
+// ---------------------------------------------------------------------
+
+// Everything is stamped here, on the clicking thread, so the time and
+// the frame positions belong to the same instant.
+qint64 AnnotationJournal::add(const QString &type, int value) {
+    qint64 ns = MasterClock::nsecs();
+    QDateTime now =
+        QDateTime::fromMSecsSinceEpoch(MasterClock::toMSecsSinceEpoch(ns));
+
+    QString line = QString("%1 %2 %3 %4").arg(ns)
+        .arg(now.toString("yyyy-MM-dd'T'hh:mm:ss.zzz")).arg(type).arg(value);
+
+    QMap<QString, StreamPosition::Position> pos = StreamPosition::snapshot();
+    QMap<QString, StreamPosition::Position>::const_iterator it;
+    for (it = pos.constBegin(); it != pos.constEnd(); ++it)
+        line += QString(" %1=%2:%3:%4").arg(it.key()).arg(it.value().segment)
+            .arg(it.value().frame).arg((ns-it.value().t_ns)/1000000);
+    line += "\n";
+
+    QMutexLocker locker(&mutex);
+    pending += line.toUtf8();
+    if (policy == SyncAlways)
+        queued.wakeOne();
+    return ns;
+}
+
+// ---------------------------------------------------------------------
+
+// Called from the snapshot workers when a file has been committed
+void AnnotationJournal::addSnapshot(int camera, const QString &file) {
+    qint64 ns = MasterClock::nsecs();
+    QDateTime now =
+        QDateTime::fromMSecsSinceEpoch(MasterClock::toMSecsSinceEpoch(ns));
+
+    QString line = QString("%1 %2 snapshot %3 file=%4\n").arg(ns)
+        .arg(now.toString("yyyy-MM-dd'T'hh:mm:ss.zzz")).arg(camera)
+        .arg(file);
+
+    QMutexLocker locker(&mutex);
+    pending += line.toUtf8();
+    if (policy == SyncAlways)
+        queued.wakeOne();
+}
+
+// ---------------------------------------------------------------------
+
+void AnnotationJournal::breakLoop() {
+    QMutexLocker locker(&mutex);
+    stopping = true;
+    queued.wakeOne();
+}
+
+// ---------------------------------------------------------------------
+
+void AnnotationJournal::reopen(const QString &dir) {
+    if (file.isOpen()) {
+        sync();
+        file.close();
+    }
+    if (dir.isEmpty())
+        return;
+
+    file.setFileName(dir+"/annotations.txt");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append |
+                   QIODevice::Text)) {
+        qWarning() << "WARNING: Failed to open" << file.fileName();
+        return;
+    }
+    if (file.size() == 0)
+        file.write("# master_ns wallclock type value "
+                   "[stream=segment:frame:age_ms ...]\n");
+}
+
+// ---------------------------------------------------------------------
+
+void AnnotationJournal::sync() {
+    file.flush();
+#ifdef Q_OS_UNIX
+    if (policy != SyncNever)
+        fdatasync(file.handle());
+#endif
+}
+
+// ---------------------------------------------------------------------
+
+void AnnotationJournal::write(const QByteArray &batch) {
+    if (batch.isEmpty())
+        return;
+    int lines = batch.count('\n');
+    if (!file.isOpen()) {
+        qWarning() << "WARNING: No meeting directory," << lines
+                   << "annotations lost";
+        return;
+    }
+
+    qint64 t0 = MasterClock::nsecs();
+    if (file.write(batch) != batch.size())
+        qWarning() << "WARNING: Failed to write" << file.fileName();
+    sync();
+    Metrics::set("annotations.write_us", (MasterClock::nsecs()-t0)/1000);
+    Metrics::add("annotations.records", lines);
+}
+
+// ---------------------------------------------------------------------
+
+void AnnotationJournal::run() {
+    for (;;) {
+        mutex.lock();
+        if (!stopping && !directory_changed &&
+            (pending.isEmpty() || policy != SyncAlways))
+            queued.wait(&mutex, flush_ms);
+        QByteArray before = previous;
+        QByteArray batch = pending;
+        previous.clear();
+        pending.clear();
+        bool reopen_now = directory_changed;
+        QString dir = directory;
+        directory_changed = false;
+        bool stop = stopping;
+        mutex.unlock();
+
+        write(before);
+        if (reopen_now)
+            reopen(dir);
+        write(batch);
+        if (stop)
+            break;
+    }
+    if (file.isOpen()) {
+        sync();
+        file.close();
+    }
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,104 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef ANNOTATIONJOURNAL_H
+#define ANNOTATIONJOURNAL_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFile>
+#include <QByteArray>
+#include <QString>
+
+/// Append-only journal of the annotations of a meeting, written to
+/// annotations.txt by its own thread so that clicking never waits for
+/// the disk.  Each line is
+///
+///   master_ns wallclock type value [stream=segment:frame:age_ms ...]
+///
+/// where type is status, pose or event, and there is one position for
+/// each stream being recorded: the last frame written to its current
+/// file segment and how many milliseconds before the annotation that
+/// frame was captured.  A still of a camera saved for an annotation
+/// (see SnapshotWriter) gets a line of its own once the file is
+/// complete,
+///
+///   master_ns wallclock snapshot camera file=snapshot-<ns>-capture<n>.jpg
+///
+/// where <ns> is the master_ns of the annotation.
+///
+/// Lines are written in batches every "annotations/flush_ms"
+/// milliseconds.  "annotations/fsync" is never, batch (the default)
+/// or always, the last one syncing after every line.
+class AnnotationJournal : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum SyncPolicy { SyncNever, SyncBatch, SyncAlways };
+
+    AnnotationJournal(QObject *parent = 0);
+
+    /// Continues in annotations.txt of a new meeting directory
+    void setDirectory(const QString &dir);
+
+    /// Stamps and queues an annotation, never blocks on I/O.  Returns
+    /// the master clock time it was stamped with.
+    qint64 add(const QString &type, int value);
+
+    /// Links a still that has been saved in the meeting directory
+    void addSnapshot(int camera, const QString &file);
+
+    /// Writes what is queued and exits
+    void breakLoop();
+
+private:
+    void run();
+
+    void reopen(const QString &dir);
+    void write(const QByteArray &batch);
+    void sync();
+
+    QFile file;
+    SyncPolicy policy;
+    int flush_ms;
+
+    /// Guarded by mutex
+    QMutex mutex;
+    QWaitCondition queued;
+    QByteArray pending;
+    /// Queued before the last directory change
+    QByteArray previous;
+    QString directory;
+    bool directory_changed;
+    bool stopping;
+};
+
+#endif // ANNOTATIONJOURNAL_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,168 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDebug>
+
+#include <math.h>
+
+#ifdef HAVE_SAMPLERATE
+#include <samplerate.h>
+#endif
+
+#include "audiodrift.h"
+
+// ---------------------------------------------------------------------
+
+DriftEstimator::DriftEstimator(double n, double t) : nominal(n), tau(t) {
+    reset();
+}
+
+// ---------------------------------------------------------------------
+
+void DriftEstimator::reset() {
+    have_origin = false;
+    origin_frames = origin_ns = last_ns = 0;
+    sw = sx = sy = sxx = sxy = 0.0;
+}
+
+// ---------------------------------------------------------------------
+
+void DriftEstimator::add(qint64 frames, qint64 t_ns) {
+    if (!have_origin) {
+        origin_frames = frames;
+        origin_ns = last_ns = t_ns;
+        have_origin = true;
+    }
+
+    double decay = exp(-(t_ns-last_ns)*1e-9/tau);
+    sw *= decay;
+    sx *= decay;
+    sy *= decay;
+    sxx *= decay;
+    sxy *= decay;
+    last_ns = t_ns;
+
+    double x = (t_ns-origin_ns)*1e-9;
+    double y = (frames-origin_frames)-nominal*x;
+    sw += 1.0;
+    sx += x;
+    sy += y;
+    sxx += x*x;
+    sxy += x*y;
+}
+
+// ---------------------------------------------------------------------
+
+bool DriftEstimator::isValid() const {
+    return have_origin && last_ns-origin_ns >= 10*1000000000LL;
+}
+
+// ---------------------------------------------------------------------
+
+double DriftEstimator::rate() const {
+    double d = sw*sxx-sx*sx;
+    if (!isValid() || d <= 0.0)
+        return nominal;
+    return nominal+(sw*sxy-sx*sy)/d;
+}
+
+// ---------------------------------------------------------------------
+
+double DriftEstimator::ppm() const {
+    return (rate()/nominal-1.0)*1e6;
+}
+
+// ---------------------------------------------------------------------
+
+Resampler::Resampler(int c) : state(NULL), channels(c) {
+#ifdef HAVE_SAMPLERATE
+    int err;
+    state = src_new(SRC_SINC_BEST_QUALITY, channels, &err);
+    if (!state)
+        qWarning() << "WARNING: Resampler:" << src_strerror(err);
+#else
+    qWarning() << "WARNING: Resampler: built without libsamplerate";
+#endif
+}
+
+// ---------------------------------------------------------------------
+
+Resampler::~Resampler() {
+#ifdef HAVE_SAMPLERATE
+    if (state)
+        src_delete(state);
+#endif
+}
+
+// ---------------------------------------------------------------------
+
+int Resampler::process(const qint16 *in, int frames, double ratio,
+                       QVector<qint16> &out) {
+    out.clear();
+#ifdef HAVE_SAMPLERATE
+    if (!state)
+        return 0;
+
+    fin.resize(frames*channels);
+    src_short_to_float_array(in, fin.data(), fin.size());
+
+    int room = int(frames*ratio)+64;
+    fout.resize(room*channels);
+
+    SRC_DATA data;
+    data.data_in = fin.constData();
+    data.input_frames = frames;
+    data.end_of_input = 0;
+    data.src_ratio = ratio;
+
+    while (data.input_frames > 0) {
+        data.data_out = fout.data();
+        data.output_frames = room;
+        int err = src_process(state, &data);
+        if (err) {
+            qWarning() << "WARNING: Resampler:" << src_strerror(err);
+            break;
+        }
+        int n = out.size();
+        out.resize(n+data.output_frames_gen*channels);
+        src_float_to_short_array(fout.constData(), out.data()+n,
+                                 data.output_frames_gen*channels);
+        data.data_in += data.input_frames_used*channels;
+        data.input_frames -= data.input_frames_used;
+        if (!data.input_frames_used && !data.output_frames_gen)
+            break;
+    }
+#else
+    Q_UNUSED(in);
+    Q_UNUSED(frames);
+    Q_UNUSED(ratio);
+#endif
+    return out.size()/channels;
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,105 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef AUDIODRIFT_H
+#define AUDIODRIFT_H
+
+#include <QVector>
+#include <QtGlobal>
+
+/// Estimates the true sample rate of an audio device on the master
+/// clock.
+///
+/// Each period adds a point (frames captured, master clock time).
+/// The rate is the slope of a weighted least-squares line through
+/// them, with older points forgotten with the given time constant so
+/// that slow drift (e.g. temperature) is followed.
+class DriftEstimator
+{
+public:
+    DriftEstimator(double nominal_rate, double time_constant_s = 120.0);
+
+    void reset();
+
+    /// frames is the total captured up to the instant t_ns
+    void add(qint64 frames, qint64 t_ns);
+
+    /// True once the points span enough time for a useful estimate
+    bool isValid() const;
+
+    /// Estimated frames per second of master clock time
+    double rate() const;
+
+    /// Deviation of rate() from the nominal rate
+    double ppm() const;
+
+private:
+    double nominal;
+    double tau;
+
+    bool have_origin;
+    qint64 origin_frames;
+    qint64 origin_ns;
+    qint64 last_ns;
+
+    // Weighted sums of x = seconds since the origin and y = frames
+    // minus the nominal count, which keeps the values small
+    double sw, sx, sy, sxx, sxy;
+};
+
+// ---------------------------------------------------------------------
+
+struct SRC_STATE_tag;
+
+/// Variable-ratio sinc resampler for interleaved 16-bit audio,
+/// using libsamplerate (HAVE_SAMPLERATE).  Without it isValid() is
+/// false and nothing is resampled.
+class Resampler
+{
+public:
+    Resampler(int channels);
+    ~Resampler();
+
+    bool isValid() const { return state != NULL; }
+
+    /// Converts frames with the output/input ratio, which may change
+    /// from call to call.  Returns the number of frames in out.
+    int process(const qint16 *in, int frames, double ratio,
+                QVector<qint16> &out);
+
+private:
+    Q_DISABLE_COPY(Resampler)
+
+    SRC_STATE_tag *state;
+    int channels;
+    QVector<float> fin;
+    QVector<float> fout;
+};
+
+#endif // AUDIODRIFT_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
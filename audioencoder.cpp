@@ -0,0 +1,413 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QVector>
+
+#ifdef HAVE_FLAC
+#include <FLAC/stream_encoder.h>
+#endif
+
+#ifdef HAVE_OPUSENC
+#include <opusenc.h>
+#endif
+
+#include "audioencoder.h"
+#include "wavwriter.h"
+#include "metrics.h"
+#include "streamstats.h"
+#include "manifest.h"
+
+// ---------------------------------------------------------------------
+
+class WavAudioEncoder : public AudioEncoder
+{
+public:
+    WavAudioEncoder(int flush_ms) {
+        wav.setFlushInterval(flush_ms);
+    }
+
+    bool open(const QString &filename, int rate, int channels) {
+        if (!wav.open(filename, rate, channels, 16)) {
+            error_ = wav.errorString();
+            return false;
+        }
+        return true;
+    }
+
+    bool encode(const qint16 *data, int frames) {
+        if (!wav.write(reinterpret_cast<const char*>(data),
+                       qint64(frames)*wav.frameBytes())) {
+            error_ = wav.errorString();
+            return false;
+        }
+        return true;
+    }
+
+    bool close() {
+        wav.close();
+        return true;
+    }
+
+    qint64 bytesWritten() const {
+        return WavWriter::HeaderBytes+wav.dataBytes();
+    }
+
+private:
+    WavWriter wav;
+};
+
+// ---------------------------------------------------------------------
+
+#ifdef HAVE_FLAC
+
+class FlacAudioEncoder : public AudioEncoder
+{
+public:
+    FlacAudioEncoder(int q) : quality(q), enc(NULL), channels(0),
+                              bytes(0) {}
+    ~FlacAudioEncoder() { close(); }
+
+    bool open(const QString &filename, int rate, int c) {
+        // Compression level for each QMultimedia::EncodingQuality:
+        static const int level[] = { 0, 2, 5, 6, 8 };
+
+        channels = c;
+        if (channels > 8) {
+            error_ = "FLAC supports at most 8 channels";
+            return false;
+        }
+        enc = FLAC__stream_encoder_new();
+        FLAC__stream_encoder_set_channels(enc, channels);
+        FLAC__stream_encoder_set_bits_per_sample(enc, 16);
+        FLAC__stream_encoder_set_sample_rate(enc, rate);
+        FLAC__stream_encoder_set_compression_level(enc,
+                                                   level[qBound(0, quality, 4)]);
+        FLAC__StreamEncoderInitStatus status =
+            FLAC__stream_encoder_init_file(enc,
+                                           QFile::encodeName(filename).constData(),
+                                           progress, this);
+        if (status != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+            error_ = FLAC__StreamEncoderInitStatusString[status];
+            FLAC__stream_encoder_delete(enc);
+            enc = NULL;
+            return false;
+        }
+        return true;
+    }
+
+    bool encode(const qint16 *data, int frames) {
+        int n = frames*channels;
+        if (buffer.size() < n)
+            buffer.resize(n);
+        for (int i = 0; i < n; ++i)
+            buffer[i] = data[i];
+        if (!FLAC__stream_encoder_process_interleaved(enc, buffer.constData(),
+                                                      frames)) {
+            error_ = FLAC__stream_encoder_get_resolved_state_string(enc);
+            return false;
+        }
+        return true;
+    }
+
+    bool close() {
+        if (!enc)
+            return true;
+        bool ok = FLAC__stream_encoder_finish(enc);
+        if (!ok)
+            error_ = FLAC__stream_encoder_get_resolved_state_string(enc);
+        FLAC__stream_encoder_delete(enc);
+        enc = NULL;
+        return ok;
+    }
+
+    qint64 bytesWritten() const { return bytes; }
+
+private:
+    static void progress(const FLAC__StreamEncoder*, FLAC__uint64 bytes,
+                         FLAC__uint64, unsigned, unsigned, void *data) {
+        static_cast<FlacAudioEncoder*>(data)->bytes = bytes;
+    }
+
+    int quality;
+    FLAC__StreamEncoder *enc;
+    int channels;
+    qint64 bytes;
+    QVector<FLAC__int32> buffer;
+};
+
+#endif // HAVE_FLAC
+
+// ---------------------------------------------------------------------
+
+#ifdef HAVE_OPUSENC
+
+class OpusAudioEncoder : public AudioEncoder
+{
+public:
+    OpusAudioEncoder(int b) : bitrate(b), enc(NULL), bytes(0) {}
+    ~OpusAudioEncoder() { close(); }
+
+    bool open(const QString &filename, int rate, int channels) {
+        file.setFileName(filename);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            error_ = file.errorString();
+            return false;
+        }
+
+        OpusEncCallbacks callbacks = { write, NULL };
+        OggOpusComments *comments = ope_comments_create();
+        ope_comments_add(comments, "ENCODER", "mrecorder");
+        int family = channels <= 2 ? 0 : channels <= 8 ? 1 : 255;
+        int err;
+        // libopusenc resamples to 48 kHz if needed:
+        enc = ope_encoder_create_callbacks(&callbacks, this, comments,
+                                           rate, channels, family, &err);
+        ope_comments_destroy(comments);
+        if (!enc) {
+            error_ = ope_strerror(err);
+            file.close();
+            return false;
+        }
+        ope_encoder_ctl(enc, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+        if (bitrate > 0)
+            ope_encoder_ctl(enc, OPUS_SET_BITRATE(bitrate));
+        return true;
+    }
+
+    bool encode(const qint16 *data, int frames) {
+        int err = ope_encoder_write(enc, data, frames);
+        if (err != OPE_OK) {
+            error_ = ope_strerror(err);
+            return false;
+        }
+        return true;
+    }
+
+    bool close() {
+        if (!enc)
+            return true;
+        int err = ope_encoder_drain(enc);
+        ope_encoder_destroy(enc);
+        enc = NULL;
+        file.close();
+        if (err != OPE_OK) {
+            error_ = ope_strerror(err);
+            return false;
+        }
+        return true;
+    }
+
+    qint64 bytesWritten() const { return bytes; }
+
+private:
+    static int write(void *data, const unsigned char *ptr, opus_int32 len) {
+        OpusAudioEncoder *self = static_cast<OpusAudioEncoder*>(data);
+        if (self->file.write(reinterpret_cast<const char*>(ptr), len) != len)
+            return 1;
+        self->bytes += len;
+        return 0;
+    }
+
+    int bitrate;
+    OggOpusEnc *enc;
+    QFile file;
+    qint64 bytes;
+};
+
+#endif // HAVE_OPUSENC
+
+// ---------------------------------------------------------------------
+
+AudioEncoder *AudioEncoder::create(const Settings &settings) {
+    switch (settings.codec) {
+#ifdef HAVE_FLAC
+    case Flac:
+        return new FlacAudioEncoder(settings.quality);
+#endif
+#ifdef HAVE_OPUSENC
+    case Opus:
+        return new OpusAudioEncoder(settings.bitrate);
+#endif
+    default:
+        return new WavAudioEncoder(settings.flush_ms);
+    }
+}
+
+// ---------------------------------------------------------------------
+
+QStringList AudioEncoder::codecNames() {
+    QStringList list;
+    list << name(Wav);
+#ifdef HAVE_FLAC
+    list << name(Flac);
+#endif
+#ifdef HAVE_OPUSENC
+    list << name(Opus);
+#endif
+    return list;
+}
+
+// ---------------------------------------------------------------------
+
+QStringList AudioEncoder::containers() {
+    QStringList list;
+    list << suffix(Wav);
+#ifdef HAVE_FLAC
+    list << suffix(Flac);
+#endif
+#ifdef HAVE_OPUSENC
+    list << suffix(Opus);
+#endif
+    return list;
+}
+
+// ---------------------------------------------------------------------
+
+AudioEncoder::Codec AudioEncoder::codecFromName(const QString &n) {
+    if (n.isEmpty())
+#ifdef HAVE_FLAC
+        return Flac;
+#else
+        return Wav;
+#endif
+
+    QStringList available = codecNames()+containers();
+    if (!available.contains(n))
+        return Wav;
+    if (n == name(Flac) || n == suffix(Flac))
+        return Flac;
+    if (n == name(Opus) || n == suffix(Opus))
+        return Opus;
+    return Wav;
+}
+
+// ---------------------------------------------------------------------
+
+QString AudioEncoder::suffix(Codec codec) {
+    switch (codec) {
+    case Flac:
+        return "flac";
+    case Opus:
+        return "ogg";
+    default:
+        return "wav";
+    }
+}
+
+// ---------------------------------------------------------------------
+
+QString AudioEncoder::name(Codec codec) {
+    switch (codec) {
+    case Flac:
+        return "audio/x-flac";
+    case Opus:
+        return "audio/x-opus";
+    default:
+        return "audio/pcm";
+    }
+}
+
+// ---------------------------------------------------------------------
+
+AudioEncoderThread::AudioEncoderThread(AudioEncoder *e, const QString &st,
+                                       const QString &f, int r, int c,
+                                       qint64 max)
+    : AudioSinkThread(st, "encoder", r, c, max), encoder(e), filename(f),
+      pcm_bytes(0), frames(0), window_us(0), window_n(0)
+{
+}
+
+// ---------------------------------------------------------------------
+
+AudioEncoderThread::~AudioEncoderThread() {
+    delete encoder;
+}
+
+// ---------------------------------------------------------------------
+
+void AudioEncoderThread::begin() {
+    Manifest::add(stream, "open", QFileInfo(filename).fileName(),
+                  QString("rate=%1 channels=%2").arg(rate).arg(channels));
+    StreamStats::addFile(stream);
+    StreamStats::update(stream, encoder->bytesWritten(), 0);
+    prealloc.open(filename);
+}
+
+// ---------------------------------------------------------------------
+
+bool AudioEncoderThread::consume(const qint16 *data, int n) {
+    QElapsedTimer timer;
+    timer.start();
+    if (!encoder->encode(data, n)) {
+        errorString = encoder->errorString();
+        return false;
+    }
+    qint64 us = timer.nsecsElapsed()/1000;
+    pcm_bytes += qint64(n)*channels*2;
+    frames += n;
+    prealloc.grow(encoder->bytesWritten());
+
+    window_us += us;
+    window_n++;
+    latency.add(us);
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+void AudioEncoderThread::report(qint64 backlog) {
+    if (window_n)
+        Metrics::set(stream+".encode_us_avg", window_us/window_n);
+    latency.publish(stream+".encode_us");
+    Metrics::set(stream+".encoder_queue_ms", backlog*1000/(rate*channels*2));
+    if (pcm_bytes > 0)
+        Metrics::set(stream+".compression_pct",
+                     encoder->bytesWritten()*100/pcm_bytes);
+    StreamStats::update(stream, encoder->bytesWritten(), frames);
+    window_us = window_n = 0;
+    latency.clear();
+}
+
+// ---------------------------------------------------------------------
+
+void AudioEncoderThread::end() {
+    if (!encoder->close())
+        emit errorMessage(encoder->errorString());
+    prealloc.close();
+    report(0);
+    Manifest::add(stream, "close", QFileInfo(filename).fileName(),
+                  QString("frames=%1").arg(frames));
+    qDebug() << "AudioEncoderThread: closed" << filename << "with" << frames
+             << "frames," << encoder->bytesWritten() << "bytes";
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
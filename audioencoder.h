@@ -0,0 +1,120 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef AUDIOENCODER_H
+#define AUDIOENCODER_H
+
+#include <QString>
+#include <QStringList>
+
+#include "audiosink.h"
+#include "preallocator.h"
+#include "latencyhistogram.h"
+
+/// Streaming encoder for interleaved 16-bit PCM.  Implementations for
+/// WAV, FLAC (HAVE_FLAC) and Ogg Opus (HAVE_OPUSENC) are created with
+/// create().
+class AudioEncoder
+{
+public:
+    enum Codec { Wav, Flac, Opus };
+
+    struct Settings {
+        Settings() : codec(Wav), bitrate(0), quality(2), flush_ms(1000) {}
+        Codec codec;
+        /// Opus only, bits per second, 0 for the encoder default
+        int bitrate;
+        /// 0-4 as QMultimedia::EncodingQuality, FLAC compression
+        int quality;
+        /// WAV only, how often the file is made valid on disk
+        int flush_ms;
+    };
+
+    virtual ~AudioEncoder() {}
+
+    virtual bool open(const QString &filename, int rate, int channels) = 0;
+    virtual bool encode(const qint16 *data, int frames) = 0;
+    virtual bool close() = 0;
+
+    /// Bytes written to the file so far
+    virtual qint64 bytesWritten() const = 0;
+
+    QString errorString() const { return error_; }
+
+    static AudioEncoder *create(const Settings &settings);
+
+    /// Codecs compiled in, as MIME type names for the codec box
+    static QStringList codecNames();
+    static QStringList containers();
+
+    /// Maps a codec or container name to a codec, WAV if unknown.
+    /// An empty name gives the best lossless codec available.
+    static Codec codecFromName(const QString &name);
+    static QString suffix(Codec codec);
+    static QString name(Codec codec);
+
+protected:
+    QString error_;
+};
+
+// ---------------------------------------------------------------------
+
+/// Runs an encoder on its own thread, fed by the audio writer thread
+class AudioEncoderThread : public AudioSinkThread
+{
+    Q_OBJECT
+
+public:
+    /// Takes ownership of an opened encoder
+    AudioEncoderThread(AudioEncoder *encoder, const QString &stream,
+                       const QString &filename, int rate, int channels,
+                       qint64 max_bytes);
+    ~AudioEncoderThread();
+
+protected:
+    void begin();
+    bool consume(const qint16 *data, int frames);
+    void end();
+    void report(qint64 backlog);
+
+private:
+    AudioEncoder *encoder;
+    QString filename;
+    Preallocator prealloc;
+
+    qint64 pcm_bytes;
+    qint64 frames;
+
+    /// Encode times since the last report
+    qint64 window_us;
+    qint64 window_n;
+    LatencyHistogram latency;
+};
+
+#endif // AUDIOENCODER_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
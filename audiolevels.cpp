@@ -0,0 +1,457 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include "audiolevels.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define AUDIOLEVELS_X86 1
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+using namespace AudioLevels;
+
+// ---------------------------------------------------------------------
+
+namespace {
+
+    // Midpoint and scale that map each format to [-1, 1]
+    struct Normalization {
+        float bias;
+        float scale;
+    };
+
+    Normalization normalization(SampleFormat format) {
+        Normalization n = { 0.0f, 1.0f };
+        switch (format) {
+        case Int8:    n.scale = 1.0f/128.0f; break;
+        case UInt8:   n.bias = 128.0f; n.scale = 1.0f/128.0f; break;
+        case Int16:   n.scale = 1.0f/32768.0f; break;
+        case UInt16:  n.bias = 32768.0f; n.scale = 1.0f/32768.0f; break;
+        case Int32:   n.scale = 1.0f/2147483648.0f; break;
+        case UInt32:  n.bias = 2147483648.0f; n.scale = 1.0f/2147483648.0f; break;
+        case Float32:
+        case UnknownFormat:
+            break;
+        }
+        return n;
+    }
+
+    // -----------------------------------------------------------------
+
+    template <class T>
+    void scalarLevels(const T *data, int begin, int end, int channels,
+                      Normalization n, float *peak, double *sumsq) {
+        int c = begin % channels;
+        for (int i = begin; i < end; ++i) {
+            float v = (float(data[i]) - n.bias) * n.scale;
+            float a = fabsf(v);
+            if (a > peak[c])
+                peak[c] = a;
+            sumsq[c] += v*v;
+            if (++c == channels)
+                c = 0;
+        }
+    }
+
+    void scalarDispatch(const void *data, int begin, int end, int channels,
+                        SampleFormat format, float *peak, double *sumsq) {
+        Normalization n = normalization(format);
+        switch (format) {
+        case Int8:
+            scalarLevels((const int8_t*)data, begin, end, channels, n, peak, sumsq);
+            break;
+        case UInt8:
+            scalarLevels((const uint8_t*)data, begin, end, channels, n, peak, sumsq);
+            break;
+        case Int16:
+            scalarLevels((const int16_t*)data, begin, end, channels, n, peak, sumsq);
+            break;
+        case UInt16:
+            scalarLevels((const uint16_t*)data, begin, end, channels, n, peak, sumsq);
+            break;
+        case Int32:
+            scalarLevels((const int32_t*)data, begin, end, channels, n, peak, sumsq);
+            break;
+        case UInt32:
+            scalarLevels((const uint32_t*)data, begin, end, channels, n, peak, sumsq);
+            break;
+        case Float32:
+            scalarLevels((const float*)data, begin, end, channels, n, peak, sumsq);
+            break;
+        case UnknownFormat:
+            break;
+        }
+    }
+
+#ifdef AUDIOLEVELS_X86
+
+    // -----------------------------------------------------------------
+    // SSE2, 4 samples per vector.  Unsigned formats are turned into
+    // signed ones by flipping the sign bit, so the bias is only needed
+    // in the scalar code.
+
+    struct SSE2Float {
+        typedef float T;
+        static TARGET_SSE2 __m128 load(const T *p) { return _mm_loadu_ps(p); }
+    };
+    struct SSE2Int32 {
+        typedef int32_t T;
+        static TARGET_SSE2 __m128 load(const T *p) {
+            return _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)p));
+        }
+    };
+    struct SSE2UInt32 {
+        typedef uint32_t T;
+        static TARGET_SSE2 __m128 load(const T *p) {
+            __m128i x = _mm_loadu_si128((const __m128i*)p);
+            x = _mm_xor_si128(x, _mm_set1_epi32(int(0x80000000u)));
+            return _mm_cvtepi32_ps(x);
+        }
+    };
+    struct SSE2Int16 {
+        typedef int16_t T;
+        static TARGET_SSE2 __m128 load(const T *p) {
+            __m128i x = _mm_loadl_epi64((const __m128i*)p);
+            x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+            return _mm_cvtepi32_ps(x);
+        }
+    };
+    struct SSE2UInt16 {
+        typedef uint16_t T;
+        static TARGET_SSE2 __m128 load(const T *p) {
+            __m128i x = _mm_loadl_epi64((const __m128i*)p);
+            x = _mm_xor_si128(x, _mm_set1_epi16(short(0x8000)));
+            x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+            return _mm_cvtepi32_ps(x);
+        }
+    };
+    struct SSE2Int8 {
+        typedef int8_t T;
+        static TARGET_SSE2 __m128 load(const T *p) {
+            int32_t v;
+            memcpy(&v, p, 4);
+            __m128i x = _mm_cvtsi32_si128(v);
+            x = _mm_unpacklo_epi8(x, x);
+            x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 24);
+            return _mm_cvtepi32_ps(x);
+        }
+    };
+    struct SSE2UInt8 {
+        typedef uint8_t T;
+        static TARGET_SSE2 __m128 load(const T *p) {
+            int32_t v;
+            memcpy(&v, p, 4);
+            __m128i x = _mm_cvtsi32_si128(v ^ int32_t(0x80808080u));
+            x = _mm_unpacklo_epi8(x, x);
+            x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 24);
+            return _mm_cvtepi32_ps(x);
+        }
+    };
+
+    // Interleaved channels: lane l of vector k in a group of `channels`
+    // vectors always holds channel (k*4+l) % channels, so each vector
+    // of the group gets its own accumulators.  Returns the number of
+    // samples processed, the rest is left for the scalar code.
+    template <class L>
+    TARGET_SSE2 int sse2Levels(const typename L::T *data, int samples,
+                               int channels, float scale,
+                               float *peak, double *sumsq) {
+        const int W = 4;
+        __m128 maxv[MaxVectorChannels], sumv[MaxVectorChannels];
+        for (int k = 0; k < channels; ++k) {
+            maxv[k] = _mm_setzero_ps();
+            sumv[k] = _mm_setzero_ps();
+        }
+        const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        const __m128 vscale = _mm_set1_ps(scale);
+
+        int group = W*channels, i = 0;
+        for (; i + group <= samples; i += group) {
+            for (int k = 0; k < channels; ++k) {
+                __m128 v = _mm_mul_ps(L::load(data + i + k*W), vscale);
+                maxv[k] = _mm_max_ps(maxv[k], _mm_and_ps(v, absmask));
+                sumv[k] = _mm_add_ps(sumv[k], _mm_mul_ps(v, v));
+            }
+        }
+
+        float m[W], s[W];
+        for (int k = 0; k < channels; ++k) {
+            _mm_storeu_ps(m, maxv[k]);
+            _mm_storeu_ps(s, sumv[k]);
+            for (int l = 0; l < W; ++l) {
+                int c = (k*W + l) % channels;
+                if (m[l] > peak[c])
+                    peak[c] = m[l];
+                sumsq[c] += s[l];
+            }
+        }
+        return i;
+    }
+
+    // -----------------------------------------------------------------
+    // AVX2, 8 samples per vector
+
+    struct AVX2Float {
+        typedef float T;
+        static TARGET_AVX2 __m256 load(const T *p) { return _mm256_loadu_ps(p); }
+    };
+    struct AVX2Int32 {
+        typedef int32_t T;
+        static TARGET_AVX2 __m256 load(const T *p) {
+            return _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)p));
+        }
+    };
+    struct AVX2UInt32 {
+        typedef uint32_t T;
+        static TARGET_AVX2 __m256 load(const T *p) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)p);
+            x = _mm256_xor_si256(x, _mm256_set1_epi32(int(0x80000000u)));
+            return _mm256_cvtepi32_ps(x);
+        }
+    };
+    struct AVX2Int16 {
+        typedef int16_t T;
+        static TARGET_AVX2 __m256 load(const T *p) {
+            __m128i x = _mm_loadu_si128((const __m128i*)p);
+            return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x));
+        }
+    };
+    struct AVX2UInt16 {
+        typedef uint16_t T;
+        static TARGET_AVX2 __m256 load(const T *p) {
+            __m128i x = _mm_loadu_si128((const __m128i*)p);
+            x = _mm_xor_si128(x, _mm_set1_epi16(short(0x8000)));
+            return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x));
+        }
+    };
+    struct AVX2Int8 {
+        typedef int8_t T;
+        static TARGET_AVX2 __m256 load(const T *p) {
+            __m128i x = _mm_loadl_epi64((const __m128i*)p);
+            return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(x));
+        }
+    };
+    struct AVX2UInt8 {
+        typedef uint8_t T;
+        static TARGET_AVX2 __m256 load(const T *p) {
+            __m128i x = _mm_loadl_epi64((const __m128i*)p);
+            x = _mm_xor_si128(x, _mm_set1_epi8(char(0x80)));
+            return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(x));
+        }
+    };
+
+    template <class L>
+    TARGET_AVX2 int avx2Levels(const typename L::T *data, int samples,
+                               int channels, float scale,
+                               float *peak, double *sumsq) {
+        const int W = 8;
+        __m256 maxv[MaxVectorChannels], sumv[MaxVectorChannels];
+        for (int k = 0; k < channels; ++k) {
+            maxv[k] = _mm256_setzero_ps();
+            sumv[k] = _mm256_setzero_ps();
+        }
+        const __m256 absmask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+        const __m256 vscale = _mm256_set1_ps(scale);
+
+        int group = W*channels, i = 0;
+        for (; i + group <= samples; i += group) {
+            for (int k = 0; k < channels; ++k) {
+                __m256 v = _mm256_mul_ps(L::load(data + i + k*W), vscale);
+                maxv[k] = _mm256_max_ps(maxv[k], _mm256_and_ps(v, absmask));
+                sumv[k] = _mm256_add_ps(sumv[k], _mm256_mul_ps(v, v));
+            }
+        }
+
+        float m[W], s[W];
+        for (int k = 0; k < channels; ++k) {
+            _mm256_storeu_ps(m, maxv[k]);
+            _mm256_storeu_ps(s, sumv[k]);
+            for (int l = 0; l < W; ++l) {
+                int c = (k*W + l) % channels;
+                if (m[l] > peak[c])
+                    peak[c] = m[l];
+                sumsq[c] += s[l];
+            }
+        }
+        _mm256_zeroupper();
+        return i;
+    }
+
+    // -----------------------------------------------------------------
+
+    int vectorDispatch(Kernel kernel, const void *data, int samples,
+                       int channels, SampleFormat format, float *peak,
+                       double *sumsq) {
+        float scale = normalization(format).scale;
+        if (kernel == AVX2) {
+            switch (format) {
+            case Int8:    return avx2Levels<AVX2Int8>((const int8_t*)data, samples, channels, scale, peak, sumsq);
+            case UInt8:   return avx2Levels<AVX2UInt8>((const uint8_t*)data, samples, channels, scale, peak, sumsq);
+            case Int16:   return avx2Levels<AVX2Int16>((const int16_t*)data, samples, channels, scale, peak, sumsq);
+            case UInt16:  return avx2Levels<AVX2UInt16>((const uint16_t*)data, samples, channels, scale, peak, sumsq);
+            case Int32:   return avx2Levels<AVX2Int32>((const int32_t*)data, samples, channels, scale, peak, sumsq);
+            case UInt32:  return avx2Levels<AVX2UInt32>((const uint32_t*)data, samples, channels, scale, peak, sumsq);
+            case Float32: return avx2Levels<AVX2Float>((const float*)data, samples, channels, scale, peak, sumsq);
+            case UnknownFormat: break;
+            }
+        } else if (kernel == SSE2) {
+            switch (format) {
+            case Int8:    return sse2Levels<SSE2Int8>((const int8_t*)data, samples, channels, scale, peak, sumsq);
+            case UInt8:   return sse2Levels<SSE2UInt8>((const uint8_t*)data, samples, channels, scale, peak, sumsq);
+            case Int16:   return sse2Levels<SSE2Int16>((const int16_t*)data, samples, channels, scale, peak, sumsq);
+            case UInt16:  return sse2Levels<SSE2UInt16>((const uint16_t*)data, samples, channels, scale, peak, sumsq);
+            case Int32:   return sse2Levels<SSE2Int32>((const int32_t*)data, samples, channels, scale, peak, sumsq);
+            case UInt32:  return sse2Levels<SSE2UInt32>((const uint32_t*)data, samples, channels, scale, peak, sumsq);
+            case Float32: return sse2Levels<SSE2Float>((const float*)data, samples, channels, scale, peak, sumsq);
+            case UnknownFormat: break;
+            }
+        }
+        return 0;
+    }
+
+#endif // AUDIOLEVELS_X86
+
+    bool kernelSupported(Kernel kernel) {
+        switch (kernel) {
+        case Scalar:
+            return true;
+#ifdef AUDIOLEVELS_X86
+        case SSE2:
+            return __builtin_cpu_supports("sse2");
+        case AVX2:
+            return __builtin_cpu_supports("avx2");
+#else
+        default:
+            break;
+#endif
+        }
+        return false;
+    }
+}
+
+// ---------------------------------------------------------------------
+
+Kernel AudioLevels::bestKernel() {
+    static Kernel best = kernelSupported(AVX2) ? AVX2 :
+        (kernelSupported(SSE2) ? SSE2 : Scalar);
+    return best;
+}
+
+// ---------------------------------------------------------------------
+
+const char *AudioLevels::kernelName(Kernel kernel) {
+    switch (kernel) {
+    case Scalar: return "scalar";
+    case SSE2:   return "sse2";
+    case AVX2:   return "avx2";
+    }
+    return "unknown";
+}
+
+// ---------------------------------------------------------------------
+
+void AudioLevels::compute(const void *data, int frames, int channels,
+                          SampleFormat format, float *peak, float *rms) {
+    compute(bestKernel(), data, frames, channels, format, peak, rms);
+}
+
+// ---------------------------------------------------------------------
+
+void AudioLevels::compute(Kernel kernel, const void *data, int frames,
+                          int channels, SampleFormat format,
+                          float *peak, float *rms) {
+    if (channels <= 0)
+        return;
+
+    double sumsq[256];
+    double *sums = channels <= 256 ? sumsq : new double[channels];
+    for (int c = 0; c < channels; ++c) {
+        peak[c] = 0.0f;
+        sums[c] = 0.0;
+    }
+
+    int samples = frames*channels, done = 0;
+    if (!kernelSupported(kernel))
+        kernel = Scalar;
+#ifdef AUDIOLEVELS_X86
+    if (kernel != Scalar && channels <= MaxVectorChannels)
+        done = vectorDispatch(kernel, data, samples, channels, format,
+                              peak, sums);
+#endif
+    scalarDispatch(data, done, samples, channels, format, peak, sums);
+
+    for (int c = 0; c < channels; ++c)
+        rms[c] = frames > 0 ? float(sqrt(sums[c]/frames)) : 0.0f;
+
+    if (sums != sumsq)
+        delete [] sums;
+}
+
+// ---------------------------------------------------------------------
+
+PeakHold::PeakHold(double h, double r) : hold_s(h), release_per_s(r)
+{
+    reset();
+}
+
+// ---------------------------------------------------------------------
+
+void PeakHold::reset() {
+    level_ = rms_ = held_ = 0.0f;
+    held_t = last_t = 0.0;
+}
+
+// ---------------------------------------------------------------------
+
+void PeakHold::update(float peak, float rms, double t) {
+    double dt = t - last_t;
+    if (dt < 0.0)
+        dt = 0.0;
+    last_t = t;
+
+    // Instant attack, exponential release:
+    float release = float(exp(-release_per_s*dt));
+    level_ = peak > level_ ? peak : level_*release;
+    rms_ = rms > rms_ ? rms : rms_*release;
+
+    if (peak >= held_) {
+        held_ = peak;
+        held_t = t;
+    } else if (t - held_t > hold_s) {
+        held_ *= release;
+        if (held_ < level_)
+            held_ = level_;
+    }
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
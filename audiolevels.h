@@ -0,0 +1,94 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef AUDIOLEVELS_H
+#define AUDIOLEVELS_H
+
+// Plain C++ so that the tools can use this without Qt.
+
+#include <stdint.h>
+
+/// Per-channel peak and RMS of interleaved PCM audio.
+///
+/// All sample formats are normalized to [-1, 1] before measuring,
+/// unsigned formats by removing their midpoint.  Depending on the CPU
+/// the work is done with AVX2, SSE2 or plain C++, chosen at runtime.
+namespace AudioLevels {
+
+    enum SampleFormat {
+        UnknownFormat = 0,
+        Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32
+    };
+
+    enum Kernel { Scalar = 0, SSE2, AVX2 };
+
+    /// Best kernel supported by this CPU
+    Kernel bestKernel();
+    const char *kernelName(Kernel);
+
+    /// Computes peak[c] and rms[c] for each of the channels, the
+    /// arrays must hold at least channels values.  frames is the
+    /// number of sample frames (samples per channel).
+    void compute(const void *data, int frames, int channels,
+                 SampleFormat format, float *peak, float *rms);
+
+    /// Same with an explicit kernel, for testing and benchmarking.
+    /// Falls back to the scalar code if the kernel is not supported.
+    void compute(Kernel kernel, const void *data, int frames, int channels,
+                 SampleFormat format, float *peak, float *rms);
+
+    /// Maximum number of channels handled by the vector kernels, more
+    /// channels use the scalar code
+    const int MaxVectorChannels = 32;
+
+    /// Meter ballistics: instant attack and exponential release for
+    /// the bar, and a peak marker that is held for a while and then
+    /// released at the same rate.
+    class PeakHold
+    {
+    public:
+        PeakHold(double hold_s = 1.5, double release_per_s = 1.5);
+
+        /// Feeds a new measurement taken at time t (seconds)
+        void update(float peak, float rms, double t);
+        void reset();
+
+        float level() const { return level_; }
+        float rms() const { return rms_; }
+        float held() const { return held_; }
+
+    private:
+        double hold_s;
+        double release_per_s;
+        float level_, rms_, held_;
+        double held_t, last_t;
+    };
+}
+
+#endif // AUDIOLEVELS_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,124 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QVector>
+
+#include <string.h>
+
+#include "audiometer.h"
+#include "audiolevels.h"
+#include "metrics.h"
+
+// ---------------------------------------------------------------------
+
+static inline int floatBits(float f) {
+    int i;
+    memcpy(&i, &f, sizeof(i));
+    return i;
+}
+
+static inline float bitsFloat(int i) {
+    float f;
+    memcpy(&f, &i, sizeof(f));
+    return f;
+}
+
+// ---------------------------------------------------------------------
+
+AudioMeter::AudioMeter() : channels(0)
+{
+}
+
+// ---------------------------------------------------------------------
+
+int AudioMeter::channelCount() const {
+    return channels.load();
+}
+
+// ---------------------------------------------------------------------
+
+void AudioMeter::takeLevels(int channel, float &peak, float &rms) {
+    if (channel < 0 || channel >= MaxChannels) {
+        peak = rms = 0.0f;
+        return;
+    }
+    peak = bitsFloat(peaks[channel].fetchAndStoreOrdered(0));
+    rms = bitsFloat(rmss[channel].load());
+}
+
+// ---------------------------------------------------------------------
+
+void AudioMeter::clear() {
+    for (int i = 0; i < MaxChannels; ++i) {
+        peaks[i].store(0);
+        rmss[i].store(0);
+    }
+}
+
+// ---------------------------------------------------------------------
+
+void AudioMeter::processFrames(const void *data, int frames, int n,
+                               AudioLevels::SampleFormat format) {
+    QElapsedTimer timer;
+    timer.start();
+
+    if (format == AudioLevels::UnknownFormat || n <= 0)
+        return;
+
+    float peak[MaxChannels], rms[MaxChannels];
+    if (n > MaxChannels) {
+        QVector<float> allpeak(n), allrms(n);
+        AudioLevels::compute(data, frames, n, format,
+                             allpeak.data(), allrms.data());
+        memcpy(peak, allpeak.constData(), sizeof(peak));
+        memcpy(rms, allrms.constData(), sizeof(rms));
+        n = MaxChannels;
+    } else
+        AudioLevels::compute(data, frames, n, format, peak, rms);
+
+    publish(peak, rms, n);
+    Metrics::add("audio.meter_us", timer.nsecsElapsed()/1000);
+}
+
+// ---------------------------------------------------------------------
+
+void AudioMeter::publish(const float *peak, const float *rms, int n) {
+    for (int c = 0; c < n; ++c) {
+        // Keep the highest peak until the GUI has seen it:
+        int old = peaks[c].load();
+        while (peak[c] > bitsFloat(old) &&
+               !peaks[c].testAndSetOrdered(old, floatBits(peak[c])))
+            old = peaks[c].load();
+        rmss[c].store(floatBits(rms[c]));
+    }
+    channels.store(n);
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,73 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef AUDIOMETER_H
+#define AUDIOMETER_H
+
+#include <QAtomicInt>
+
+#include "audiolevels.h"
+
+/// Audio level analysis for the level meters.
+///
+/// The audio writer thread passes every period through
+/// processFrames().  The results are published in atomics: for each
+/// channel the highest peak since the GUI last looked, and the latest
+/// RMS.  The GUI samples them with takeLevels() at a fixed rate, so
+/// neither the analysis nor the repaints depend on the period size.
+class AudioMeter
+{
+public:
+    AudioMeter();
+
+    static const int MaxChannels = 32;
+
+    int channelCount() const;
+
+    /// Returns the highest peak since the previous call and the
+    /// latest RMS, safe to call from any thread
+    void takeLevels(int channel, float &peak, float &rms);
+
+    void clear();
+
+    /// Analyses interleaved frames, called from the writer thread
+    void processFrames(const void *data, int frames, int channels,
+                       AudioLevels::SampleFormat format);
+
+private:
+    void publish(const float *peak, const float *rms, int channels);
+
+    QAtomicInt channels;
+
+    /// float bit patterns
+    QAtomicInt peaks[MaxChannels];
+    QAtomicInt rmss[MaxChannels];
+};
+
+#endif // AUDIOMETER_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,1008 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDebug>
+#include <QTimer>
+#include <QSettings>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "audiorecorder.h"
+#include "audiosource.h"
+#include "audiometer.h"
+#include "vadindex.h"
+#include "streamposition.h"
+#include "waveformthread.h"
+#include "audiolevels.h"
+#include "startbarrier.h"
+#include "masterclock.h"
+#include "metrics.h"
+#include "volumes.h"
+#include "preroll.h"
+
+// ---------------------------------------------------------------------
+
+// The logs shared by all audio streams stay in the meeting directory
+// even when a stream is written to another volume.
+static QString meetingFile(const QString &filename, const QString &name) {
+    QString dir = Volumes::meeting();
+    if (dir.isEmpty())
+        dir = QFileInfo(filename).path();
+    return dir+"/"+name;
+}
+
+// ---------------------------------------------------------------------
+
+AudioCaptureThread::AudioCaptureThread(const QString &st, AudioSource *s,
+                                       AudioRing *r, int rate, int channels,
+                                       int period)
+    : stream(st), source(s), ring(r), period_frames(period), rate_(rate),
+      channels_(channels), xruns_(0), overruns_(0), loop(1)
+{
+}
+
+// ---------------------------------------------------------------------
+
+AudioCaptureThread::~AudioCaptureThread() {
+    delete source;
+}
+
+// ---------------------------------------------------------------------
+
+void AudioCaptureThread::breakLoop() {
+    loop.store(0);
+}
+
+// ---------------------------------------------------------------------
+
+void AudioCaptureThread::run() {
+#ifdef Q_OS_LINUX
+    // QThread::TimeCriticalPriority has no effect under SCHED_OTHER,
+    // ask for real-time scheduling (needs rtprio in limits.conf):
+    struct sched_param param;
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO)+10;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param))
+        qDebug() << "AudioCaptureThread: SCHED_FIFO not permitted";
+#endif
+
+    if (!source->open(rate_.load(), channels_.load(), period_frames)) {
+        emit errorMessage(source->errorString());
+        return;
+    }
+    rate_.store(source->rate());
+    channels_.store(source->channels());
+
+    int frames = qMin(period_frames, ring->chunkBytes()/source->frameBytes());
+    QByteArray scratch(ring->chunkBytes(), 0);
+    qint64 position = 0;
+    bool lost = false;
+
+    qDebug() << "AudioCaptureThread:" << stream << "rate" << source->rate()
+             << "channels" << source->channels() << "period" << frames;
+    Metrics::set(stream+".period_frames", frames);
+
+    while (loop.load()) {
+        AudioRing::Chunk *chunk = ring->beginWrite();
+        char *data = chunk ? chunk->data : scratch.data();
+
+        bool xrun = false;
+        int n = source->read(data, frames, xrun);
+        if (n < 0) {
+            emit errorMessage(source->errorString());
+            break;
+        }
+        if (xrun) {
+            xruns_.ref();
+            Metrics::add(stream+".xruns", 1);
+            lost = true;
+        }
+        if (n == 0)
+            continue;
+
+        // Time of the last frame read, the device may already hold
+        // newer ones:
+        qint64 t_ns = MasterClock::nsecs();
+        qint64 delay = source->delay();
+        if (delay > 0)
+            t_ns -= delay*1000000000LL/source->rate();
+
+        if (!chunk) {
+            overruns_.ref();
+            Metrics::add(stream+".overruns", 1);
+            lost = true;
+        } else {
+            chunk->t_ns = t_ns;
+            chunk->first_frame = position;
+            chunk->frames = n;
+            chunk->lost = lost ? -1 : 0;
+            ring->endWrite();
+            lost = false;
+        }
+        position += n;
+    }
+
+    source->close();
+}
+
+// ---------------------------------------------------------------------
+
+AudioWriterThread::AudioWriterThread(const QString &st, AudioRing *r,
+                                     AudioCaptureThread *c,
+                                     const QString &f,
+                                     const AudioEncoder::Settings &s,
+                                     int ms, int common, bool use)
+    : stream(st), ring(r), capture(c), filename(f), meter(NULL),
+      barrier(NULL), settings(s), buffer_ms(ms), use_vad(false),
+      use_peaks(false),
+      failed(false), common_rate(common), use_resampler(use), drift(NULL),
+      resampler(NULL), drift_logged_ns(0), run_start_ns(0),
+      run_start_frames(0), due_frames(0), fill_gaps(false),
+      prev_end_frame(-1), prev_t_ns(0), preroll(NULL), standby(false),
+      preroll_flush(false), record_requested(0), paused(0),
+      start_pending(1), frames_written(0), out_rate(0), loop(1)
+{
+}
+
+// ---------------------------------------------------------------------
+
+AudioWriterThread::~AudioWriterThread() {
+    delete drift;
+    delete resampler;
+    delete preroll;
+}
+
+// ---------------------------------------------------------------------
+
+void AudioWriterThread::setPreRoll(bool on) {
+    standby = on;
+    if (on && !preroll)
+        preroll = new PreRoll(stream);
+}
+
+// ---------------------------------------------------------------------
+
+void AudioWriterThread::record(const QString &f,
+                               const AudioEncoder::Settings &s) {
+    pending_filename = f;
+    pending_settings = s;
+    record_requested.storeRelease(1);
+}
+
+// ---------------------------------------------------------------------
+
+void AudioWriterThread::setPaused(bool p) {
+    if (!p)
+        start_pending.store(1);
+    paused.store(p);
+}
+
+// ---------------------------------------------------------------------
+
+void AudioWriterThread::breakLoop() {
+    loop.store(0);
+}
+
+// ---------------------------------------------------------------------
+
+void AudioWriterThread::run() {
+    for (;;) {
+        // Check the flag before reading so that the ring is drained
+        // after the capture thread has stopped:
+        bool last = !loop.load();
+        AudioRing::Chunk *chunk = ring->beginRead();
+        if (!chunk) {
+            if (last)
+                break;
+            msleep(5);
+            continue;
+        }
+        process(chunk);
+        ring->endRead();
+    }
+
+    foreach (AudioSinkThread *sink, sinks) {
+        qint64 gap = sink->finish();
+        if (gap > 0)
+            logSinkGap(sink, gap, frames_written.load()-gap);
+    }
+    foreach (AudioSinkThread *sink, sinks) {
+        sink->wait();
+        delete sink;
+    }
+    sinks.clear();
+    if (drift && drift->isValid())
+        Metrics::set(stream+".drift_ppm", qRound(drift->ppm()));
+}
+
+// ---------------------------------------------------------------------
+
+// Opened on the first period, when the format is known
+bool AudioWriterThread::openSinks() {
+    int rate = capture->rate(), channels = capture->channels();
+    if (use_resampler) {
+        resampler = new Resampler(channels);
+        if (resampler->isValid())
+            rate = common_rate;
+        else
+            use_resampler = false;
+    }
+    out_rate.store(rate);
+
+    AudioEncoder *e = AudioEncoder::create(settings);
+    if (!e->open(filename, rate, channels)) {
+        emit errorMessage(filename+": "+e->errorString());
+        delete e;
+        return false;
+    }
+
+    qint64 max_bytes = qint64(buffer_ms)*rate/1000*channels*2;
+    sinks << new AudioEncoderThread(e, stream, filename, rate, channels,
+                                    max_bytes);
+    QString dir = QFileInfo(filename).path();
+    if (use_vad)
+        sinks << new VadIndexThread(stream, dir, rate, channels, max_bytes);
+    if (use_peaks)
+        sinks << new WaveformThread(stream, dir, rate, channels, max_bytes);
+
+    foreach (AudioSinkThread *sink, sinks) {
+        connect(sink, SIGNAL(errorMessage(const QString&)),
+                this, SIGNAL(errorMessage(const QString&)),
+                Qt::DirectConnection);
+        sink->start();
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+// The frames are counted in frames_written only after the push, so
+// a gap closed by this block ends at frames_written.
+void AudioWriterThread::push(const char *data, int frames) {
+    foreach (AudioSinkThread *sink, sinks) {
+        qint64 gap = 0;
+        sink->push(data, frames, gap);
+        if (gap > 0)
+            logSinkGap(sink, gap, frames_written.load()-gap);
+    }
+}
+
+// ---------------------------------------------------------------------
+
+// Blocks a sink could not keep up with were replaced with silence
+// there.  Logged once the gap is over and its length known.
+void AudioWriterThread::logSinkGap(AudioSinkThread *sink, qint64 gap,
+                                   qint64 file_frame) {
+    int rate = out_rate.load();
+    qint64 lost_ms = rate > 0 ? gap*1000/rate : 0;
+    Metrics::add(stream+".gaps", 1);
+    Metrics::add(stream+".gap_ms", lost_ms);
+    qWarning() << "WARNING:" << stream << sink->sinkName() << "dropped"
+               << gap << "frames, replaced with silence";
+    logContinuity(prev_t_ns, file_frame, gap, lost_ms,
+                  sink->sinkName()+"_drop", true);
+}
+
+// ---------------------------------------------------------------------
+
+void AudioWriterThread::process(AudioRing::Chunk *chunk) {
+    int channels = capture->channels();
+    int frame_bytes = channels*2;
+
+    qint64 lost = checkContinuity(chunk);
+    trackDrift(chunk);
+
+    if (standby) {
+        if (!record_requested.loadAcquire()) {
+            if (meter)
+                meter->processFrames(chunk->data, chunk->frames, channels,
+                                     AudioLevels::Int16);
+            buffer(chunk);
+            return;
+        }
+        standby = false;
+        filename = pending_filename;
+        settings = pending_settings;
+        // The barrier is armed before record(), so the pre-roll can
+        // be reported right away:
+        if (barrier && barrier->isArmed()) {
+            qint64 oldest = preroll->hold(MasterClock::nsecs());
+            if (oldest >= 0) {
+                barrier->setBuffered(stream, oldest);
+                preroll_flush = true;
+            }
+        }
+        if (!preroll_flush)
+            preroll->clear();
+    }
+
+    if (paused.load() || failed)
+        return;
+
+    if (meter)
+        meter->processFrames(chunk->data, chunk->frames, channels,
+                             AudioLevels::Int16);
+
+    if (sinks.isEmpty() && !openSinks()) {
+        failed = true;
+        return;
+    }
+
+    int offset = 0;
+    if (start_pending.load()) {
+        if (!waitForStart(chunk, offset)) {
+            if (preroll_flush)
+                buffer(chunk);
+            return;
+        }
+    } else if (lost > 0 && fill_gaps)
+        writeSilence(lost);
+
+    // A block dropped by a sink is replaced with silence there, so the
+    // position still follows the capture:
+    int n;
+    if (use_resampler)
+        n = resample(chunk, offset);
+    else {
+        n = chunk->frames-offset;
+        push(chunk->data+offset*frame_bytes, n);
+    }
+    qint64 total = frames_written.fetchAndAddOrdered(n)+n;
+
+    // Chunk::t_ns is when the last frame of the period was captured,
+    // and that frame is the last one written.  A resampler that has
+    // not yet produced output leaves the previous pair in place.
+    if (n > 0)
+        StreamPosition::set(stream, 0, total-1, chunk->t_ns);
+}
+
+// ---------------------------------------------------------------------
+
+// Drops periods until the common start instant, and returns the
+// offset of the first frame to write in the period that contains it.
+// Unlike the cameras, audio can start on the exact sample.
+bool AudioWriterThread::waitForStart(AudioRing::Chunk *chunk, int &offset) {
+    qint64 rate = capture->rate();
+    qint64 first_ns = chunk->t_ns-(chunk->frames-1)*1000000000LL/rate;
+
+    offset = 0;
+    run_start_frames = frames_written.load();
+    due_frames = run_start_frames;
+
+    if (!barrier || !barrier->isArmed()) {
+        run_start_ns = first_ns;
+        start_pending.store(0);
+        return true;
+    }
+
+    barrier->ready(stream);
+    qint64 start_ns = barrier->startTime();
+    if (start_ns < 0 || chunk->t_ns < start_ns)
+        return false;
+
+    if (preroll_flush) {
+        preroll_flush = false;
+        qint64 from_ns = flushPreRoll(barrier->recordFrom(), first_ns);
+        if (from_ns >= 0) {
+            barrier->setStartIndex(stream, run_start_frames, from_ns);
+            start_pending.store(0);
+            return true;
+        }
+    }
+
+    if (start_ns > first_ns)
+        offset = qMin<qint64>((start_ns-first_ns)*rate/1000000000LL,
+                              chunk->frames-1);
+
+    run_start_ns = start_ns;
+    barrier->setStartIndex(stream, run_start_frames, start_ns);
+    start_pending.store(0);
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+void AudioWriterThread::buffer(AudioRing::Chunk *chunk) {
+    qint64 rate = capture->rate();
+    qint64 first_ns = chunk->t_ns-(chunk->frames-1)*1000000000LL/rate;
+    int bytes = chunk->frames*capture->channels()*2;
+    preroll->push(first_ns, chunk->first_frame, chunk->frames,
+                  QByteArray(chunk->data, bytes));
+}
+
+// ---------------------------------------------------------------------
+
+// Writes the buffered periods from the common start of the pre-roll
+// up to the period that reached the start instant, on the exact
+// sample like the start itself.  Returns the master clock time of the
+// first frame written, or -1 if there was none.
+qint64 AudioWriterThread::flushPreRoll(qint64 from_ns, qint64 until_ns) {
+    qint64 rate = capture->rate();
+    int frame_bytes = capture->channels()*2;
+
+    qint64 index, t_ns;
+    if (from_ns < 0 || !preroll->trim(from_ns, until_ns, index, t_ns)) {
+        preroll->clear();
+        return -1;
+    }
+    int offset = from_ns > t_ns ? int((from_ns-t_ns)*rate/1000000000LL) : 0;
+    run_start_ns = t_ns+offset*1000000000LL/rate;
+
+    PreRoll::Entry e;
+    qint64 written = 0;
+    while (preroll->take(from_ns, until_ns, e)) {
+        AudioRing::Chunk c;
+        c.t_ns = e.t_ns+(e.frames-1)*1000000000LL/rate;
+        c.first_frame = e.index;
+        c.frames = e.frames;
+        c.lost = 0;
+        c.data = e.data.data();
+        int skip = written ? 0 : qMin(offset, e.frames-1);
+        int n;
+        if (use_resampler)
+            n = resample(&c, skip);
+        else {
+            n = c.frames-skip;
+            push(c.data+skip*frame_bytes, n);
+        }
+        frames_written.fetchAndAddOrdered(n);
+        written += n;
+    }
+    Metrics::set(stream+".preroll_frames", written);
+    qDebug() << stream << ":" << written << "frames of pre-roll";
+    return run_start_ns;
+}
+
+// ---------------------------------------------------------------------
+
+// Compares each period with the one before.  Periods dropped from a
+// full ring show up exactly in the frame count; frames lost by the
+// device are estimated from the timestamps, which are only trusted
+// when the source reported an xrun.  Returns the frames lost.
+qint64 AudioWriterThread::checkContinuity(AudioRing::Chunk *chunk) {
+    qint64 lost = 0;
+    const char *cause = "";
+    double rate = drift && drift->isValid() ? drift->rate() :
+        double(capture->rate());
+
+    if (prev_end_frame >= 0) {
+        if (chunk->first_frame > prev_end_frame) {
+            lost = chunk->first_frame-prev_end_frame;
+            cause = "overrun";
+        } else if (chunk->lost) {
+            double first_ns = chunk->t_ns-(chunk->frames-1)*1e9/rate;
+            double due_ns = prev_t_ns+1e9/rate;
+            lost = qMax(0LL, qRound64((first_ns-due_ns)*1e-9*rate));
+            cause = "xrun";
+        }
+    }
+    prev_end_frame = chunk->first_frame+chunk->frames;
+    prev_t_ns = chunk->t_ns;
+    // There is no file to keep in time in standby:
+    if (lost <= 0 || standby)
+        return 0;
+
+    qint64 lost_ms = qRound64(lost*1000/rate);
+    Metrics::add(stream+".gaps", 1);
+    Metrics::add(stream+".gap_ms", lost_ms);
+
+    bool filled = fill_gaps && !start_pending.load() && !paused.load();
+    qWarning() << "WARNING:" << stream << "lost" << lost << "frames ("
+               << cause << ")";
+
+    logContinuity(chunk->t_ns, frames_written.load(), lost, lost_ms, cause,
+                  filled);
+    return lost;
+}
+
+// ---------------------------------------------------------------------
+
+void AudioWriterThread::logContinuity(qint64 t_ns, qint64 file_frame,
+                                      qint64 lost, qint64 lost_ms,
+                                      const QString &cause, bool filled) {
+    QFile file(meetingFile(filename, "continuity.txt"));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append |
+                   QIODevice::Text))
+        return;
+    QTextStream out(&file);
+    if (file.size() == 0)
+        out << "# master_ns stream file_frame lost_frames lost_ms cause"
+            << " filled\n";
+    out << t_ns << " " << stream << " " << file_frame << " " << lost << " "
+        << lost_ms << " " << cause << " " << (filled ? 1 : 0) << "\n";
+}
+
+// ---------------------------------------------------------------------
+
+// Keeps the file time-linear over a gap.  Silence needs no
+// resampling, only the length is converted.
+void AudioWriterThread::writeSilence(qint64 lost) {
+    double in_rate = drift && drift->isValid() ? drift->rate() :
+        double(capture->rate());
+    qint64 n = use_resampler ? qRound64(lost*common_rate/in_rate) : lost;
+
+    // A bogus timestamp must not write hours of silence:
+    n = qMin<qint64>(n, qint64(out_rate.load())*MaxFillSeconds);
+
+    int channels = capture->channels();
+    int block = 4096;
+    QByteArray zeros(block*channels*2, 0);
+    for (qint64 done = 0; done < n; done += block)
+        push(zeros.constData(), int(qMin<qint64>(block, n-done)));
+    frames_written.fetchAndAddOrdered(n);
+}
+
+// ---------------------------------------------------------------------
+
+// Follows the device rate on the master clock and logs it to
+// drift.txt every ten seconds, also while paused.
+void AudioWriterThread::trackDrift(AudioRing::Chunk *chunk) {
+    if (!drift)
+        drift = new DriftEstimator(capture->rate());
+
+    // Lost frames would show up as a jump, not as drift:
+    if (chunk->lost)
+        drift->reset();
+    drift->add(chunk->first_frame+chunk->frames, chunk->t_ns);
+
+    if (standby || !drift->isValid() ||
+        chunk->t_ns-drift_logged_ns < 10000000000LL)
+        return;
+    drift_logged_ns = chunk->t_ns;
+    Metrics::set(stream+".drift_ppm", qRound(drift->ppm()));
+
+    QFile file(meetingFile(filename, "drift.txt"));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append |
+                   QIODevice::Text))
+        return;
+    QTextStream out(&file);
+    if (file.size() == 0)
+        out << "# master_ns stream frames rate_hz ppm\n";
+    out << chunk->t_ns << " " << stream << " "
+        << chunk->first_frame+chunk->frames << " "
+        << QString::number(drift->rate(), 'f', 3) << " "
+        << QString::number(drift->ppm(), 'f', 2) << "\n";
+}
+
+// ---------------------------------------------------------------------
+
+// Converts a period from the estimated device rate to the common rate
+// on the master clock.  Any remaining offset from the due output
+// count (start-up, lost frames) is closed over about ten seconds.
+int AudioWriterThread::resample(AudioRing::Chunk *chunk, int offset) {
+    int channels = capture->channels();
+    double ratio = common_rate/(drift->isValid() ? drift->rate() :
+                                double(capture->rate()));
+    double error = due_frames-frames_written.load();
+    ratio *= 1.0+qBound(-0.001, error/(common_rate*10.0), 0.001);
+
+    const qint16 *in = reinterpret_cast<const qint16*>(chunk->data);
+    int n = resampler->process(in+offset*channels, chunk->frames-offset,
+                               ratio, resampled);
+    if (n > 0)
+        push(reinterpret_cast<const char*>(resampled.constData()), n);
+
+    due_frames = run_start_frames+
+        (chunk->t_ns-run_start_ns)*1e-9*common_rate;
+    return n;
+}
+
+// ---------------------------------------------------------------------
+
+AudioRecorder::AudioRecorder(QObject *parent) : QObject(parent),
+                                                rate(48000), channels(2),
+                                                resampling(false),
+                                                vad(true), peaks(true),
+                                                fill_gaps(true),
+                                                preroll(false),
+                                                state_(QMediaRecorder::StoppedState),
+                                                status_(QMediaRecorder::LoadedStatus),
+                                                error_(QMediaRecorder::NoError),
+                                                duration_(0), meter(NULL),
+                                                barrier(NULL)
+{
+    QSettings settings;
+    period_frames = settings.value("audio/period_frames", 1024).toInt();
+    if (period_frames < 32)
+        period_frames = 32;
+    encoder_buffer_ms = settings.value("audio/encoder_buffer_ms",
+                                       30000).toInt();
+    vad = settings.value("audio/vad", true).toBool();
+    peaks = settings.value("audio/peaks", true).toBool();
+    encoding.flush_ms = settings.value("audio/flush_ms", 1000).toInt();
+    fill_gaps = settings.value("audio/fill_gaps", true).toBool();
+
+    timer = new QTimer(this);
+    connect(timer, SIGNAL(timeout()), this, SLOT(poll()));
+
+    setInputs(QStringList() << QString());
+}
+
+// ---------------------------------------------------------------------
+
+AudioRecorder::~AudioRecorder() {
+    shutdown();
+}
+
+// ---------------------------------------------------------------------
+
+QStringList AudioRecorder::audioInputs() const {
+    return AudioSource::devices();
+}
+
+// ---------------------------------------------------------------------
+
+void AudioRecorder::setAudioInput(const QString &name) {
+    QStringList names;
+    names << name;
+    for (int i = 1; i < devices.size(); ++i)
+        names << devices[i].input;
+    setInputs(names);
+}
+
+// ---------------------------------------------------------------------
+
+void AudioRecorder::setExtraAudioInputs(const QStringList &extra) {
+    setInputs(QStringList() << devices[0].input << extra);
+}
+
+// ---------------------------------------------------------------------
+
+// Stream names follow the position, so the barrier needs to know
+// about added and removed devices before it is armed.
+void AudioRecorder::setInputs(const QStringList &names) {
+    if (state_ != QMediaRecorder::StoppedState) {
+        qWarning() << "WARNING: AudioRecorder: cannot change inputs while"
+                   << "recording";
+        return;
+    }
+
+    QStringList old;
+    foreach (const Device &d, devices)
+        old << d.input;
+    if (names == old)
+        return;
+    bool restart = isStandingBy();
+    if (restart)
+        shutdown();
+
+    for (int i = names.size(); i < devices.size(); ++i)
+        if (barrier)
+            barrier->leave(devices[i].stream);
+    while (devices.size() > names.size())
+        devices.removeLast();
+
+    for (int i = 0; i < names.size(); ++i) {
+        if (i == devices.size()) {
+            Device d;
+            d.stream = i ? QString("audio%1").arg(i) : QString("audio");
+            d.ring = NULL;
+            d.capture = NULL;
+            d.writer = NULL;
+            devices.append(d);
+            if (barrier)
+                barrier->join(d.stream);
+        }
+        devices[i].input = names[i];
+    }
+    if (restart)
+        startDevices(true);
+}
+
+// ---------------------------------------------------------------------
+
+void AudioRecorder::setResampling(bool on) {
+    if (on == resampling)
+        return;
+    resampling = on;
+    if (isStandingBy()) {
+        shutdown();
+        startDevices(true);
+    }
+}
+
+// ---------------------------------------------------------------------
+
+void AudioRecorder::setPreRoll(bool on) {
+    preroll = on;
+    if (state_ != QMediaRecorder::StoppedState)
+        return;
+    if (on && !isStandingBy())
+        startDevices(true);
+    else if (!on && isStandingBy())
+        shutdown();
+}
+
+// ---------------------------------------------------------------------
+
+bool AudioRecorder::isStandingBy() const {
+    return state_ == QMediaRecorder::StoppedState && !devices.isEmpty() &&
+        devices[0].writer;
+}
+
+// ---------------------------------------------------------------------
+
+void AudioRecorder::setStartBarrier(StartBarrier *b) {
+    barrier = b;
+    if (barrier)
+        foreach (const Device &d, devices)
+            barrier->join(d.stream);
+}
+
+// ---------------------------------------------------------------------
+
+QStringList AudioRecorder::supportedAudioCodecs() const {
+    return AudioEncoder::codecNames();
+}
+
+// ---------------------------------------------------------------------
+
+QStringList AudioRecorder::supportedContainers() const {
+    return AudioEncoder::containers();
+}
+
+// ---------------------------------------------------------------------
+
+QList<int> AudioRecorder::supportedAudioSampleRates() const {
+    return QList<int>() << 8000 << 16000 << 22050 << 32000 << 44100
+                        << 48000 << 96000;
+}
+
+// ---------------------------------------------------------------------
+
+// Each codec has a fixed container, so the container is only used if
+// no codec is given.
+void AudioRecorder::setEncodingSettings(const QAudioEncoderSettings &audio,
+                                        const QVideoEncoderSettings&,
+                                        const QString &container) {
+    int old_rate = rate, old_channels = channels;
+    rate = audio.sampleRate() > 0 ? audio.sampleRate() : 48000;
+    channels = audio.channelCount() > 0 ? audio.channelCount() : 2;
+    // The pre-roll is lost only if the capture format changes:
+    if (isStandingBy() && (rate != old_rate || channels != old_channels)) {
+        shutdown();
+        startDevices(true);
+    }
+    encoding.codec = AudioEncoder::codecFromName(audio.codec().isEmpty() ?
+                                                 container : audio.codec());
+    encoding.bitrate = audio.bitRate();
+    encoding.quality = audio.quality();
+}
+
+// ---------------------------------------------------------------------
+
+void AudioRecorder::setOutputLocation(const QUrl &l) {
+    location = l;
+}
+
+// ---------------------------------------------------------------------
+
+QString AudioRecorder::outputFile() const {
+    return outputFile(0);
+}
+
+// ---------------------------------------------------------------------
+
+QStringList AudioRecorder::outputFiles() const {
+    QStringList files;
+    for (int i = 0; i < devices.size(); ++i)
+        files << outputFile(i);
+    return files;
+}
+
+// ---------------------------------------------------------------------
+
+QString AudioRecorder::outputFile(int i) const {
+    QFileInfo info(location.toLocalFile());
+    QString base = info.completeBaseName();
+    if (i > 0)
+        base += QString::number(i);
+    QString dir;
+    if (i < devices.size())
+        dir = Volumes::directory(devices.at(i).stream);
+    if (dir.isEmpty())
+        dir = info.path();
+    return dir+"/"+base+"."+AudioEncoder::suffix(encoding.codec);
+}
+
+// ---------------------------------------------------------------------
+
+void AudioRecorder::record() {
+    if (state_ == QMediaRecorder::PausedState) {
+        foreach (const Device &d, devices)
+            d.writer->setPaused(false);
+        setState(QMediaRecorder::RecordingState);
+        setStatus(QMediaRecorder::RecordingStatus);
+        return;
+    }
+    if (state_ != QMediaRecorder::StoppedState)
+        return;
+
+    error_ = QMediaRecorder::NoError;
+    error_string.clear();
+    duration_ = 0;
+
+    // A device that failed in standby is opened again:
+    bool running = isStandingBy();
+    foreach (const Device &d, devices)
+        if (running && d.capture->isFinished())
+            running = false;
+    if (!running) {
+        shutdown();
+        startDevices(false);
+    }
+    for (int i = 0; i < devices.size(); ++i)
+        devices[i].writer->record(outputFile(i), encoding);
+    timer->start(250);
+
+    setState(QMediaRecorder::RecordingState);
+    setStatus(QMediaRecorder::RecordingStatus);
+}
+
+// ---------------------------------------------------------------------
+
+// In standby the writers only keep the pre-roll, record() gives them
+// their files.
+void AudioRecorder::startDevices(bool standby) {
+    // About two seconds of slack for each writer:
+    int nchunks = qMax(16, 2*rate/period_frames);
+
+    for (int i = 0; i < devices.size(); ++i) {
+        Device &d = devices[i];
+        d.ring = new AudioRing(nchunks, period_frames*channels*2);
+        d.capture = new AudioCaptureThread(d.stream,
+                                           AudioSource::create(d.input),
+                                           d.ring, rate, channels,
+                                           period_frames);
+        d.writer = new AudioWriterThread(d.stream, d.ring, d.capture,
+                                         standby ? QString() : outputFile(i),
+                                         encoding, encoder_buffer_ms, rate,
+                                         resampling);
+        if (i == 0)
+            d.writer->setMeter(meter);
+        d.writer->setStartBarrier(barrier);
+        d.writer->setVoiceActivity(vad);
+        d.writer->setWaveform(peaks);
+        d.writer->setGapFilling(fill_gaps);
+        d.writer->setPreRoll(standby);
+        connect(d.capture, SIGNAL(errorMessage(const QString&)),
+                this, SLOT(threadError(const QString&)));
+        connect(d.writer, SIGNAL(errorMessage(const QString&)),
+                this, SLOT(threadError(const QString&)));
+
+        d.writer->start();
+        d.capture->start(QThread::TimeCriticalPriority);
+    }
+}
+
+// ---------------------------------------------------------------------
+
+void AudioRecorder::pause() {
+    if (state_ != QMediaRecorder::RecordingState)
+        return;
+    foreach (const Device &d, devices)
+        d.writer->setPaused(true);
+    setState(QMediaRecorder::PausedState);
+    setStatus(QMediaRecorder::PausedStatus);
+}
+
+// ---------------------------------------------------------------------
+
+void AudioRecorder::stop() {
+    if (state_ == QMediaRecorder::StoppedState)
+        return;
+    shutdown();
+    setState(QMediaRecorder::StoppedState);
+    setStatus(QMediaRecorder::LoadedStatus);
+    if (preroll)
+        startDevices(true);
+}
+
+// ---------------------------------------------------------------------
+
+void AudioRecorder::shutdown() {
+    timer->stop();
+    for (int i = 0; i < devices.size(); ++i)
+        if (devices[i].capture)
+            devices[i].capture->breakLoop();
+
+    for (int i = 0; i < devices.size(); ++i) {
+        Device &d = devices[i];
+        if (d.capture)
+            d.capture->wait();
+        if (d.writer) {
+            d.writer->breakLoop();
+            d.writer->wait();
+            if (i == 0)
+                poll();
+            Metrics::set(d.stream+".frames", d.writer->framesWritten());
+        }
+        delete d.writer;
+        delete d.capture;
+        delete d.ring;
+        d.writer = NULL;
+        d.capture = NULL;
+        d.ring = NULL;
+    }
+}
+
+// ---------------------------------------------------------------------
+
+void AudioRecorder::poll() {
+    if (devices.isEmpty())
+        return;
+    const Device &d = devices[0];
+    if (!d.writer || d.writer->outputRate() <= 0)
+        return;
+    qint64 ms = d.writer->framesWritten()*1000/d.writer->outputRate();
+    if (ms != duration_) {
+        duration_ = ms;
+        emit durationChanged(duration_);
+    }
+    foreach (const Device &dev, devices)
+        if (dev.ring)
+            Metrics::set(dev.stream+".ring_fill", dev.ring->fill());
+}
+
+// ---------------------------------------------------------------------
+
+void AudioRecorder::threadError(const QString &message) {
+    // Both threads may fail for the same reason:
+    if (state_ == QMediaRecorder::StoppedState)
+        return;
+    qWarning() << "AudioRecorder:" << message;
+    error_string = message;
+    error_ = QMediaRecorder::ResourceError;
+    emit error(error_);
+    stop();
+}
+
+// ---------------------------------------------------------------------
+
+void AudioRecorder::setState(QMediaRecorder::State s) {
+    if (s == state_)
+        return;
+    state_ = s;
+    emit stateChanged(state_);
+}
+
+// ---------------------------------------------------------------------
+
+void AudioRecorder::setStatus(QMediaRecorder::Status s) {
+    if (s == status_)
+        return;
+    status_ = s;
+    emit statusChanged(status_);
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,333 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef AUDIORECORDER_H
+#define AUDIORECORDER_H
+
+#include <QObject>
+#include <QThread>
+#include <QAtomicInt>
+#include <QMediaRecorder>
+#include <QAudioEncoderSettings>
+#include <QVideoEncoderSettings>
+#include <QStringList>
+#include <QVector>
+#include <QUrl>
+
+#include "audioring.h"
+#include "audioencoder.h"
+#include "audiodrift.h"
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
+class AudioSource;
+class AudioMeter;
+class StartBarrier;
+class PreRoll;
+
+/// Reads periods from an AudioSource into the ring on a high-priority
+/// thread.  Does nothing else, so that it is never late for the
+/// device.
+class AudioCaptureThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    AudioCaptureThread(const QString &stream, AudioSource *source,
+                       AudioRing *ring, int rate, int channels,
+                       int period_frames);
+    ~AudioCaptureThread();
+
+    void breakLoop();
+
+    /// Valid once the first chunk is in the ring
+    int rate() const { return rate_.load(); }
+    int channels() const { return channels_.load(); }
+
+    /// Device overruns reported by the source
+    int xruns() const { return xruns_.load(); }
+    /// Periods dropped because the ring was full
+    int overruns() const { return overruns_.load(); }
+
+signals:
+    void errorMessage(const QString&);
+
+protected:
+    void run();
+
+private:
+    QString stream;
+    AudioSource *source;
+    AudioRing *ring;
+    int period_frames;
+
+    QAtomicInt rate_;
+    QAtomicInt channels_;
+    QAtomicInt xruns_;
+    QAtomicInt overruns_;
+    QAtomicInt loop;
+};
+
+// ---------------------------------------------------------------------
+
+/// Consumes the ring: feeds the meter, waits for the common start
+/// instant and passes the periods on to the sinks: an
+/// AudioEncoderThread and optionally a VadIndexThread and a
+/// WaveformThread.
+///
+/// The writer also estimates the drift of the device clock against
+/// the master clock.  With resampling, the file is written at the
+/// common rate on the master clock, so that files from different
+/// devices stay sample-aligned.
+class AudioWriterThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    AudioWriterThread(const QString &stream, AudioRing *ring,
+                      AudioCaptureThread *capture, const QString &filename,
+                      const AudioEncoder::Settings &settings,
+                      int buffer_ms, int common_rate, bool resample);
+    ~AudioWriterThread();
+
+    void setMeter(AudioMeter *m) { meter = m; }
+    void setStartBarrier(StartBarrier *b) { barrier = b; }
+    void setVoiceActivity(bool on) { use_vad = on; }
+    void setWaveform(bool on) { use_peaks = on; }
+
+    /// Write silence over lost frames, so that the file stays in time
+    void setGapFilling(bool on) { fill_gaps = on; }
+
+    /// While paused periods are dropped.  Resuming waits for a new
+    /// start instant.
+    void setPaused(bool);
+
+    /// Starts in standby, before start(): the periods are kept in a
+    /// PreRoll instead of being written, until record()
+    void setPreRoll(bool on);
+
+    /// Leaves standby and writes the file, beginning with the pre-roll
+    void record(const QString &filename, const AudioEncoder::Settings &);
+
+    void breakLoop();
+
+    qint64 framesWritten() const { return frames_written.load(); }
+    int outputRate() const { return out_rate.load(); }
+
+signals:
+    void errorMessage(const QString&);
+
+protected:
+    void run();
+
+private:
+    void process(AudioRing::Chunk *chunk);
+    bool waitForStart(AudioRing::Chunk *chunk, int &offset);
+    void buffer(AudioRing::Chunk *chunk);
+    qint64 flushPreRoll(qint64 from_ns, qint64 until_ns);
+    bool openSinks();
+    void push(const char *data, int frames);
+    void logSinkGap(AudioSinkThread *sink, qint64 gap, qint64 file_frame);
+    qint64 checkContinuity(AudioRing::Chunk *chunk);
+    void logContinuity(qint64 t_ns, qint64 file_frame, qint64 lost,
+                       qint64 lost_ms, const QString &cause, bool filled);
+    void writeSilence(qint64 frames);
+    void trackDrift(AudioRing::Chunk *chunk);
+    int resample(AudioRing::Chunk *chunk, int offset);
+
+    QString stream;
+    AudioRing *ring;
+    AudioCaptureThread *capture;
+    QString filename;
+    AudioMeter *meter;
+    StartBarrier *barrier;
+
+    AudioEncoder::Settings settings;
+    int buffer_ms;
+    bool use_vad;
+    bool use_peaks;
+    QList<AudioSinkThread*> sinks;
+    bool failed;
+
+    int common_rate;
+    bool use_resampler;
+    DriftEstimator *drift;
+    Resampler *resampler;
+    QVector<qint16> resampled;
+    qint64 drift_logged_ns;
+
+    /// Start of the current run (after record or resume) and the
+    /// output frames due at the end of the previous period
+    qint64 run_start_ns;
+    qint64 run_start_frames;
+    double due_frames;
+
+    /// Continuity, see continuity.txt
+    static const int MaxFillSeconds = 10;
+    bool fill_gaps;
+    qint64 prev_end_frame;
+    qint64 prev_t_ns;
+
+    /// Standby is only touched on the writer thread, the output comes
+    /// from record() through pending_*
+    PreRoll *preroll;
+    bool standby;
+    bool preroll_flush;
+    QString pending_filename;
+    AudioEncoder::Settings pending_settings;
+    QAtomicInt record_requested;
+
+    QAtomicInt paused;
+    QAtomicInt start_pending;
+    QAtomicInteger<qint64> frames_written;
+    QAtomicInt out_rate;
+    QAtomicInt loop;
+};
+
+// ---------------------------------------------------------------------
+
+/// Audio recorder with its own capture engine.
+///
+/// Provides the parts of the QAudioRecorder interface used by
+/// AvRecorder, but captures through an AudioSource with a known
+/// period size on its own thread, and writes the file itself.
+///
+/// Extra devices can be recorded at the same time, each with its own
+/// threads and file.  The main device is stream "audio" in
+/// audio.<suffix>, the extra ones "audio1", "audio2", ... in files
+/// named likewise.  Only the main device drives the level meter.
+class AudioRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    AudioRecorder(QObject *parent = 0);
+    ~AudioRecorder();
+
+    QStringList audioInputs() const;
+    void setAudioInput(const QString &name);
+    void setExtraAudioInputs(const QStringList &names);
+
+    /// Resample every device to the common rate on the master clock
+    void setResampling(bool on);
+
+    QStringList supportedAudioCodecs() const;
+    QStringList supportedContainers() const;
+    QList<int> supportedAudioSampleRates() const;
+
+    void setEncodingSettings(const QAudioEncoderSettings &audio,
+                             const QVideoEncoderSettings &video =
+                             QVideoEncoderSettings(),
+                             const QString &container = QString());
+    void setOutputLocation(const QUrl &location);
+
+    /// The main file actually written, its suffix follows the codec
+    QString outputFile() const;
+    QStringList outputFiles() const;
+
+    QMediaRecorder::State state() const { return state_; }
+    QMediaRecorder::Status status() const { return status_; }
+    QMediaRecorder::Error error() const { return error_; }
+    QString errorString() const { return error_string; }
+    qint64 duration() const { return duration_; }
+
+    void setMeter(AudioMeter *m) { meter = m; }
+    void setStartBarrier(StartBarrier *b);
+
+    /// Captures also while stopped, keeping the last "preroll/seconds"
+    /// in memory for the next record()
+    void setPreRoll(bool on);
+
+public slots:
+    void record();
+    void pause();
+    void stop();
+
+signals:
+    void durationChanged(qint64);
+    void statusChanged(QMediaRecorder::Status);
+    void stateChanged(QMediaRecorder::State);
+    void error(QMediaRecorder::Error);
+
+private slots:
+    void poll();
+    void threadError(const QString&);
+
+private:
+    struct Device {
+        QString input;
+        QString stream;
+        AudioRing *ring;
+        AudioCaptureThread *capture;
+        AudioWriterThread *writer;
+    };
+
+    void setState(QMediaRecorder::State);
+    void setStatus(QMediaRecorder::Status);
+    void setInputs(const QStringList &names);
+    QString outputFile(int i) const;
+    void startDevices(bool standby);
+    bool isStandingBy() const;
+    void shutdown();
+
+    QList<Device> devices;
+    QUrl location;
+    int rate;
+    int channels;
+    bool resampling;
+
+    /// Speech index for each stream, "audio/vad" in the settings
+    bool vad;
+    /// Waveform pyramid for each stream, "audio/peaks"
+    bool peaks;
+    /// Silence over lost frames, "audio/fill_gaps"
+    bool fill_gaps;
+    bool preroll;
+    AudioEncoder::Settings encoding;
+
+    /// Frames per device read, "audio/period_frames" in the settings
+    int period_frames;
+
+    /// Encoder queue bound, "audio/encoder_buffer_ms"
+    int encoder_buffer_ms;
+
+    QMediaRecorder::State state_;
+    QMediaRecorder::Status status_;
+    QMediaRecorder::Error error_;
+    QString error_string;
+    qint64 duration_;
+
+    AudioMeter *meter;
+    StartBarrier *barrier;
+    QTimer *timer;
+};
+
+#endif // AUDIORECORDER_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,84 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "audioring.h"
+
+// ---------------------------------------------------------------------
+
+AudioRing::AudioRing(int nchunks, int bytes) : chunk_bytes(bytes),
+                                               head(0), tail(0)
+{
+    chunks.resize(nchunks);
+    storage.fill(0, nchunks*bytes);
+    for (int i = 0; i < nchunks; ++i) {
+        Chunk &c = chunks[i];
+        c.t_ns = 0;
+        c.first_frame = 0;
+        c.frames = 0;
+        c.lost = 0;
+        c.data = storage.data() + i*bytes;
+    }
+}
+
+// ---------------------------------------------------------------------
+
+AudioRing::Chunk *AudioRing::beginWrite() {
+    quint32 h = head.load();
+    if (h - tail.loadAcquire() >= quint32(chunks.size()))
+        return NULL;
+    return &chunks[h % chunks.size()];
+}
+
+// ---------------------------------------------------------------------
+
+void AudioRing::endWrite() {
+    head.storeRelease(head.load()+1);
+}
+
+// ---------------------------------------------------------------------
+
+AudioRing::Chunk *AudioRing::beginRead() {
+    quint32 t = tail.load();
+    if (head.loadAcquire() == t)
+        return NULL;
+    return &chunks[t % chunks.size()];
+}
+
+// ---------------------------------------------------------------------
+
+void AudioRing::endRead() {
+    tail.storeRelease(tail.load()+1);
+}
+
+// ---------------------------------------------------------------------
+
+int AudioRing::fill() const {
+    return int(head.loadAcquire() - tail.loadAcquire());
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
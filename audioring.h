@@ -0,0 +1,83 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef AUDIORING_H
+#define AUDIORING_H
+
+#include <QAtomicInt>
+#include <QVector>
+#include <QByteArray>
+
+/// Lock-free single-producer single-consumer ring of audio periods.
+///
+/// The capture thread fills one chunk per period and commits it, the
+/// writer thread reads the chunks in order.  Neither side ever
+/// blocks: if the ring is full the capture thread drops the period
+/// and counts an overrun.
+class AudioRing
+{
+public:
+    struct Chunk {
+        /// Master clock time when the last frame was captured
+        qint64 t_ns;
+        /// Index of the first frame in the capture stream
+        qint64 first_frame;
+        int frames;
+        /// Frames lost by the device just before this chunk, if known
+        int lost;
+        char *data;
+    };
+
+    AudioRing(int nchunks, int chunk_bytes);
+
+    int chunkBytes() const { return chunk_bytes; }
+
+    /// Producer: returns NULL if the ring is full
+    Chunk *beginWrite();
+    void endWrite();
+
+    /// Consumer: returns NULL if the ring is empty
+    Chunk *beginRead();
+    void endRead();
+
+    /// Chunks waiting to be read
+    int fill() const;
+    int size() const { return chunks.size(); }
+
+private:
+    QVector<Chunk> chunks;
+    QByteArray storage;
+    int chunk_bytes;
+
+    /// Running counters, position is counter % size()
+    QAtomicInteger<quint32> head; // written
+    QAtomicInteger<quint32> tail; // read
+};
+
+#endif // AUDIORING_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
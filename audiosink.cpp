@@ -0,0 +1,139 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QVector>
+
+#include "audiosink.h"
+#include "metrics.h"
+
+// ---------------------------------------------------------------------
+
+AudioSinkThread::AudioSinkThread(const QString &st, const QString &n, int r,
+                                 int c, qint64 max)
+    : stream(st), name(n), rate(r), channels(c), queued_bytes(0),
+      dropped(0), max_bytes(max), finishing(false)
+{
+}
+
+// ---------------------------------------------------------------------
+
+bool AudioSinkThread::push(const char *data, int frames, qint64 &gap) {
+    int bytes = frames*channels*2;
+    QMutexLocker locker(&mutex);
+    gap = 0;
+    if (queued_bytes+bytes > max_bytes) {
+        Metrics::add(stream+"."+name+"_drops", 1);
+        dropped += frames;
+        return false;
+    }
+    Block block;
+    block.silence = dropped;
+    block.data = QByteArray(data, bytes);
+    blocks.enqueue(block);
+    queued_bytes += bytes;
+    gap = dropped;
+    dropped = 0;
+    queued.wakeOne();
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+qint64 AudioSinkThread::finish() {
+    QMutexLocker locker(&mutex);
+    finishing = true;
+    queued.wakeOne();
+    return dropped;
+}
+
+// ---------------------------------------------------------------------
+
+// Silence takes no room in the queue, it is made here in blocks of a
+// typical period.
+bool AudioSinkThread::consumeSilence(qint64 frames) {
+    if (frames <= 0)
+        return true;
+    const int block = 4096;
+    QVector<qint16> zeros(block*channels, 0);
+    for (qint64 done = 0; done < frames; done += block)
+        if (!consume(zeros.constData(),
+                     int(qMin<qint64>(block, frames-done))))
+            return false;
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+void AudioSinkThread::run() {
+    begin();
+
+    QElapsedTimer window;
+    window.start();
+    bool failed = false;
+
+    for (;;) {
+        mutex.lock();
+        while (blocks.isEmpty() && !finishing)
+            queued.wait(&mutex);
+        if (blocks.isEmpty()) {
+            // Nothing is pushed after finish():
+            qint64 trailing = dropped;
+            dropped = 0;
+            mutex.unlock();
+            if (!failed && !consumeSilence(trailing))
+                emit errorMessage(errorString);
+            break;
+        }
+        Block block = blocks.dequeue();
+        queued_bytes -= block.data.size();
+        qint64 backlog = queued_bytes;
+        mutex.unlock();
+
+        if (failed)
+            continue;
+
+        if (!consumeSilence(block.silence) ||
+            !consume(reinterpret_cast<const qint16*>(block.data.constData()),
+                     block.data.size()/(channels*2))) {
+            failed = true;
+            emit errorMessage(errorString);
+            continue;
+        }
+
+        if (window.elapsed() >= 1000) {
+            report(backlog);
+            window.restart();
+        }
+    }
+
+    end();
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,110 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef AUDIOSINK_H
+#define AUDIOSINK_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QByteArray>
+#include <QString>
+
+/// A consumer of recorded audio on its own thread.
+///
+/// The audio writer thread queues the periods it writes with push(),
+/// in file order and after any resampling, and push() never waits for
+/// the consumer.  The queue is bounded: if a consumer falls further
+/// behind than that, blocks are dropped and counted in
+/// <stream>.<name>_drops instead of stalling capture.  The consumer
+/// is given silence of the same length in their place, so that its
+/// output keeps the frame positions of the stream.
+class AudioSinkThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    AudioSinkThread(const QString &stream, const QString &name, int rate,
+                    int channels, qint64 max_bytes);
+
+    /// Returns false if the block was dropped.  gap is set to the
+    /// frames dropped just before an accepted block, which are
+    /// replaced with silence ahead of it.
+    bool push(const char *data, int frames, qint64 &gap);
+
+    /// Processes what is queued, replaces any blocks dropped at the
+    /// end with silence, then calls end() and exits.  Returns the
+    /// frames of that last gap.
+    qint64 finish();
+
+    const QString &sinkName() const { return name; }
+
+signals:
+    void errorMessage(const QString&);
+
+protected:
+    void run();
+
+    /// Called on the sink thread before the first block
+    virtual void begin() {}
+    /// Interleaved 16-bit frames, returns false on a fatal error
+    virtual bool consume(const qint16 *data, int frames) = 0;
+    /// Called after the last block, also after a failure
+    virtual void end() {}
+    /// Called about once a second with the bytes still queued
+    virtual void report(qint64 /*backlog*/) {}
+
+    QString errorString;
+
+    QString stream;
+    QString name;
+    int rate;
+    int channels;
+
+private:
+    struct Block {
+        /// Frames of silence to consume before the data
+        qint64 silence;
+        QByteArray data;
+    };
+
+    bool consumeSilence(qint64 frames);
+
+    QMutex mutex;
+    QWaitCondition queued;
+    QQueue<Block> blocks;
+    qint64 queued_bytes;
+    /// Frames dropped since the last accepted block
+    qint64 dropped;
+    qint64 max_bytes;
+    bool finishing;
+};
+
+#endif // AUDIOSINK_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,456 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDebug>
+#include <QThread>
+#include <QCoreApplication>
+#include <QAudioInput>
+#include <QAudioDeviceInfo>
+#include <QDataStream>
+#include <QElapsedTimer>
+
+#include <math.h>
+#include <string.h>
+
+#ifdef HAVE_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+#include "audiosource.h"
+#include "masterclock.h"
+
+// ---------------------------------------------------------------------
+
+AudioSource::AudioSource() : rate_(0), channels_(0), paced_frames(0),
+                             paced_start_ns(-1)
+{
+}
+
+// ---------------------------------------------------------------------
+
+AudioSource::~AudioSource() {}
+
+// ---------------------------------------------------------------------
+
+AudioSource *AudioSource::create(const QString &device) {
+    if (device == "synthetic")
+        return new SyntheticSource();
+    if (device.startsWith("file:"))
+        return new WavFileSource(device.mid(5));
+#ifdef HAVE_ALSA
+    if (!device.startsWith("qt:"))
+        return new AlsaSource(device);
+#endif
+    return new QtAudioSource(device.startsWith("qt:") ?
+                             device.mid(3) : device);
+}
+
+// ---------------------------------------------------------------------
+
+QStringList AudioSource::devices() {
+    QStringList list;
+#ifdef HAVE_ALSA
+    list << AlsaSource::devices();
+    foreach (const QAudioDeviceInfo &info,
+             QAudioDeviceInfo::availableDevices(QAudio::AudioInput))
+        list << "qt:" + info.deviceName();
+#else
+    foreach (const QAudioDeviceInfo &info,
+             QAudioDeviceInfo::availableDevices(QAudio::AudioInput))
+        list << info.deviceName();
+#endif
+    list << "synthetic";
+    return list;
+}
+
+// ---------------------------------------------------------------------
+
+void AudioSource::pace(int frames) {
+    qint64 now = MasterClock::nsecs();
+    if (paced_start_ns < 0)
+        paced_start_ns = now;
+    paced_frames += frames;
+    qint64 due = paced_start_ns + paced_frames*1000000000LL/rate_;
+    if (due > now)
+        QThread::usleep((due-now)/1000);
+}
+
+// ---------------------------------------------------------------------
+
+SyntheticSource::SyntheticSource() : position(0) {}
+
+// ---------------------------------------------------------------------
+
+bool SyntheticSource::open(int rate, int channels, int) {
+    rate_ = rate > 0 ? rate : 48000;
+    channels_ = channels > 0 ? channels : 2;
+    position = 0;
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+int SyntheticSource::read(char *data, int frames, bool &xrun) {
+    xrun = false;
+    pace(frames);
+
+    qint16 *out = reinterpret_cast<qint16*>(data);
+    for (int i = 0; i < frames; ++i, ++position) {
+        double t = double(position)/rate_;
+        // Slow envelope so that the meters move:
+        double env = 0.5+0.5*sin(2*M_PI*0.25*t);
+        for (int c = 0; c < channels_; ++c) {
+            double f = 220.0*(c+1);
+            double level = env*(0.7/(c+1));
+            *out++ = qint16(32767*level*sin(2*M_PI*f*t));
+        }
+    }
+    return frames;
+}
+
+// ---------------------------------------------------------------------
+
+WavFileSource::WavFileSource(const QString &filename) : file(filename),
+                                                        data_start(0),
+                                                        data_end(0)
+{
+}
+
+// ---------------------------------------------------------------------
+
+bool WavFileSource::open(int, int, int) {
+    if (!file.open(QIODevice::ReadOnly)) {
+        error_ = file.errorString();
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setByteOrder(QDataStream::LittleEndian);
+
+    char id[4];
+    quint32 size;
+    if (in.readRawData(id, 4) != 4 ||
+        (memcmp(id, "RIFF", 4) && memcmp(id, "RF64", 4))) {
+        error_ = "not a RIFF file";
+        return false;
+    }
+    in >> size;
+    qint64 rf64_data_size = -1;
+    if (in.readRawData(id, 4) != 4 || memcmp(id, "WAVE", 4)) {
+        error_ = "not a WAVE file";
+        return false;
+    }
+
+    bool have_format = false;
+    while (!in.atEnd()) {
+        if (in.readRawData(id, 4) != 4)
+            break;
+        in >> size;
+        qint64 next = file.pos()+size+(size&1);
+        if (!memcmp(id, "ds64", 4)) {
+            quint64 riff_size, data_size;
+            in >> riff_size >> data_size;
+            rf64_data_size = data_size;
+        } else if (!memcmp(id, "fmt ", 4)) {
+            quint16 tag, channels, block, bits;
+            quint32 rate, byterate;
+            in >> tag >> channels >> rate >> byterate >> block >> bits;
+            if (tag != 1 || bits != 16) {
+                error_ = "only 16-bit PCM is supported";
+                return false;
+            }
+            rate_ = rate;
+            channels_ = channels;
+            have_format = true;
+        } else if (!memcmp(id, "data", 4)) {
+            data_start = file.pos();
+            qint64 data_size = size;
+            if (size == 0xffffffffU && rf64_data_size >= 0)
+                data_size = rf64_data_size;
+            data_end = qMin(data_start+data_size, file.size());
+            break;
+        }
+        file.seek(next);
+    }
+
+    if (!have_format || data_end <= data_start) {
+        error_ = "no audio data found";
+        return false;
+    }
+    return file.seek(data_start);
+}
+
+// ---------------------------------------------------------------------
+
+int WavFileSource::read(char *data, int frames, bool &xrun) {
+    xrun = false;
+    pace(frames);
+
+    qint64 want = qint64(frames)*frameBytes(), got = 0;
+    while (got < want) {
+        qint64 left = data_end-file.pos();
+        if (left <= 0) {
+            file.seek(data_start);
+            continue;
+        }
+        qint64 n = file.read(data+got, qMin(left, want-got));
+        if (n <= 0) {
+            error_ = file.errorString();
+            return -1;
+        }
+        got += n;
+    }
+    return frames;
+}
+
+// ---------------------------------------------------------------------
+
+void WavFileSource::close() {
+    file.close();
+}
+
+// ---------------------------------------------------------------------
+
+QtAudioSource::QtAudioSource(const QString &d) : device(d), input(NULL),
+                                                 io(NULL),
+                                                 period_frames(0)
+{
+}
+
+// ---------------------------------------------------------------------
+
+QtAudioSource::~QtAudioSource() {
+    close();
+}
+
+// ---------------------------------------------------------------------
+
+bool QtAudioSource::open(int rate, int channels, int period) {
+    QAudioDeviceInfo info = QAudioDeviceInfo::defaultInputDevice();
+    foreach (const QAudioDeviceInfo &i,
+             QAudioDeviceInfo::availableDevices(QAudio::AudioInput))
+        if (i.deviceName() == device)
+            info = i;
+
+    QAudioFormat format;
+    format.setSampleRate(rate);
+    format.setChannelCount(channels);
+    format.setSampleSize(16);
+    format.setSampleType(QAudioFormat::SignedInt);
+    format.setByteOrder(QAudioFormat::LittleEndian);
+    format.setCodec("audio/pcm");
+    if (!info.isFormatSupported(format)) {
+        qDebug() << "QtAudioSource: format not supported, using nearest";
+        format = info.nearestFormat(format);
+        if (format.sampleSize() != 16 ||
+            format.sampleType() != QAudioFormat::SignedInt) {
+            error_ = "16-bit capture not supported by " + info.deviceName();
+            return false;
+        }
+    }
+
+    rate_ = format.sampleRate();
+    channels_ = format.channelCount();
+    period_frames = period;
+
+    input = new QAudioInput(info, format);
+    input->setBufferSize(4*period*frameBytes());
+    io = input->start();
+    if (!io) {
+        error_ = "cannot start " + info.deviceName();
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+int QtAudioSource::read(char *data, int frames, bool &xrun) {
+    xrun = false;
+    if (!input)
+        return -1;
+    if (input->error() == QAudio::UnderrunError ||
+        input->error() == QAudio::IOError) {
+        xrun = true;
+    } else if (input->error() == QAudio::FatalError) {
+        error_ = "audio input failed";
+        return -1;
+    }
+
+    qint64 want = qint64(frames)*frameBytes();
+    int timeout_ms = 2*1000*frames/rate_+10;
+    QElapsedTimer timer;
+    timer.start();
+    while (input->bytesReady() < want && timer.elapsed() < timeout_ms)
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 5);
+
+    qint64 n = io->read(data, want);
+    if (n < 0) {
+        error_ = io->errorString();
+        return -1;
+    }
+    return n/frameBytes();
+}
+
+// ---------------------------------------------------------------------
+
+void QtAudioSource::close() {
+    if (input) {
+        input->stop();
+        delete input;
+    }
+    input = NULL;
+    io = NULL;
+}
+
+// ---------------------------------------------------------------------
+
+#ifdef HAVE_ALSA
+
+AlsaSource::AlsaSource(const QString &d) : device(d), pcm(NULL) {}
+
+// ---------------------------------------------------------------------
+
+AlsaSource::~AlsaSource() {
+    close();
+}
+
+// ---------------------------------------------------------------------
+
+bool AlsaSource::open(int rate, int channels, int period) {
+    QByteArray name = (device.isEmpty() ? QString("default") :
+                       device).toLocal8Bit();
+    int err = snd_pcm_open(&pcm, name.constData(), SND_PCM_STREAM_CAPTURE, 0);
+    if (err < 0) {
+        error_ = QString("%1: %2").arg(device).arg(snd_strerror(err));
+        pcm = NULL;
+        return false;
+    }
+
+    snd_pcm_hw_params_t *hw;
+    snd_pcm_hw_params_alloca(&hw);
+    snd_pcm_hw_params_any(pcm, hw);
+
+    unsigned int r = rate;
+    snd_pcm_uframes_t period_size = period;
+    snd_pcm_uframes_t buffer_size = 4*period;
+
+    if ((err = snd_pcm_hw_params_set_access(pcm, hw,
+                                            SND_PCM_ACCESS_RW_INTERLEAVED)) < 0 ||
+        (err = snd_pcm_hw_params_set_format(pcm, hw,
+                                            SND_PCM_FORMAT_S16_LE)) < 0 ||
+        (err = snd_pcm_hw_params_set_channels(pcm, hw, channels)) < 0 ||
+        (err = snd_pcm_hw_params_set_rate_near(pcm, hw, &r, NULL)) < 0 ||
+        (err = snd_pcm_hw_params_set_period_size_near(pcm, hw,
+                                                      &period_size,
+                                                      NULL)) < 0 ||
+        (err = snd_pcm_hw_params_set_buffer_size_near(pcm, hw,
+                                                      &buffer_size)) < 0 ||
+        (err = snd_pcm_hw_params(pcm, hw)) < 0) {
+        error_ = QString("%1: %2").arg(device).arg(snd_strerror(err));
+        close();
+        return false;
+    }
+
+    rate_ = r;
+    channels_ = channels;
+    qDebug() << "AlsaSource:" << device << "rate" << rate_ << "period"
+             << period_size << "buffer" << buffer_size;
+
+    if ((err = snd_pcm_prepare(pcm)) < 0 || (err = snd_pcm_start(pcm)) < 0) {
+        error_ = QString("%1: %2").arg(device).arg(snd_strerror(err));
+        close();
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+int AlsaSource::read(char *data, int frames, bool &xrun) {
+    xrun = false;
+    for (;;) {
+        snd_pcm_sframes_t n = snd_pcm_readi(pcm, data, frames);
+        if (n >= 0)
+            return n;
+        if (n == -EPIPE || n == -ESTRPIPE) {
+            xrun = true;
+            n = snd_pcm_recover(pcm, n, 1);
+            if (n == 0)
+                n = snd_pcm_start(pcm);
+        } else if (n == -EAGAIN || n == -EINTR)
+            continue;
+        if (n < 0) {
+            error_ = QString("%1: %2").arg(device).arg(snd_strerror(n));
+            return -1;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------
+
+qint64 AlsaSource::delay() {
+    snd_pcm_sframes_t d;
+    if (!pcm || snd_pcm_delay(pcm, &d) < 0)
+        return -1;
+    return d;
+}
+
+// ---------------------------------------------------------------------
+
+void AlsaSource::close() {
+    if (pcm)
+        snd_pcm_close(pcm);
+    pcm = NULL;
+}
+
+// ---------------------------------------------------------------------
+
+QStringList AlsaSource::devices() {
+    QStringList list;
+    void **hints;
+    if (snd_device_name_hint(-1, "pcm", &hints) < 0)
+        return list;
+
+    for (void **h = hints; *h; ++h) {
+        char *name = snd_device_name_get_hint(*h, "NAME");
+        char *io = snd_device_name_get_hint(*h, "IOID");
+        // IOID is NULL for devices that do both:
+        if (name && (!io || !strcmp(io, "Input")) &&
+            strcmp(name, "null"))
+            list << QString::fromLocal8Bit(name);
+        free(name);
+        free(io);
+    }
+    snd_device_name_free_hint(hints);
+    return list;
+}
+
+#endif // HAVE_ALSA
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
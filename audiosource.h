@@ -0,0 +1,167 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef AUDIOSOURCE_H
+#define AUDIOSOURCE_H
+
+#include <QString>
+#include <QStringList>
+#include <QFile>
+
+class QAudioInput;
+class QIODevice;
+
+/// A source of interleaved 16-bit PCM audio, used from the capture
+/// thread only.  read() blocks until a period is available.
+class AudioSource
+{
+public:
+    AudioSource();
+    virtual ~AudioSource();
+
+    /// Opens the source with the requested format.  The source may
+    /// change rate and channels, check them after opening.
+    virtual bool open(int rate, int channels, int period_frames) = 0;
+
+    /// Reads up to frames frames.  Returns the number of frames read,
+    /// 0 if nothing was available, or -1 on a fatal error.  xrun is
+    /// set if the device lost data before this read.
+    virtual int read(char *data, int frames, bool &xrun) = 0;
+
+    /// Frames captured but not yet returned by read(), used to
+    /// timestamp the data.  -1 if unknown.
+    virtual qint64 delay() { return -1; }
+
+    virtual void close() = 0;
+
+    int rate() const { return rate_; }
+    int channels() const { return channels_; }
+    int frameBytes() const { return channels_*2; }
+    QString errorString() const { return error_; }
+
+    /// Creates a source for a device name from devices():
+    ///   "synthetic"     test tones
+    ///   "file:<path>"   a 16-bit WAV file played in real time
+    ///   anything else   an ALSA device on Linux, a Qt audio input
+    ///                   elsewhere
+    static AudioSource *create(const QString &device);
+    static QStringList devices();
+
+protected:
+    /// Sleeps until the next period is due in real time
+    void pace(int frames);
+
+    int rate_;
+    int channels_;
+    QString error_;
+
+private:
+    qint64 paced_frames;
+    qint64 paced_start_ns;
+};
+
+// ---------------------------------------------------------------------
+
+/// Sine tones of different frequency and level on each channel
+class SyntheticSource : public AudioSource
+{
+public:
+    SyntheticSource();
+    bool open(int rate, int channels, int period_frames);
+    int read(char *data, int frames, bool &xrun);
+    void close() {}
+
+private:
+    qint64 position;
+};
+
+// ---------------------------------------------------------------------
+
+/// Plays a 16-bit PCM WAV file in real time, looping at the end
+class WavFileSource : public AudioSource
+{
+public:
+    WavFileSource(const QString &filename);
+    bool open(int rate, int channels, int period_frames);
+    int read(char *data, int frames, bool &xrun);
+    void close();
+
+private:
+    QFile file;
+    qint64 data_start;
+    qint64 data_end;
+};
+
+// ---------------------------------------------------------------------
+
+/// Portable fallback using QAudioInput in push mode.  Needs the event
+/// loop of the capture thread, which read() runs while waiting.
+class QtAudioSource : public AudioSource
+{
+public:
+    QtAudioSource(const QString &device);
+    ~QtAudioSource();
+    bool open(int rate, int channels, int period_frames);
+    int read(char *data, int frames, bool &xrun);
+    void close();
+
+private:
+    QString device;
+    QAudioInput *input;
+    QIODevice *io;
+    int period_frames;
+};
+
+// ---------------------------------------------------------------------
+
+#ifdef HAVE_ALSA
+
+typedef struct _snd_pcm snd_pcm_t;
+
+/// ALSA capture with explicit period and buffer sizes
+class AlsaSource : public AudioSource
+{
+public:
+    AlsaSource(const QString &device);
+    ~AlsaSource();
+    bool open(int rate, int channels, int period_frames);
+    int read(char *data, int frames, bool &xrun);
+    qint64 delay();
+    void close();
+
+    static QStringList devices();
+
+private:
+    QString device;
+    snd_pcm_t *pcm;
+};
+
+#endif // HAVE_ALSA
+
+#endif // AUDIOSOURCE_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
@@ -62,19 +62,38 @@
   SOFTWARE.
 */
 
-#include <QAudioProbe>
-#include <QAudioRecorder>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QMediaRecorder>
 #include <QHostInfo>
+#include <QLabel>
 #include <QMessageBox>
+#include <QSettings>
 #include <QShortcut>
 #include <QTimer>
 #include <QDebug>
 
 #include "avrecorder.h"
 #include "qaudiolevel.h"
+#include "audiometer.h"
+#include "audiorecorder.h"
+#include "startbarrier.h"
+#include "masterclock.h"
+#include "metrics.h"
+#include "manifest.h"
+#include "streamstats.h"
+#include "streamposition.h"
+#include "annotationjournal.h"
+#include "storagemonitor.h"
+#include "volumes.h"
+#include "preroll.h"
+#include "snapshotwriter.h"
+
+#ifdef HAVE_SQLITE
+#include "catalog.h"
+#endif
 
 #include "ui_avrecorder.h"
 
@@ -84,27 +103,28 @@
 
 // ---------------------------------------------------------------------
 
-static qreal getPeakValue(const QAudioFormat &format);
-static QVector<qreal> getBufferLevels(const QAudioBuffer &buffer);
-
-template <class T>
-static QVector<qreal> getBufferLevels(const T *buffer, int frames, int channels);
-
-// ---------------------------------------------------------------------
-
 AvRecorder::AvRecorder(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::AvRecorder),
-    outputLocationSet(false)
+    outputLocationSet(false),
+    rec_duration(0),
+    barrier(new StartBarrier),
+    meter_gui_ns(0)
 {
     ui->setupUi(this);
     resize(0,0);
 
-    audioRecorder = new QAudioRecorder(this);
-    probe = new QAudioProbe;
-    connect(probe, SIGNAL(audioBufferProbed(QAudioBuffer)),
-            this, SLOT(processBuffer(QAudioBuffer)));
-    probe->setSource(audioRecorder);
+    // Level analysis runs on the audio writer thread, the GUI only
+    // samples the results at a fixed rate:
+    meter = new AudioMeter;
+    audioRecorder = new AudioRecorder(this);
+    audioRecorder->setMeter(meter);
+    audioRecorder->setStartBarrier(barrier);
+
+    meterTimer = new QTimer(this);
+    meterTimer->setInterval(1000/30);
+    connect(meterTimer, SIGNAL(timeout()), this, SLOT(refreshAudioLevels()));
+    meter_window.start();
 
     //audio devices
     ui->audioDeviceBox->addItem(tr("Default"), QVariant(QString()));
@@ -173,6 +193,36 @@ AvRecorder::AvRecorder(QWidget *parent) :
     connect(audioRecorder, SIGNAL(error(QMediaRecorder::Error)), this,
             SLOT(displayErrorMessage()));
 
+    // With a pre-roll the audio is captured from the start:
+    connect(ui->audioDeviceBox, SIGNAL(currentIndexChanged(int)), this,
+            SLOT(applyAudioSettings()));
+    connect(ui->sampleRateBox, SIGNAL(currentIndexChanged(int)), this,
+            SLOT(applyAudioSettings()));
+    connect(ui->channelsBox, SIGNAL(currentIndexChanged(int)), this,
+            SLOT(applyAudioSettings()));
+    applyAudioSettings();
+    audioRecorder->setPreRoll(PreRoll::length() > 0);
+
+    metricsLabel = new QLabel(tr("Metrics"), this);
+    ui->statusbar->addPermanentWidget(metricsLabel);
+    continuityLabel = new QLabel(tr("Audio gaps: 0"), this);
+    ui->statusbar->addPermanentWidget(continuityLabel);
+    metricsTimer = new QTimer(this);
+    connect(metricsTimer, SIGNAL(timeout()), this, SLOT(updateMetrics()));
+    metricsTimer->start(1000);
+    startTimeTimer = new QTimer(this);
+    startTimeTimer->setInterval(20);
+    connect(startTimeTimer, SIGNAL(timeout()), this, SLOT(writeStartTime()));
+
+    journal = new AnnotationJournal(this);
+    journal->start();
+    SnapshotWriter::setJournal(journal);
+
+    storage = new StorageMonitor(this);
+    connect(storage, SIGNAL(lowSpace(int)), this, SLOT(storageLow(int)));
+    connect(storage, SIGNAL(outOfSpace()), this, SLOT(storageFull()));
+    storage->start();
+
     defaultDir = QDir::homePath() + "/Meetings";
     dirName = ".";
 
@@ -197,35 +247,73 @@ AvRecorder::AvRecorder(QWidget *parent) :
 
 AvRecorder::~AvRecorder()
 {
+    // The stills still being saved are linked in the journal:
+    SnapshotWriter::waitForDone();
+    SnapshotWriter::setJournal(NULL);
+    journal->breakLoop();
+    journal->wait();
+    storage->breakLoop();
+    storage->wait();
     delete audioRecorder;
-    delete probe;
+    delete meter;
+    delete barrier;
+}
+
+// ---------------------------------------------------------------------
+
+void AvRecorder::setExtraAudioInputs(const QStringList &inputs)
+{
+    audioRecorder->setExtraAudioInputs(inputs);
+}
+
+// ---------------------------------------------------------------------
+
+void AvRecorder::setAudioResampling(bool on)
+{
+    audioRecorder->setResampling(on);
 }
 
 // ---------------------------------------------------------------------
 
 void AvRecorder::updateProgress(qint64 duration)
 {
-    if (audioRecorder->error() != QMediaRecorder::NoError || duration < 2000)
-        return;
+    rec_duration = duration;
+}
 
-    QFileInfo wavFile(dirName+"/audio.wav");
-    QFileInfo ca1File(dirName+"/capture0.avi");
-    QFileInfo ca2File(dirName+"/capture1.avi");
+// ---------------------------------------------------------------------
 
-    qint64 duration_human = duration / 1000;
+// Renders what the writers have published, at the rate of the metrics
+// timer.  Nothing here touches the files.
+void AvRecorder::showProgress()
+{
+    if (audioRecorder->state() == QMediaRecorder::StoppedState ||
+        audioRecorder->error() != QMediaRecorder::NoError ||
+        rec_duration < 2000)
+        return;
+
+    qint64 duration_human = rec_duration / 1000;
     QString duration_unit = "secs";
     if (duration_human > 100) {
         duration_human /= 60;
         duration_unit = "mins";
     }
 
-    ui->statusbar->showMessage(tr("Rec started %1 (%2 %3), audio %4 MB, camera 0: %5 MB, camera 1: %6 MB")
-                               .arg(rec_started.toString("hh:mm:ss"))
-                               .arg(duration_human)
-                               .arg(duration_unit)
-                               .arg(wavFile.size()/1024/1024)
-                               .arg(ca1File.size()/1024/1024)
-                               .arg(ca2File.size()/1024/1024));
+    QString msg = tr("Rec started %1 (%2 %3)")
+        .arg(rec_started.toString("hh:mm:ss"))
+        .arg(duration_human)
+        .arg(duration_unit);
+
+    QMap<QString, StreamStats::Entry> stats = StreamStats::snapshot();
+    QMap<QString, StreamStats::Entry>::const_iterator it;
+    qint64 total = 0;
+    for (it = stats.constBegin(); it != stats.constEnd(); ++it) {
+        msg += tr(", %1 %2 MB (%3 kbit/s)").arg(it.key())
+            .arg(it.value().bytes/1024/1024).arg(it.value().bitrate/1000);
+        total += it.value().bytes;
+    }
+    msg += tr(", total %1 MB").arg(total/1024/1024);
+
+    ui->statusbar->showMessage(msg);
 }
 
 // ---------------------------------------------------------------------
@@ -262,14 +350,45 @@ void AvRecorder::onStateChanged(QMediaRecorder::State state)
     case QMediaRecorder::RecordingState:
         ui->recordButton->setText(tr("Stop"));
         //ui->pauseButton->setText(tr("Pause"));
+        meterTimer->start();
         break;
     case QMediaRecorder::PausedState:
         ui->recordButton->setText(tr("Stop"));
         //ui->pauseButton->setText(tr("Resume"));
+        meterTimer->stop();
         break;
     case QMediaRecorder::StoppedState:
         ui->recordButton->setText(tr("Record"));
         //ui->pauseButton->setText(tr("Pause"));
+        meterTimer->stop();
+        storage->setActive(false);
+        // The forecast before the next recording:
+        if (rec_duration > 60000)
+            StorageMonitor::saveBitrate(StreamStats::total().bytes*8000/
+                                        rec_duration);
+        if (barrier->isArmed()) {
+            QFile syncfile(dirName+"/sync.txt");
+            if (syncfile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+                QTextStream out(&syncfile);
+                out << barrier->report();
+                syncfile.close();
+            }
+            if (startTimeTimer->isActive())
+                writeStartTime();
+            barrier->disarm();
+        }
+        startTimeTimer->stop();
+        {
+            QFile metricsfile(dirName+"/metrics.txt");
+            if (metricsfile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+                QTextStream out(&metricsfile);
+                out << Metrics::report();
+                metricsfile.close();
+            }
+        }
+        updateCatalog();
+        // Annotations after Stop refer to no frame:
+        StreamPosition::clear();
         break;
     }
 
@@ -308,25 +427,20 @@ void AvRecorder::toggleRecord()
         return;
 
     if (audioRecorder->state() == QMediaRecorder::StoppedState) {
-        audioRecorder->setAudioInput(boxValue(ui->audioDeviceBox).toString());
-
-	if (!OutputLocationEmptyOrOk())
+	if (!OutputLocationEmptyOrOk() || !StorageSufficient())
 	    return;
 
-        QAudioEncoderSettings settings;
-        settings.setCodec(boxValue(ui->audioCodecBox).toString());
-        settings.setSampleRate(boxValue(ui->sampleRateBox).toInt());
-        settings.setBitRate(boxValue(ui->bitrateBox).toInt());
-        settings.setChannelCount(boxValue(ui->channelsBox).toInt());
-        settings.setQuality(QMultimedia::EncodingQuality(ui->qualitySlider->value()));
-        settings.setEncodingMode(ui->constantQualityRadioButton->isChecked() ?
-                                 QMultimedia::ConstantQualityEncoding :
-                                 QMultimedia::ConstantBitRateEncoding);
+        applyAudioSettings();
 
-        QString container = boxValue(ui->containerBox).toString();
+        StreamStats::clear();
+        StreamPosition::clear();
+        rec_duration = 0;
 
-        audioRecorder->setEncodingSettings(settings, QVideoEncoderSettings(), container);
+        // Cameras pre-open their writers when the state changes to
+        // recording, audio once its first period arrives:
+        barrier->arm();
         audioRecorder->record();
+        storage->setActive(true);
 
         rec_started = QDateTime::currentDateTime();
 
@@ -336,6 +450,7 @@ void AvRecorder::toggleRecord()
             out << rec_started.toString("yyyy-MM-dd'T'hh:mm:sst") << "\n";
             timefile.close();
         }
+        startTimeTimer->start();
         QFile hostfile(dirName+"/hostname.txt");
         if (hostfile.open(QIODevice::WriteOnly | QIODevice::Text)) {
             QTextStream out(&hostfile);
@@ -350,12 +465,40 @@ void AvRecorder::toggleRecord()
 
 // ---------------------------------------------------------------------
 
+// Also while stopped, so that a pre-roll is captured with the device
+// and format that will be recorded.
+void AvRecorder::applyAudioSettings()
+{
+    if (audioRecorder->state() != QMediaRecorder::StoppedState)
+        return;
+
+    audioRecorder->setAudioInput(boxValue(ui->audioDeviceBox).toString());
+
+    QAudioEncoderSettings settings;
+    settings.setCodec(boxValue(ui->audioCodecBox).toString());
+    settings.setSampleRate(boxValue(ui->sampleRateBox).toInt());
+    settings.setBitRate(boxValue(ui->bitrateBox).toInt());
+    settings.setChannelCount(boxValue(ui->channelsBox).toInt());
+    settings.setQuality(QMultimedia::EncodingQuality(ui->qualitySlider->value()));
+    settings.setEncodingMode(ui->constantQualityRadioButton->isChecked() ?
+                             QMultimedia::ConstantQualityEncoding :
+                             QMultimedia::ConstantBitRateEncoding);
+
+    QString container = boxValue(ui->containerBox).toString();
+
+    audioRecorder->setEncodingSettings(settings, QVideoEncoderSettings(), container);
+}
+
+// ---------------------------------------------------------------------
+
 void AvRecorder::togglePause()
 {
     if (audioRecorder->state() != QMediaRecorder::PausedState)
         audioRecorder->pause();
-    else
+    else {
+        barrier->arm(true);
         audioRecorder->record();
+    }
 }
 
 // ---------------------------------------------------------------------
@@ -368,10 +511,16 @@ void AvRecorder::upload()
     if (!outputLocationSet)
         return;
 
-    QFileInfo wavFile(dirName+"/audio.wav");
-    QFileInfo ca1File(dirName+"/capture0.avi");
-    QFileInfo ca2File(dirName+"/capture1.avi");
-    int totalsize = (wavFile.size()+ca1File.size()+ca2File.size())/1024/1024;
+    // The writers' totals cover every stream and segment of this
+    // session's recording.  A meeting recorded earlier is measured
+    // from its directories instead.
+    qint64 bytes = StreamStats::total().bytes;
+    if (bytes == 0)
+        foreach (const QString &dir, Volumes::directories(dirName))
+            foreach (const QFileInfo &fi,
+                     QDir(dir).entryInfoList(QDir::Files))
+                bytes += fi.size();
+    int totalsize = bytes/1024/1024;
 
     QMessageBox msgBox;
     msgBox.setWindowTitle("Re:Know Meeting recorder");
@@ -396,6 +545,7 @@ void AvRecorder::upload()
     if (ret == QMessageBox::Ok) {
       UploadWidget uw(this, dirName);
       uw.exec();
+      updateCatalog();
     }
 #endif
 
@@ -403,6 +553,28 @@ void AvRecorder::upload()
 
 // ---------------------------------------------------------------------
 
+// The catalog that tools/query_catalog searches, "catalog/file" in the
+// meetings directory by default.  Meetings recorded elsewhere are
+// added too, the scanner only drops those under its own directory.
+void AvRecorder::updateCatalog()
+{
+#ifdef HAVE_SQLITE
+    QSettings settings;
+    QString file = settings.value("catalog/file",
+                                  defaultDir+"/catalog.sqlite").toString();
+    if (file.isEmpty() || dirName.isEmpty())
+        return;
+
+    Catalog catalog;
+    if (!catalog.open(QFile::encodeName(file).constData()) ||
+        !catalog.update(QFile::encodeName(dirName).constData()))
+        qWarning() << "WARNING: Failed to update the catalog:"
+                   << QString::fromStdString(catalog.errorString());
+#endif
+}
+
+// ---------------------------------------------------------------------
+
 void AvRecorder::setOutputLocation() {
     QDir dir(defaultDir);
     if (!dir.exists()) {
@@ -419,6 +591,11 @@ void AvRecorder::setOutputLocation() {
     if (!dirName.isNull() && !dirName.isEmpty()) {
 	ui->statusbar->showMessage("Output directory: "+dirName);
 	audioRecorder->setOutputLocation(QUrl::fromLocalFile(dirName+"/audio.wav"));
+	Volumes::setMeeting(dirName);
+	Manifest::setDirectory(dirName);
+	journal->setDirectory(dirName);
+	storage->setDirectory(dirName);
+	StreamStats::clear();
 	emit outputDirectory(dirName);
 	outputLocationSet = true;
     } else
@@ -451,151 +628,132 @@ bool AvRecorder::OutputLocationEmptyOrOk() {
 
 // ---------------------------------------------------------------------
 
-void AvRecorder::displayErrorMessage() {
-    ui->statusbar->showMessage(audioRecorder->errorString());
-}
+// Forecasts from the bitrate of the last recording how long the free
+// space lasts, and asks whether to record anyway if it is less than
+// "storage/expected_minutes".
+bool AvRecorder::StorageSufficient() {
+    qint64 free = StorageMonitor::freeBytes(dirName);
+    if (free < 0)
+        return true;
+    qint64 minutes = StorageMonitor::minutesLeft(free,
+                                                 StorageMonitor::expectedBitrate());
+    QSettings settings;
+    int expected = settings.value("storage/expected_minutes", 120).toInt();
+    qDebug() << "StorageSufficient():" << free/1024/1024 << "MB free, about"
+             << minutes << "minutes";
+    if (minutes < 0 || minutes >= expected)
+        return true;
 
-void AvRecorder::displayErrorMessage(const QString &e) {
-    ui->statusbar->showMessage(e);
+    QMessageBox msgBox;
+    msgBox.setWindowTitle("Re:Know Meeting recorder");
+    msgBox.setStandardButtons(QMessageBox::Ok | QMessageBox::Cancel);
+    msgBox.setDefaultButton(QMessageBox::Cancel);
+    msgBox.setIcon(QMessageBox::Warning);
+    msgBox.setText(QString("Disk space for about %1 minutes.").arg(minutes));
+    msgBox.setInformativeText(QString("There is %1 MB free in %2. Recording "
+                                      "stops automatically before the disk "
+                                      "is full. Record anyway?")
+                              .arg(free/1024/1024).arg(dirName));
+    return (msgBox.exec() == QMessageBox::Ok);
 }
 
 // ---------------------------------------------------------------------
 
-void AvRecorder::clearAudioLevels()
-{
-    for (int i = 0; i < audioLevels.size(); ++i)
-        audioLevels.at(i)->setLevel(0);
+void AvRecorder::storageLow(int minutes) {
+    ui->statusbar->showMessage(tr("WARNING: disk space left for about %1 "
+                                  "minutes").arg(minutes), 30000);
 }
 
 // ---------------------------------------------------------------------
 
-// This function returns the maximum possible sample value for a given audio format
-qreal getPeakValue(const QAudioFormat& format)
-{
-    // Note: Only the most common sample formats are supported
-    if (!format.isValid())
-        return qreal(0);
+// Stopping finalizes every file while there is still room for it.
+void AvRecorder::storageFull() {
+    if (audioRecorder->state() == QMediaRecorder::StoppedState)
+        return;
+    audioRecorder->stop();
+    displayErrorMessage(tr("Recording stopped, the disk is almost full."));
+}
 
-    if (format.codec() != "audio/pcm")
-        return qreal(0);
+// ---------------------------------------------------------------------
 
-    switch (format.sampleType()) {
-    case QAudioFormat::Unknown:
-        break;
-    case QAudioFormat::Float:
-        if (format.sampleSize() != 32) // other sample formats are not supported
-            return qreal(0);
-        return qreal(1.00003);
-    case QAudioFormat::SignedInt:
-        if (format.sampleSize() == 32)
-            return qreal(INT_MAX);
-        if (format.sampleSize() == 16)
-            return qreal(SHRT_MAX);
-        if (format.sampleSize() == 8)
-            return qreal(CHAR_MAX);
-        break;
-    case QAudioFormat::UnSignedInt:
-        if (format.sampleSize() == 32)
-            return qreal(UINT_MAX);
-        if (format.sampleSize() == 16)
-            return qreal(USHRT_MAX);
-        if (format.sampleSize() == 8)
-            return qreal(UCHAR_MAX);
-        break;
-    }
+void AvRecorder::displayErrorMessage() {
+    ui->statusbar->showMessage(audioRecorder->errorString());
+}
 
-    return qreal(0);
+void AvRecorder::displayErrorMessage(const QString &e) {
+    ui->statusbar->showMessage(e);
 }
 
 // ---------------------------------------------------------------------
 
-// returns the audio level for each channel
-QVector<qreal> getBufferLevels(const QAudioBuffer& buffer)
+void AvRecorder::clearAudioLevels()
 {
-    QVector<qreal> values;
-
-    if (!buffer.format().isValid() || buffer.format().byteOrder() != QAudioFormat::LittleEndian)
-        return values;
-
-    if (buffer.format().codec() != "audio/pcm")
-        return values;
-
-    int channelCount = buffer.format().channelCount();
-    values.fill(0, channelCount);
-    qreal peak_value = getPeakValue(buffer.format());
-    if (qFuzzyCompare(peak_value, qreal(0)))
-        return values;
-
-    switch (buffer.format().sampleType()) {
-    case QAudioFormat::Unknown:
-    case QAudioFormat::UnSignedInt:
-        if (buffer.format().sampleSize() == 32)
-            values = getBufferLevels(buffer.constData<quint32>(), buffer.frameCount(), channelCount);
-        if (buffer.format().sampleSize() == 16)
-            values = getBufferLevels(buffer.constData<quint16>(), buffer.frameCount(), channelCount);
-        if (buffer.format().sampleSize() == 8)
-            values = getBufferLevels(buffer.constData<quint8>(), buffer.frameCount(), channelCount);
-        for (int i = 0; i < values.size(); ++i)
-            values[i] = qAbs(values.at(i) - peak_value / 2) / (peak_value / 2);
-        break;
-    case QAudioFormat::Float:
-        if (buffer.format().sampleSize() == 32) {
-            values = getBufferLevels(buffer.constData<float>(), buffer.frameCount(), channelCount);
-            for (int i = 0; i < values.size(); ++i)
-                values[i] /= peak_value;
-        }
-        break;
-    case QAudioFormat::SignedInt:
-        if (buffer.format().sampleSize() == 32)
-            values = getBufferLevels(buffer.constData<qint32>(), buffer.frameCount(), channelCount);
-        if (buffer.format().sampleSize() == 16)
-            values = getBufferLevels(buffer.constData<qint16>(), buffer.frameCount(), channelCount);
-        if (buffer.format().sampleSize() == 8)
-            values = getBufferLevels(buffer.constData<qint8>(), buffer.frameCount(), channelCount);
-        for (int i = 0; i < values.size(); ++i)
-            values[i] /= peak_value;
-        break;
-    }
-
-    return values;
+    meter->clear();
+    for (int i = 0; i < audioLevels.size(); ++i)
+        audioLevels.at(i)->setLevel(0);
 }
 
 // ---------------------------------------------------------------------
 
-template <class T>
-QVector<qreal> getBufferLevels(const T *buffer, int frames, int channels)
+// Runs at a fixed rate while recording.  The level widgets are only
+// added or removed when the channel count changes.
+void AvRecorder::refreshAudioLevels()
 {
-    QVector<qreal> max_values;
-    max_values.fill(0, channels);
-
-    for (int i = 0; i < frames; ++i) {
-        for (int j = 0; j < channels; ++j) {
-            qreal value = qAbs(qreal(buffer[i * channels + j]));
-            if (value > max_values.at(j))
-                max_values.replace(j, value);
-        }
+    QElapsedTimer timer;
+    timer.start();
+
+    int n = meter->channelCount();
+    while (audioLevels.count() < n) {
+        QAudioLevel *level = new QAudioLevel(ui->centralwidget);
+        audioLevels.append(level);
+        ui->levelsLayout->addWidget(level);
     }
+    while (audioLevels.count() > n)
+        delete audioLevels.takeLast();
 
-    return max_values;
+    for (int i = 0; i < n; ++i) {
+        float peak, rms;
+        meter->takeLevels(i, peak, rms);
+        audioLevels.at(i)->setLevels(peak, rms);
+    }
+
+    meter_gui_ns += timer.nsecsElapsed();
+    if (meter_window.elapsed() >= 1000) {
+        Metrics::set("audio.gui_us_per_s",
+                     meter_gui_ns/1000*1000/meter_window.restart());
+        Metrics::set("audio.meter_us_per_s",
+                     Metrics::value("audio.meter_us"));
+        Metrics::set("audio.meter_us", 0);
+        meter_gui_ns = 0;
+    }
 }
 
 // ---------------------------------------------------------------------
 
-void AvRecorder::processBuffer(const QAudioBuffer& buffer)
+// The start of the files is fixed once all streams are ready.  With a
+// pre-roll they begin before the click, and starttime.txt is rewritten
+// right away, so that it is right also if the recording never stops
+// cleanly.
+void AvRecorder::writeStartTime()
 {
-    if (audioLevels.count() != buffer.format().channelCount()) {
-        qDeleteAll(audioLevels);
-        audioLevels.clear();
-        for (int i = 0; i < buffer.format().channelCount(); ++i) {
-            QAudioLevel *level = new QAudioLevel(ui->centralwidget);
-            audioLevels.append(level);
-            ui->levelsLayout->addWidget(level);
-        }
+    qint64 from_ns = barrier->recordFrom();
+    if (from_ns < 0) {
+        if (!barrier->isArmed())
+            startTimeTimer->stop();
+        return;
     }
+    startTimeTimer->stop();
+    if (from_ns >= barrier->startTime())
+        return;
 
-    QVector<qreal> levels = getBufferLevels(buffer);
-    for (int i = 0; i < levels.count(); ++i)
-        audioLevels.at(i)->setLevel(levels.at(i));
+    QFile timefile(dirName+"/starttime.txt");
+    if (timefile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        QTextStream out(&timefile);
+        out << QDateTime::fromMSecsSinceEpoch(
+            MasterClock::toMSecsSinceEpoch(from_ns))
+            .toString("yyyy-MM-dd'T'hh:mm:sst") << "\n";
+        timefile.close();
+    }
 }
 
 // ---------------------------------------------------------------------
@@ -635,6 +793,41 @@ void AvRecorder::disableCameraCheckbox(int n) {
 
 // ---------------------------------------------------------------------
 
+void AvRecorder::processWriterState(int n, bool open) {
+    qDebug() << "Camera" << n << "writer" << (open ? "opened" : "closed");
+}
+
+// ---------------------------------------------------------------------
+
+void AvRecorder::updateMetrics() {
+    showProgress();
+
+    QMap<QString, qint64> m = Metrics::snapshot();
+    metricsLabel->setToolTip(Metrics::report().trimmed());
+
+    // Gaps of all audio streams, details per stream in the tooltip:
+    qint64 gaps = 0, gap_ms = 0;
+    QStringList lines;
+    QMapIterator<QString, qint64> i(m);
+    while (i.hasNext()) {
+        i.next();
+        if (!i.key().endsWith(".gaps"))
+            continue;
+        QString stream = i.key().left(i.key().length()-5);
+        gaps += i.value();
+        gap_ms += m.value(stream+".gap_ms");
+        lines << tr("%1: %2 gaps, %3 ms, %4 xruns, %5 overruns")
+            .arg(stream).arg(i.value()).arg(m.value(stream+".gap_ms"))
+            .arg(m.value(stream+".xruns")).arg(m.value(stream+".overruns"));
+    }
+    continuityLabel->setText(tr("Audio gaps: %1 (%2 ms)").arg(gaps)
+                             .arg(gap_ms));
+    continuityLabel->setToolTip(lines.isEmpty() ? tr("No audio gaps") :
+                                lines.join("\n"));
+}
+
+// ---------------------------------------------------------------------
+
 void AvRecorder::setCameraOutput(QString wxh) {
     //qDebug() << "setCameraOutput(): idx=" << idx;
     emit cameraOutput(wxh);
@@ -660,7 +853,7 @@ void AvRecorder::setCamera1State(int state) {
 
 // ---------------------------------------------------------------------
 
-void AvRecorder::writeAnnotation(int anno, const QString &fn) {
+void AvRecorder::writeAnnotation(int anno, const QString &type) {
     if (!outputLocationSet) {
 	QMessageBox msgBox;
 	msgBox.setWindowTitle("Re:Know Meeting recorder");
@@ -672,14 +865,25 @@ void AvRecorder::writeAnnotation(int anno, const QString &fn) {
         setOutputLocation();
     }
 
-    QDateTime now = QDateTime::currentDateTime();
-    QFile annofile(dirName+"/"+fn);
-    if (annofile.open(QIODevice::WriteOnly | QIODevice::Append |
-		      QIODevice::Text)) {
-	QTextStream out(&annofile);
-	out << anno << " " << now.toString("yyyy-MM-dd'T'hh:mm:sst")
-	    << "\n";
-	annofile.close();
+    takeSnapshots(journal->add(type, anno));
+}
+
+// ---------------------------------------------------------------------
+
+// Asks every active camera for a still of its last frame, named after
+// the annotation at ns.  The journal links each one once it is saved.
+void AvRecorder::takeSnapshots(qint64 ns) {
+    QSettings settings;
+    if (!outputLocationSet ||
+        !settings.value("snapshot/enabled", true).toBool())
+        return;
+
+    QCheckBox *boxes[] = { ui->camera_label_0, ui->camera_label_1 };
+    for (int n = 0; n < 2; n++) {
+        if (!boxes[n]->isEnabled() || !boxes[n]->isChecked())
+            continue;
+        QString file = QString("snapshot-%1-capture%2.jpg").arg(ns).arg(n);
+        emit snapshotRequested(n, dirName+"/"+file);
     }
 }
 
@@ -702,7 +906,7 @@ void AvRecorder::setStatus(int status, bool write) {
     ui->statusButton_6->setChecked(status==6);
 
     if (write)
-	writeAnnotation(status, "status.txt");
+	writeAnnotation(status, "status");
 }
 
 // ---------------------------------------------------------------------
@@ -716,7 +920,7 @@ void AvRecorder::setPose(int pose, bool write) {
     ui->poseButton_2->setChecked(pose==2);
 
     if (write)
-	writeAnnotation(pose, "pose.txt");
+	writeAnnotation(pose, "pose");
 }
 
 // ---------------------------------------------------------------------
@@ -746,7 +950,7 @@ void AvRecorder::handleEvent(int ev) {
 	QTimer::singleShot(2000, this, SLOT(uncheckEvent4()));
 	break;
     }
-    writeAnnotation(ev, "events.txt");
+    writeAnnotation(ev, "event");
 }
 
 // ---------------------------------------------------------------------
@@ -45,15 +45,20 @@
 #include <QMediaRecorder>
 #include <QUrl>
 #include <QDateTime>
+#include <QElapsedTimer>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class AvRecorder; }
-class QAudioRecorder;
-class QAudioProbe;
-class QAudioBuffer;
+class QLabel;
+class QTimer;
 QT_END_NAMESPACE
 
 class QAudioLevel;
+class StartBarrier;
+class AudioMeter;
+class AudioRecorder;
+class AnnotationJournal;
+class StorageMonitor;
 
 class AvRecorder : public QMainWindow
 {
@@ -63,18 +68,25 @@ public:
     AvRecorder(QWidget *parent = 0);
     ~AvRecorder();
 
+    StartBarrier *startBarrier() { return barrier; }
+
+    /// Devices recorded in addition to the one in the device box
+    void setExtraAudioInputs(const QStringList&);
+    void setAudioResampling(bool);
+
 signals:
     void outputDirectory(const QString&);
     void stateChanged(QMediaRecorder::State);
     void cameraOutput(QString);
     void cameraFramerate(QString);
     void cameraPowerChanged(int, int);
+    void snapshotRequested(int, const QString&);
 
 public slots:
-    void processBuffer(const QAudioBuffer&);
     void processQImage(int n, const QImage qimg);
     void processCameraInfo(int, int, int);
     void disableCameraCheckbox(int n);
+    void processWriterState(int n, bool open);
     void displayErrorMessage(const QString&);
     void uncheckEvent1();
     void uncheckEvent2();
@@ -84,9 +96,11 @@ public slots:
 private slots:
     void setOutputLocation();
     bool OutputLocationEmptyOrOk();
+    bool StorageSufficient();
     void upload();
     void togglePause();
     void toggleRecord();
+    void applyAudioSettings();
 
     void setStatusTo1();
     void setStatusTo2();
@@ -112,18 +126,25 @@ private slots:
     void onStateChanged(QMediaRecorder::State);
     void updateProgress(qint64 pos);
     void displayErrorMessage();
+    void updateMetrics();
+    void refreshAudioLevels();
+    void writeStartTime();
+    void storageLow(int);
+    void storageFull();
 
 private:
     void clearAudioLevels();
+    void showProgress();
     void setStatus(int, bool=true);
     void setPose(int, bool=true);
     void handleEvent(int);
     void writeAnnotation(int, const QString &);
+    void takeSnapshots(qint64 ns);
+    void updateCatalog();
 
     Ui::AvRecorder *ui;
 
-    QAudioRecorder *audioRecorder;
-    QAudioProbe *probe;
+    AudioRecorder *audioRecorder;
     QList<QAudioLevel*> audioLevels;
     bool outputLocationSet;
 
@@ -131,6 +152,25 @@ private:
     QString dirName;
 
     QDateTime rec_started;
+    qint64 rec_duration;
+
+    QLabel *metricsLabel;
+    QLabel *continuityLabel;
+    QTimer *metricsTimer;
+    /// Polls the barrier until the start of the files is fixed
+    QTimer *startTimeTimer;
+
+    StartBarrier *barrier;
+
+    AnnotationJournal *journal;
+    StorageMonitor *storage;
+
+    AudioMeter *meter;
+    QTimer *meterTimer;
+
+    /// GUI time spent on the level meters in the current window
+    qint64 meter_gui_ns;
+    QElapsedTimer meter_window;
 
 };
 
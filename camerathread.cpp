@@ -24,21 +24,39 @@
 
 #include <QDebug>
 #include <QDateTime>
+#include <QSettings>
 #include <QTextStream>
 #include <QLinkedList>
 
 #include "boost/date_time/posix_time/posix_time.hpp"
 
 #include "camerathread.h"
+#include "startbarrier.h"
+#include "masterclock.h"
+#include "capturecoordinator.h"
+#include "metrics.h"
+#include "videowriterthread.h"
+#include "streamposition.h"
+#include "volumes.h"
+#include "preroll.h"
+#include "snapshotwriter.h"
+#include "thumbnailatlas.h"
 
 using namespace boost::posix_time;
 using namespace cv;
 
 // ---------------------------------------------------------------------
 
-CameraThread::CameraThread(int i) : idx(i), is_active(false),
-				    was_active(false)
+CameraThread::CameraThread(int i) : idx(i), record_video(false),
+				    start_pending(false), nwritten(0),
+				    barrier(NULL), coordinator(NULL),
+				    is_active(false), was_active(false),
+				    writer(NULL), writer_open(false),
+				    preroll(NULL), preroll_flush(false),
+				    thumbnails(NULL)
 {
+    stream_name = QString("capture%1").arg(idx);
+    setDefaultOutput();
     setDefaultDesiredInputSize();
     window_size = Size(240,135);
 }
@@ -46,9 +64,21 @@ CameraThread::CameraThread(int i) : idx(i), is_active(false),
 // ---------------------------------------------------------------------
 
 CameraThread::CameraThread(int i, QString wxh) : idx(i),
+						 record_video(false),
+						 start_pending(false),
+						 nwritten(0),
+						 barrier(NULL),
+						 coordinator(NULL),
 						 is_active(false),
-						 was_active(false)
+						 was_active(false),
+						 writer(NULL),
+						 writer_open(false),
+						 preroll(NULL),
+						 preroll_flush(false),
+						 thumbnails(NULL)
 {
+  stream_name = QString("capture%1").arg(idx);
+  setDefaultOutput();
   if (wxh.contains('x')) {
     QStringList wh = wxh.split('x');
     bool ok = true;
@@ -64,6 +94,16 @@ CameraThread::CameraThread(int i, QString wxh) : idx(i),
 
 // ---------------------------------------------------------------------
 
+void CameraThread::setDefaultOutput() {
+    // Note: These need to match the default values in AvRecorder::AvRecorder():
+    framerate = 25;
+    output_size = Size(640,360);
+    outdir = "";
+    record_issued_ns = 0;
+}
+
+// ---------------------------------------------------------------------
+
 void CameraThread::setDefaultDesiredInputSize() {
   desired_input_size.width = 1280;
   desired_input_size.height = 720;
@@ -82,40 +122,26 @@ void CameraThread::run() Q_DECL_OVERRIDE {
     // int delayFound = 0;
 
     // initialize capture on default source
-    VideoCapture capture(idx);
-    if (!capture.isOpened()) {
+    VideoCapture capture;
+    if (!openCapture(capture, true)) {
       emit errorMessage(QString("Warning: Failed to initialize camera %1.")
                                 .arg(idx));
+      if (barrier)
+	  barrier->leave(stream_name);
       return;
     }
 
-#if defined(Q_OS_LINUX)
-    qDebug() << "Camera" << idx
-	     << ": Trying to set input size to" << desired_input_size.width 
-	     << "x" << desired_input_size.height;
-    QString v4l2 = QString("/usr/bin/v4l2-ctl -d /dev/video%1 -v width=%2,height=%3")
-      .arg(idx).arg(desired_input_size.width).arg(desired_input_size.height);
-    int ret = system(v4l2.toStdString().c_str());
-    qDebug() << "Command [" << v4l2 << "] returned" << ret; 
-
-    capture.set(CV_CAP_PROP_FRAME_WIDTH, desired_input_size.width);
-    capture.set(CV_CAP_PROP_FRAME_HEIGHT, desired_input_size.height);
-#endif
-
-    // Get the properties from the camera
-    input_size.width =  capture.get(CV_CAP_PROP_FRAME_WIDTH);
-    input_size.height = capture.get(CV_CAP_PROP_FRAME_HEIGHT);
-
     // print camera frame size
     qDebug() << "Camera" << idx
              << ": Input size: width:" << input_size.width 
 	     << "height:" << input_size.height;
     emit cameraInfo(idx, input_size.width, input_size.height);
 
-    outdir = "";
-    filename = QString("capture%1.avi").arg(idx);
+    segment = 0;
+    filename = segmentFilename();
 
     record_video = false;
+    start_pending = false;
 
 #if defined(Q_OS_WIN)
     fourcc = -1;
@@ -123,10 +149,6 @@ void CameraThread::run() Q_DECL_OVERRIDE {
     fourcc = CV_FOURCC('m','p','4','v');
 #endif
 
-    // Note: These need to match the default values in AvRecorder::AvRecorder():
-    framerate = 25;
-    output_size = Size(640,360);
-
     // initialize initial timestamps
     nextFrameTimestamp = microsec_clock::local_time();
     currentFrameTimestamp = nextFrameTimestamp;
@@ -135,7 +157,31 @@ void CameraThread::run() Q_DECL_OVERRIDE {
     QLinkedList<time_duration> tdlist;
 
     stopLoop = false;
-    is_active = true;
+    setCameraPower(idx, true);
+
+    int sync_slot = -1;
+    if (coordinator)
+	sync_slot = coordinator->attach(idx, &capture);
+
+    QSettings settings;
+    writer = new VideoWriterThread(stream_name,
+				   settings.value("video/writer_queue_frames",
+						  50).toInt());
+    connect(writer, SIGNAL(errorMessage(const QString&)),
+	    this, SIGNAL(errorMessage(const QString&)));
+    writer->start();
+
+    thumbnails = new ThumbnailAtlas(stream_name);
+    thumbnails->start(QThread::LowestPriority);
+
+    if (PreRoll::length() > 0) {
+	preroll = new PreRoll(stream_name);
+	jpeg_params.clear();
+	jpeg_params.push_back(CV_IMWRITE_JPEG_QUALITY);
+	jpeg_params.push_back(settings.value("preroll/jpeg_quality",
+					     90).toInt());
+    }
+    preroll_flush = false;
 
     double avgload = 0.0;
     size_t nframe = 0;
@@ -146,59 +192,143 @@ void CameraThread::run() Q_DECL_OVERRIDE {
 	break;
       }
 
-      // Happens when Stop was pressed:
-      if (!record_video && video.isOpened())
-	  video.release();
+      processCommands();
+
+      if (!isActive()) {
+	  if (was_active) {
+	      was_active = false;
+	      QImage qimg = Mat2QImage(Mat::zeros(window_size, CV_8UC3));
+	      emit qimgReady(idx, qimg);
+	  }
+	  last_frame.release();
+	  last_stamp.release();
+	  if (!suspend(capture, sync_slot))
+	      break;
+	  nextFrameTimestamp = microsec_clock::local_time();
+	  currentFrameTimestamp = nextFrameTimestamp;
+	  td = (currentFrameTimestamp - nextFrameTimestamp);
+	  continue;
+      }
       
       // determine time at start of loop
       initialLoopTimestamp = microsec_clock::local_time();
             
       Mat frame;
       
-      capture >> frame;
+      qint64 frame_ns = 0, tick = -1;
+      if (sync_slot >= 0) {
+	  // The coordinator grabs all cameras together and paces the loop
+	  bool grabbed = false;
+	  if (!coordinator->waitGrab(sync_slot, tick, frame_ns, grabbed))
+	      continue;
+	  if (grabbed)
+	      capture.retrieve(frame);
+      } else {
+	  capture >> frame;
+	  frame_ns = MasterClock::nsecs();
+      }
       nframe++;
+
+      // Wait for the common start instant before writing anything:
+      if (record_video && start_pending) {
+	  qint64 start_ns = barrier ? barrier->startTime() : 0;
+	  if (start_ns >= 0 && frame_ns >= start_ns) {
+	      start_pending = false;
+	      // The index within the file, where this frame or the
+	      // first one of the pre-roll will be written:
+	      qint64 start_index = nwritten, start_frame_ns = frame_ns;
+	      if (preroll_flush)
+		  flushPreRoll(start_frame_ns);
+	      else if (preroll)
+		  preroll->clear();
+	      if (barrier)
+		  barrier->setStartIndex(stream_name, start_index,
+					 start_frame_ns);
+	  }
+      }
+
+      // A new segment that failed to open ends the recording:
+      if (writer_open && writer->hasFailed()) {
+	  writer_open = false;
+	  record_video = false;
+	  emit writerState(idx, false);
+      }
+
+      bool write_frame = frame.cols && frame.rows &&
+	  record_video && !start_pending && writer_open;
+      if (sync_slot >= 0)
+	  coordinator->retrieved(sync_slot, write_frame ? nwritten : -1);
       
-      if (is_active) {
-	  was_active = true;
+      was_active = true;
+
+      if (frame.cols && frame.rows) {
 
-	  if (frame.cols && frame.rows) {
+	  // Snapshots take the captured frame.  Scaling makes a new one
+	  // for the rest of the loop, otherwise only the strip under the
+	  // timestamp is copied:
+	  last_frame = frame;
+	  last_stamp.release();
 	  
-	      if (output_size.width != 0)
-		  resizeAR(frame, output_size);
+	  if (output_size.width != 0)
+	      resizeAR(frame, output_size);
+
+	  if (frame.data == last_frame.data) {
+	      stamp_rect = Rect(0, qMax(0, frame.rows-24),
+				qMin(frame.cols, 320), qMin(frame.rows, 24));
+	      last_stamp = frame(stamp_rect).clone();
+	  }
 	  
-	      QDateTime datetime = QDateTime::currentDateTime();
-	      rectangle(frame, Point(2,frame.rows-22), Point(300, frame.rows-8),
-			Scalar(0,0,0), CV_FILLED);
-	      putText(frame, datetime.toString().toStdString().c_str(),
-		      Point(10,frame.rows-10), FONT_HERSHEY_PLAIN, 1.0,
-		      Scalar(255,255,255));
+	  QDateTime datetime = QDateTime::currentDateTime();
+	  rectangle(frame, Point(2,frame.rows-22), Point(300, frame.rows-8),
+		    Scalar(0,0,0), CV_FILLED);
+	  putText(frame, datetime.toString().toStdString().c_str(),
+		  Point(10,frame.rows-10), FONT_HERSHEY_PLAIN, 1.0,
+		  Scalar(255,255,255));
+
+	  // Until the file starts, the frames go to the pre-roll:
+	  if (preroll && (!writer_open || start_pending)) {
+	      std::vector<uchar> jpeg;
+	      if (imencode(".jpg", frame, jpeg, jpeg_params))
+		  preroll->push(frame_ns, nframe, 1,
+				QByteArray(reinterpret_cast<const char*>
+					   (&jpeg[0]), jpeg.size()));
+	  }
 	  
-	      // Save frame to video
-	      if (record_video && video.isOpened())
-		  video << frame;
-
-	      Mat window;
-	      resize(frame, window, window_size);
-	      putText(window, QString::number(nframe).toStdString().c_str(),
-		      Point(10, 20), FONT_HERSHEY_PLAIN, 1.5,
+	  // Save frame to video, a frame that does not fit in the
+	  // writer's queue is replaced by a repeat of the previous one:
+	  if (write_frame) {
+	      writer->write(frame, frame_ns);
+	      StreamPosition::set(stream_name, segment, nwritten, frame_ns);
+	      if (nwritten++ == 0) {
+		  qint64 ms = (MasterClock::nsecs()-record_issued_ns)/1000000;
+		  qDebug() << "Camera" << idx << ": first frame queued"
+			   << ms << "ms after Record";
+		  Metrics::set(stream_name+".first_frame_ms", ms);
+	      }
+	  }
+
+	  Mat window;
+	  resize(frame, window, window_size);
+
+	  // The contact sheet gets the preview without its overlays:
+	  if (write_frame && thumbnails->due(frame_ns))
+	      thumbnails->add(window, frame_ns, segment, nwritten-1);
+
+	  putText(window, QString::number(nframe).toStdString().c_str(),
+		  Point(10, 20), FONT_HERSHEY_PLAIN, 1.5,
+		  Scalar(0,0,255), 2);
+	  putText(window, QString::number(avgload, 'f', 2).toStdString().c_str(),
+		  Point(window.cols-60, 20), FONT_HERSHEY_PLAIN, 1.5,
+		  Scalar(0,0,255), 2);
+	  if (avgload>1.0)
+	      putText(window, "CPU OVERLOAD",
+		      Point(0,80), FONT_HERSHEY_PLAIN, 1.9,
 		      Scalar(0,0,255), 2);
-	      putText(window, QString::number(avgload, 'f', 2).toStdString().c_str(),
-		      Point(window.cols-60, 20), FONT_HERSHEY_PLAIN, 1.5,
-		      Scalar(0,0,255), 2);
-	      if (avgload>1.0)
-		  putText(window, "CPU OVERLOAD",
-			  Point(0,80), FONT_HERSHEY_PLAIN, 1.9,
-			  Scalar(0,0,255), 2);
-	      QImage qimg = Mat2QImage(window);
-	      emit qimgReady(idx, qimg);
-	  
-	  } else
-	      qDebug() << "Camera" << idx << ": Skipped frame";
-      } else if (was_active) {
-	  was_active = false;
-	  QImage qimg = Mat2QImage(Mat::zeros(window_size, CV_8UC3));
+	  QImage qimg = Mat2QImage(window);
 	  emit qimgReady(idx, qimg);
-      }
+	  
+      } else
+	  qDebug() << "Camera" << idx << ": Skipped frame";
 
       //write previous and current frame timestamp to console
       //qDebug() << nextFrameTimestamp << " " << currentFrameTimestamp << " ";
@@ -206,18 +336,20 @@ void CameraThread::run() Q_DECL_OVERRIDE {
       // determine time when all processing done
       processingDoneTimestamp = microsec_clock::local_time();
 
-      // wait for X microseconds until 1second/framerate time has passed after previous frame write
-      while(td.total_microseconds() < 1000000/framerate){
-	  //determine current elapsed time
-	  currentFrameTimestamp = microsec_clock::local_time();
-	  td = (currentFrameTimestamp - nextFrameTimestamp);
-      }
+      if (sync_slot < 0) {
+	  // wait for X microseconds until 1second/framerate time has passed after previous frame write
+	  while(td.total_microseconds() < 1000000/framerate){
+	      //determine current elapsed time
+	      currentFrameTimestamp = microsec_clock::local_time();
+	      td = (currentFrameTimestamp - nextFrameTimestamp);
+	  }
 
-      // add 1second/framerate time for next loop pause
-      nextFrameTimestamp = nextFrameTimestamp + microsec(1000000/framerate);
+	  // add 1second/framerate time for next loop pause
+	  nextFrameTimestamp = nextFrameTimestamp + microsec(1000000/framerate);
       
-      // reset time_duration so while loop engages
-      td = (currentFrameTimestamp - nextFrameTimestamp);
+	  // reset time_duration so while loop engages
+	  td = (currentFrameTimestamp - nextFrameTimestamp);
+      }
       
       //determine and print out delay in ms, should be less than 1000/FPS
       //occasionally, if delay is larger than said value, correction will occur
@@ -249,6 +381,22 @@ void CameraThread::run() Q_DECL_OVERRIDE {
       
     } // for (;;) // td2.total_milliseconds()
 
+    if (sync_slot >= 0)
+	coordinator->detach(sync_slot);
+
+    // Finishes the queued frames and closes the file:
+    writer->breakLoop();
+    writer->wait();
+    delete writer;
+    writer = NULL;
+    writer_open = false;
+    delete preroll;
+    preroll = NULL;
+    thumbnails->breakLoop();
+    thumbnails->wait();
+    delete thumbnails;
+    thumbnails = NULL;
+
     emit resultReady(result);
 }
 
@@ -280,44 +428,254 @@ void CameraThread::resizeAR(Mat &frame, Size osize) {
 // ---------------------------------------------------------------------
 
 void CameraThread::setOutputDirectory(const QString &d) {
-    outdir = d+"/";
+    postCommand(CameraCommand::SetOutputDirectory, d);
+}
+
+// ---------------------------------------------------------------------
+
+void CameraThread::takeSnapshot(int n, const QString &file) {
+    if (n == idx)
+        postCommand(CameraCommand::Snapshot, file);
 }
 
 // ---------------------------------------------------------------------
 
+// The writer lifecycle is handled on the camera thread, here we only
+// queue the request.  The timestamp is used to measure the latency
+// from the Record click to the first encoded frame.
 void CameraThread::onStateChanged(QMediaRecorder::State state) {
     switch (state) {
     case QMediaRecorder::RecordingState:
-        if (!is_active) {
-            record_video = false;
-            break;
-        }
-        if (!video.isOpened()) {
-	    qDebug() << QString("CameraThread::onStateChanged(): initializing "
-				"VideoWriter for camera %1").arg(idx);
-	    video.open(QString(outdir+filename).toStdString(), fourcc, framerate,
-                       (output_size.width ? output_size : input_size));
-        }
-        if (!video.isOpened()) {
-            emit errorMessage(QString("ERROR: Failed to initialize camera %1")
-                                      .arg(idx));
-        } else {
-	    qDebug() << QString("CameraThread::onStateChanged(): initialization "
-				"ready for camera %1").arg(idx);
-            record_video = true;
-        }
+        postCommand(CameraCommand::OpenWriter);
         break;
     case QMediaRecorder::PausedState:
-        record_video = false;
+        postCommand(CameraCommand::PauseWriter);
         break;
     case QMediaRecorder::StoppedState:
-        record_video = false;
+        postCommand(CameraCommand::CloseWriter);
         break;
     }
 }
 
 // ---------------------------------------------------------------------
 
+void CameraThread::postCommand(CameraCommand::Type type, const QString &arg) {
+    CameraCommand cmd;
+    cmd.type = type;
+    cmd.arg = arg;
+    cmd.issued_ns = MasterClock::nsecs();
+    {
+        QMutexLocker locker(&command_mutex);
+        commands.enqueue(cmd);
+    }
+    QMutexLocker locker(&power_mutex);
+    power_changed.wakeAll();
+}
+
+// ---------------------------------------------------------------------
+
+// Runs on the camera thread between frames.
+void CameraThread::processCommands() {
+    QQueue<CameraCommand> todo;
+    {
+        QMutexLocker locker(&command_mutex);
+        todo.swap(commands);
+    }
+
+    bool reconfigure = false;
+
+    while (!todo.isEmpty()) {
+        CameraCommand cmd = todo.dequeue();
+        switch (cmd.type) {
+        case CameraCommand::OpenWriter:
+            openWriter(cmd.issued_ns);
+            break;
+        case CameraCommand::PauseWriter:
+            record_video = false;
+            break;
+        case CameraCommand::CloseWriter:
+            record_video = false;
+            if (writer_open) {
+                writer->close();
+                writer_open = false;
+                emit writerState(idx, false);
+            }
+            break;
+        case CameraCommand::SetOutputSize: {
+            Size old_size = output_size;
+            if (cmd.arg == "Original") {
+                output_size = Size(0,0);
+            } else {
+                QStringList wh = cmd.arg.split("x");
+                if (wh.length()==2) {
+                    output_size = Size(wh.at(0).toInt(), wh.at(1).toInt());
+                }
+            }
+            if (output_size != old_size)
+                reconfigure = true;
+            break;
+        }
+        case CameraCommand::SetFramerate:
+            if (cmd.arg.toInt() > 0 && cmd.arg.toInt() != framerate) {
+                framerate = cmd.arg.toInt();
+                reconfigure = true;
+            }
+            break;
+        case CameraCommand::SetOutputDirectory:
+            outdir = cmd.arg+"/";
+            break;
+        case CameraCommand::Snapshot:
+            saveSnapshot(cmd.arg);
+            break;
+        }
+    }
+
+    // We are between two frames here, so the new segment starts
+    // exactly with the next captured frame.  Buffered frames of the
+    // old size or rate would not fit the file:
+    if (reconfigure && preroll)
+        preroll->clear();
+    if (reconfigure && writer_open)
+        startSegment();
+}
+
+// ---------------------------------------------------------------------
+
+QString CameraThread::segmentFilename() const {
+    if (segment == 0)
+        return QString("capture%1.avi").arg(idx);
+    return QString("capture%1-%2.avi").arg(idx).arg(segment);
+}
+
+// ---------------------------------------------------------------------
+
+bool CameraThread::openVideo() {
+    Size size = output_size.width ? output_size : input_size;
+    filename = segmentFilename();
+    nwritten = 0;
+    // The stream may be placed on a volume of its own:
+    QString dir = Volumes::directory(stream_name);
+    writer_open = writer->open(dir.isEmpty() ? outdir : dir+"/", filename,
+                               fourcc, framerate, size,
+                               segmentDetails());
+    return writer_open;
+}
+
+// ---------------------------------------------------------------------
+
+QString CameraThread::segmentDetails() const {
+    Size size = output_size.width ? output_size : input_size;
+    return QString("size=%1x%2 fps=%3").arg(size.width).arg(size.height)
+        .arg(framerate);
+}
+
+// ---------------------------------------------------------------------
+
+// Continues recording in a new file with the current output size and
+// frame rate.  The writer thread switches files after the frames
+// already queued, without holding up capture.
+void CameraThread::startSegment() {
+    Size size = output_size.width ? output_size : input_size;
+    segment++;
+    filename = segmentFilename();
+    nwritten = 0;
+    writer->startSegment(filename, framerate, size, segmentDetails());
+}
+
+// ---------------------------------------------------------------------
+
+// Hands the buffered frames from the common start of the pre-roll on
+// to the writer, ahead of the frame that reached the start instant.
+// The stream then starts with the first of them, at the same index
+// in the file.
+void CameraThread::flushPreRoll(qint64 &t_ns) {
+    preroll_flush = false;
+    qint64 from_ns = barrier->recordFrom();
+    qint64 until_ns = t_ns;
+    qint64 capture_index = 0;
+    int n = preroll->trim(from_ns, until_ns, capture_index, t_ns);
+    Metrics::set(stream_name+".preroll_frames", n);
+    if (n == 0) {
+        preroll->clear();
+        return;
+    }
+    writer->writePreRoll(preroll, from_ns, until_ns);
+    nwritten += n;
+    qDebug() << "Camera" << idx << ":" << n << "frames of pre-roll";
+}
+
+// ---------------------------------------------------------------------
+
+// The frame is shared with the writer, so a still that needs the
+// strip under the timestamp back is a copy.
+void CameraThread::saveSnapshot(const QString &file) {
+    if (last_frame.empty()) {
+        qWarning() << "WARNING: Camera" << idx << "has no frame for"
+                   << file;
+        Metrics::add("snapshot.dropped", 1);
+        return;
+    }
+    Mat still = last_frame;
+    if (!last_stamp.empty()) {
+        still = last_frame.clone();
+        last_stamp.copyTo(still(stamp_rect));
+    }
+    SnapshotWriter::submit(still, file, idx);
+}
+
+// ---------------------------------------------------------------------
+
+void CameraThread::openWriter(qint64 issued_ns) {
+    if (!isActive()) {
+        record_video = false;
+        if (barrier)
+            barrier->withdraw(stream_name);
+        return;
+    }
+
+    bool fresh = !writer_open;
+    if (!writer_open) {
+        qint64 t0 = MasterClock::nsecs();
+        qDebug() << QString("CameraThread::openWriter(): initializing "
+                            "VideoWriter for camera %1").arg(idx);
+        segment = 0;
+        if (openVideo())
+            thumbnails->begin(outdir);
+        Metrics::set(stream_name+".writer_open_ms",
+                     (MasterClock::nsecs()-t0)/1000000);
+    }
+
+    if (!writer_open) {
+        emit errorMessage(QString("ERROR: Failed to initialize camera %1")
+                          .arg(idx));
+        emit writerState(idx, false);
+        if (barrier)
+            barrier->withdraw(stream_name);
+        return;
+    }
+
+    qDebug() << QString("CameraThread::openWriter(): initialization "
+                        "ready for camera %1").arg(idx);
+    start_pending = true;
+    record_video = true;
+    record_issued_ns = issued_ns;
+    emit writerState(idx, true);
+
+    // A new recording can start from the frames before Record:
+    preroll_flush = false;
+    if (preroll && fresh && barrier) {
+        qint64 oldest = preroll->hold(MasterClock::nsecs());
+        if (oldest >= 0) {
+            barrier->setBuffered(stream_name, oldest);
+            preroll_flush = true;
+        }
+    }
+    if (barrier)
+        barrier->ready(stream_name);
+}
+
+// ---------------------------------------------------------------------
+
 QImage CameraThread::Mat2QImage(cv::Mat const& src) {
      cv::Mat temp;
      cvtColor(src, temp,CV_BGR2RGB);
@@ -331,27 +689,36 @@ QImage CameraThread::Mat2QImage(cv::Mat const& src) {
 
 void CameraThread::setCameraOutput(QString wxh) {
     qDebug() << "CameraThread::setCameraOutput(): " << wxh;
-    if (wxh == "Original") {
-        output_size = Size(0,0);
-    } else {
-        QStringList wh = wxh.split("x");
-        if (wh.length()==2) {
-            output_size = Size(wh.at(0).toInt(), wh.at(1).toInt());
-        }
-    }
+    postCommand(CameraCommand::SetOutputSize, wxh);
 }
 
 // ---------------------------------------------------------------------
 
 void CameraThread::setCameraFramerate(QString fps) {
     qDebug() << "CameraThread::setCameraFramerate(): " << fps;
-    framerate  = fps.toInt();
+    postCommand(CameraCommand::SetFramerate, fps);
 }
 
 // ---------------------------------------------------------------------
 
 void CameraThread::breakLoop() {
+    QMutexLocker locker(&power_mutex);
     stopLoop = true;
+    power_changed.wakeAll();
+}
+
+// ---------------------------------------------------------------------
+
+void CameraThread::setStartBarrier(StartBarrier *b) {
+    barrier = b;
+    if (barrier)
+        barrier->join(stream_name);
+}
+
+// ---------------------------------------------------------------------
+
+void CameraThread::setCaptureCoordinator(CaptureCoordinator *c) {
+    coordinator = c;
 }
 
 // ---------------------------------------------------------------------
@@ -359,8 +726,95 @@ void CameraThread::breakLoop() {
 void CameraThread::setCameraPower(int i, int state) {
     if (i == idx) {
         qDebug() << "Camera" << idx << "power now" << state;
+        QMutexLocker locker(&power_mutex);
         is_active = state;
+        power_changed.wakeAll();
+    }
+}
+
+// ---------------------------------------------------------------------
+
+bool CameraThread::isActive() {
+    QMutexLocker locker(&power_mutex);
+    return is_active;
+}
+
+// ---------------------------------------------------------------------
+
+// Releases the device so that it stops streaming, and parks the thread
+// until the camera is powered on again.  Returns false if the thread
+// should exit.
+bool CameraThread::suspend(VideoCapture &capture, int &sync_slot) {
+    qDebug() << "Camera" << idx << "suspending";
+
+    if (sync_slot >= 0) {
+	coordinator->detach(sync_slot);
+	sync_slot = -1;
+    }
+    capture.release();
+
+    {
+	QMutexLocker locker(&power_mutex);
+	while (!is_active && !stopLoop) {
+	    power_changed.wait(&power_mutex, 500);
+	    locker.unlock();
+	    processCommands();
+	    locker.relock();
+	}
+	if (stopLoop)
+	    return false;
+    }
+
+    // Reuse the format negotiated when the thread started:
+    qint64 t0 = MasterClock::nsecs();
+    if (!openCapture(capture, false)) {
+	emit errorMessage(QString("Warning: Failed to resume camera %1.")
+			  .arg(idx));
+	setCameraPower(idx, false);
+	return true;
+    }
+    qDebug() << "Camera" << idx << "resumed in"
+	     << (MasterClock::nsecs()-t0)/1000000 << "ms";
+
+    if (coordinator)
+	sync_slot = coordinator->attach(idx, &capture);
+
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+// With negotiate, the desired input size is requested from the driver
+// and the resulting size is stored in input_size.  Otherwise the
+// previously negotiated input_size is reapplied as is.
+bool CameraThread::openCapture(VideoCapture &capture, bool negotiate) {
+    if (!capture.open(idx))
+	return false;
+
+    if (!negotiate) {
+	capture.set(CV_CAP_PROP_FRAME_WIDTH, input_size.width);
+	capture.set(CV_CAP_PROP_FRAME_HEIGHT, input_size.height);
+	return true;
     }
+
+#if defined(Q_OS_LINUX)
+    qDebug() << "Camera" << idx
+	     << ": Trying to set input size to" << desired_input_size.width 
+	     << "x" << desired_input_size.height;
+    QString v4l2 = QString("/usr/bin/v4l2-ctl -d /dev/video%1 -v width=%2,height=%3")
+      .arg(idx).arg(desired_input_size.width).arg(desired_input_size.height);
+    int ret = system(v4l2.toStdString().c_str());
+    qDebug() << "Command [" << v4l2 << "] returned" << ret; 
+
+    capture.set(CV_CAP_PROP_FRAME_WIDTH, desired_input_size.width);
+    capture.set(CV_CAP_PROP_FRAME_HEIGHT, desired_input_size.height);
+#endif
+
+    // Get the properties from the camera
+    input_size.width =  capture.get(CV_CAP_PROP_FRAME_WIDTH);
+    input_size.height = capture.get(CV_CAP_PROP_FRAME_HEIGHT);
+
+    return true;
 }
 
 // ---------------------------------------------------------------------
@@ -2,6 +2,9 @@
 #define CAMERATHREAD_H
 
 #include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
 #include <QImage>
 #include <QMediaRecorder>
 
@@ -10,6 +13,21 @@
 #include "opencv2/highgui/highgui.hpp"
 #include "opencv2/imgproc/imgproc.hpp"
 
+class StartBarrier;
+class CaptureCoordinator;
+class VideoWriterThread;
+class PreRoll;
+class ThumbnailAtlas;
+
+/// Request posted from the GUI thread to the camera thread
+struct CameraCommand {
+    enum Type { OpenWriter, PauseWriter, CloseWriter, SetOutputSize,
+                SetFramerate, SetOutputDirectory, Snapshot };
+    Type type;
+    QString arg;
+    qint64 issued_ns;
+};
+
 class CameraThread : public QThread
 {
     Q_OBJECT
@@ -21,6 +39,7 @@ signals:
     void resultReady(const QString &s);
     void cameraInfo(int, int, int);
     void errorMessage(const QString &e);
+    void writerState(int, bool);
 
 public slots:
     void setOutputDirectory(const QString &d);
@@ -29,12 +48,21 @@ public slots:
     void setCameraFramerate(QString);
     void setCameraPower(int, int);
 
+    /// Saves the last captured frame of camera n at full resolution
+    void takeSnapshot(int n, const QString &filename);
+
 public:
     CameraThread(int i);
     CameraThread(int i, QString wxh);
 
     void breakLoop();
 
+    /// Take part in synchronized record starts
+    void setStartBarrier(StartBarrier *);
+
+    /// Synchronized capture mode, must be set before start()
+    void setCaptureCoordinator(CaptureCoordinator *);
+
 private:
     QImage Mat2QImage(cv::Mat const& src);
 
@@ -42,6 +70,21 @@ private:
     void resizeAR(cv::Mat &, cv::Size);
 
     void setDefaultDesiredInputSize();
+    void setDefaultOutput();
+
+    void postCommand(CameraCommand::Type, const QString &arg = QString());
+    void processCommands();
+    void openWriter(qint64 issued_ns);
+    bool openVideo();
+    void startSegment();
+    void flushPreRoll(qint64 &t_ns);
+    void saveSnapshot(const QString &filename);
+    QString segmentFilename() const;
+    QString segmentDetails() const;
+
+    bool openCapture(cv::VideoCapture &, bool negotiate);
+    bool suspend(cv::VideoCapture &, int &sync_slot);
+    bool isActive();
 
     int framerate;
     int fourcc;
@@ -54,9 +97,39 @@ private:
 
     bool record_video;
 
+    /// Writer is open, waiting for the barrier's start instant
+    bool start_pending;
+
+    /// Frames queued for the current video file
+    qint64 nwritten;
+
+    /// When the current OpenWriter was requested
+    qint64 record_issued_ns;
+
+    /// Pending commands from other threads.  Everything else below is
+    /// only touched on the camera thread, except where noted.
+    QMutex command_mutex;
+    QQueue<CameraCommand> commands;
+
+    StartBarrier *barrier;
+    CaptureCoordinator *coordinator;
+    QString stream_name;
+
+    /// is_active and stopLoop are guarded by power_mutex
     bool is_active, was_active;
+    QMutex power_mutex;
+    QWaitCondition power_changed;
+
+    /// Encodes and writes on its own thread, exists while run() does
+    VideoWriterThread *writer;
+    bool writer_open;
 
-    cv::VideoWriter video;
+    /// JPEG frames from before Record, see PreRoll.  Exists while
+    /// run() does, if "preroll/seconds" is set.
+    PreRoll *preroll;
+    std::vector<int> jpeg_params;
+    /// The writer was opened for a new recording with a pre-roll
+    bool preroll_flush;
 
     cv::Size output_size;
 
@@ -65,6 +138,20 @@ private:
     QString outdir;
     QString filename;
 
+    /// The last captured frame for snapshots, see SnapshotWriter.
+    /// Without scaling the overlay is drawn on it, and last_stamp
+    /// keeps what was under it at stamp_rect.
+    cv::Mat last_frame;
+    cv::Mat last_stamp;
+    cv::Rect stamp_rect;
+
+    /// Contact sheet of the recording, exists while run() does
+    ThumbnailAtlas *thumbnails;
+
+    /// Output size or frame rate changes during recording continue in
+    /// a new file, capture<idx>-<segment>.avi
+    int segment;
+
     bool stopLoop;
 
 };
@@ -0,0 +1,256 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDebug>
+
+#include "capturecoordinator.h"
+#include "masterclock.h"
+
+// ---------------------------------------------------------------------
+
+CaptureCoordinator::CaptureCoordinator() : next_id(0), tick(0),
+                                           framerate(25), stop_loop(0)
+{
+}
+
+// ---------------------------------------------------------------------
+
+CaptureCoordinator::~CaptureCoordinator() {
+    qDeleteAll(devices);
+}
+
+// ---------------------------------------------------------------------
+
+void CaptureCoordinator::run() {
+
+    qint64 next_ns = MasterClock::nsecs();
+
+    while (!stop_loop.load()) {
+        qint64 period_ns = 1000000000LL/framerate.load();
+
+        // The camera threads look up their slots under mutex while
+        // this pass waits for them, so it runs under pass_mutex only:
+        QList<Slot*> attached;
+        {
+            QMutexLocker locker(&mutex);
+            attached = devices;
+        }
+
+        {
+            QMutexLocker plocker(&pass_mutex);
+
+            // Devices whose camera thread has not yet retrieved the
+            // previous frame sit this tick out:
+            QList<Slot*> ready;
+            foreach (Slot *s, attached)
+                if (s->free.tryAcquire(1, int(period_ns/2000000)))
+                    ready.append(s);
+
+            qint64 tick_ns = MasterClock::nsecs(), first_ns = 0, last_ns = 0;
+            for (int i=0; i<ready.size(); i++) {
+                Slot *s = ready.at(i);
+                s->ok = s->cap->grab();
+                s->grab_ns = MasterClock::nsecs();
+                if (i==0)
+                    first_ns = s->grab_ns;
+                last_ns = s->grab_ns;
+            }
+
+            if (ready.size()) {
+                TickRecord rec;
+                rec.skew_us = (last_ns-first_ns)/1000;
+                rec.pending = ready.size();
+                QMutexLocker flocker(&file_mutex);
+                ticks.insert(tick, rec);
+                while (ticks.size() && ticks.firstKey() < tick-100)
+                    ticks.erase(ticks.begin());
+            }
+
+            foreach (Slot *s, ready) {
+                s->tick = tick;
+                s->tick_ns = tick_ns;
+                s->grabbed.release();
+            }
+            tick++;
+        }
+
+        next_ns += period_ns;
+        qint64 now = MasterClock::nsecs();
+        if (next_ns > now)
+            usleep((next_ns-now)/1000);
+        else if (now-next_ns > period_ns)
+            next_ns = now; // fell behind, don't try to catch up
+    }
+
+    qDebug() << "CaptureCoordinator stopping";
+}
+
+// ---------------------------------------------------------------------
+
+int CaptureCoordinator::attach(int idx, cv::VideoCapture *cap) {
+    QMutexLocker locker(&mutex);
+    Slot *s = new Slot;
+    s->id = next_id++;
+    s->idx = idx;
+    s->cap = cap;
+    s->ok = false;
+    s->tick = -1;
+    s->tick_ns = 0;
+    s->grab_ns = 0;
+    s->free.release();
+    devices.append(s);
+    qDebug() << "CaptureCoordinator: camera" << idx << "attached";
+    return s->id;
+}
+
+// ---------------------------------------------------------------------
+
+// The slot may still be in the list of a pass that is in progress, so
+// it is deleted, and the device released by the caller, only after
+// that pass is over.
+void CaptureCoordinator::detach(int slot) {
+    Slot *s;
+    {
+        QMutexLocker locker(&mutex);
+        s = findSlot(slot);
+        if (!s)
+            return;
+        devices.removeAll(s);
+    }
+    QMutexLocker plocker(&pass_mutex);
+    qDebug() << "CaptureCoordinator: camera" << s->idx << "detached";
+    delete s;
+}
+
+// ---------------------------------------------------------------------
+
+CaptureCoordinator::Slot *CaptureCoordinator::findSlot(int id) {
+    foreach (Slot *s, devices)
+        if (s->id == id)
+            return s;
+    return NULL;
+}
+
+// ---------------------------------------------------------------------
+
+bool CaptureCoordinator::waitGrab(int slot, qint64 &t, qint64 &tick_ns,
+                                  bool &ok) {
+    Slot *s;
+    {
+        QMutexLocker locker(&mutex);
+        s = findSlot(slot);
+    }
+    // Only the owning camera thread may detach, so s stays valid here:
+    if (!s || !s->grabbed.tryAcquire(1, 200))
+        return false;
+    t = s->tick;
+    tick_ns = s->tick_ns;
+    ok = s->ok;
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+void CaptureCoordinator::retrieved(int slot, qint64 fileframe) {
+    Slot *s;
+    {
+        QMutexLocker locker(&mutex);
+        s = findSlot(slot);
+    }
+    if (!s)
+        return;
+
+    {
+        QMutexLocker flocker(&file_mutex);
+        QMap<qint64, TickRecord>::iterator it = ticks.find(s->tick);
+        if (it != ticks.end()) {
+            it->frames.insert(s->idx, fileframe);
+            if (--it->pending == 0) {
+                writeSkew(it.key(), it.value());
+                ticks.erase(it);
+            }
+        }
+    }
+
+    s->free.release();
+}
+
+// ---------------------------------------------------------------------
+
+void CaptureCoordinator::writeSkew(qint64 t, const TickRecord &rec) {
+    bool recorded = false;
+    QMap<int, qint64>::const_iterator it;
+    for (it = rec.frames.constBegin(); it != rec.frames.constEnd(); ++it)
+        if (it.value() >= 0)
+            recorded = true;
+    if (!recorded || outdir.isEmpty())
+        return;
+
+    if (!skewfile.isOpen()) {
+        skewfile.setFileName(outdir+"skew.txt");
+        if (!skewfile.open(QIODevice::WriteOnly | QIODevice::Append |
+                           QIODevice::Text)) {
+            qWarning() << "WARNING: Failed to open" << skewfile.fileName();
+            return;
+        }
+        skewout.setDevice(&skewfile);
+        skewout << "# tick skew_us camera:frame ..." << "\n";
+    }
+
+    skewout << t << " " << rec.skew_us;
+    for (it = rec.frames.constBegin(); it != rec.frames.constEnd(); ++it)
+        skewout << " " << it.key() << ":" << it.value();
+    skewout << "\n";
+}
+
+// ---------------------------------------------------------------------
+
+void CaptureCoordinator::setOutputDirectory(const QString &d) {
+    QMutexLocker flocker(&file_mutex);
+    if (skewfile.isOpen()) {
+        skewout.flush();
+        skewfile.close();
+    }
+    outdir = d+"/";
+}
+
+// ---------------------------------------------------------------------
+
+void CaptureCoordinator::setCameraFramerate(QString fps) {
+    int f = fps.toInt();
+    if (f > 0)
+        framerate.store(f);
+}
+
+// ---------------------------------------------------------------------
+
+void CaptureCoordinator::breakLoop() {
+    stop_loop.store(1);
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,123 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef CAPTURECOORDINATOR_H
+#define CAPTURECOORDINATOR_H
+
+#include <QThread>
+#include <QMutex>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QList>
+#include <QMap>
+#include <QFile>
+#include <QTextStream>
+
+#include "opencv2/highgui/highgui.hpp"
+
+/// Synchronized capture for multiple cameras.
+///
+/// Each CameraThread attaches its VideoCapture.  On every tick the
+/// coordinator calls grab() on all attached devices back to back, so
+/// that their exposures are as close together as possible, and then
+/// lets every camera thread retrieve() and decode its frame in
+/// parallel.  The spread of the grab() completion times is the
+/// inter-camera skew, which is written to skew.txt for every tick
+/// during which some camera wrote a frame.
+class CaptureCoordinator : public QThread
+{
+    Q_OBJECT
+
+    void run();
+
+public slots:
+    void setOutputDirectory(const QString &d);
+    void setCameraFramerate(QString);
+
+public:
+    CaptureCoordinator();
+    ~CaptureCoordinator();
+
+    /// Called from a camera thread, returns a slot number
+    int attach(int idx, cv::VideoCapture *cap);
+    void detach(int slot);
+
+    /// Called from a camera thread: waits for the next grab on its
+    /// device.  Returns false on timeout.  tick_ns is the master clock
+    /// time of the tick, common to all cameras.
+    bool waitGrab(int slot, qint64 &tick, qint64 &tick_ns, bool &ok);
+
+    /// Called from a camera thread after retrieve(), the device may be
+    /// grabbed again.  fileframe is the frame number in the video file
+    /// or -1 if the frame is not recorded.
+    void retrieved(int slot, qint64 fileframe);
+
+    void breakLoop();
+
+private:
+    struct Slot {
+        int id;
+        int idx;
+        cv::VideoCapture *cap;
+        QSemaphore grabbed;
+        QSemaphore free;
+        bool ok;
+        qint64 tick;
+        qint64 tick_ns;
+        /// When grab() returned on the last tick
+        qint64 grab_ns;
+    };
+
+    struct TickRecord {
+        qint64 skew_us;
+        int pending;
+        QMap<int, qint64> frames;
+    };
+
+    Slot *findSlot(int id);
+    void writeSkew(qint64 tick, const TickRecord &);
+
+    QMutex mutex;
+    QList<Slot*> devices;
+    /// Held by run() while it waits for and grabs the devices
+    QMutex pass_mutex;
+    int next_id;
+    qint64 tick;
+
+    QAtomicInt framerate;
+    QAtomicInt stop_loop;
+
+    QMutex file_mutex;
+    QMap<qint64, TickRecord> ticks;
+    QString outdir;
+    QFile skewfile;
+    QTextStream skewout;
+};
+
+#endif // CAPTURECOORDINATOR_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,526 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <sqlite3.h>
+
+#include "catalog.h"
+#include "meetingdir.h"
+#include "timeline.h"
+
+namespace {
+
+    const char *schema =
+        "CREATE TABLE IF NOT EXISTS meetings ("
+        " id INTEGER PRIMARY KEY, path TEXT UNIQUE NOT NULL,"
+        " mtime INTEGER, start_ms INTEGER, duration_ms INTEGER,"
+        " host TEXT, bytes INTEGER, files INTEGER, uploaded_ms INTEGER);"
+        "CREATE INDEX IF NOT EXISTS meetings_start ON meetings(start_ms);"
+        "CREATE INDEX IF NOT EXISTS meetings_host ON meetings(host);"
+        "CREATE TABLE IF NOT EXISTS streams ("
+        " meeting INTEGER NOT NULL, stream TEXT, files INTEGER,"
+        " bytes INTEGER);"
+        "CREATE INDEX IF NOT EXISTS streams_stream ON streams(stream, meeting);"
+        "CREATE INDEX IF NOT EXISTS streams_meeting ON streams(meeting);"
+        "CREATE TABLE IF NOT EXISTS annotations ("
+        " meeting INTEGER NOT NULL, t_ms INTEGER, type TEXT, value INTEGER);"
+        "CREATE INDEX IF NOT EXISTS annotations_type"
+        " ON annotations(type, value, meeting);"
+        "CREATE INDEX IF NOT EXISTS annotations_meeting"
+        " ON annotations(meeting);";
+
+    /// Finalizes the statement when it goes out of scope
+    class Statement {
+    public:
+        Statement(sqlite3 *db, const std::string &sql) : s(NULL) {
+            sqlite3_prepare_v2(db, sql.c_str(), -1, &s, NULL);
+        }
+        ~Statement() { sqlite3_finalize(s); }
+        operator sqlite3_stmt *() const { return s; }
+        bool ok() const { return s != NULL; }
+    private:
+        sqlite3_stmt *s;
+    };
+
+    /// Files of a meeting whose modification times are stored.  All
+    /// but the last are written while recording, by this or by older
+    /// versions of the recorder.
+    const char *summarized[] = { "/starttime.txt", "/hostname.txt",
+                                 "/manifest.txt", "/annotations.txt",
+                                 "/status.txt", "/pose.txt", "/events.txt",
+                                 "/uploaded.txt" };
+    const size_t recorded = sizeof(summarized)/sizeof(*summarized)-1;
+
+    /// Tracks of the timeline that are stored as annotations
+    const char *annotated[] = { "status", "pose", "event" };
+
+    bool isDirectory(const std::string &path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    bool exists(const std::string &path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0;
+    }
+
+    std::string absolute(const std::string &path) {
+        char buf[PATH_MAX];
+        if (realpath(path.c_str(), buf))
+            return buf;
+        return path;
+    }
+
+    std::string firstLine(const std::string &filename) {
+        std::ifstream in(filename.c_str());
+        std::string line;
+        std::getline(in, line);
+        return line;
+    }
+
+    /// A volume directory only has the streams placed on it, and the
+    /// summary of the meeting needs at least one of its own files.
+    bool isMeeting(const std::string &dir) {
+        if (exists(dir+"/meeting.txt"))
+            return false;
+        for (size_t i = 0; i < recorded; i++)
+            if (exists(dir+summarized[i]))
+                return true;
+        return false;
+    }
+
+    /// Latest modification time, in seconds, of the directories of the
+    /// meeting and the files its summary is read from
+    int64_t modified(const std::string &dir) {
+        int64_t latest = 0;
+        struct stat st;
+        std::vector<std::string> dirs = MeetingDir::directories(dir);
+        for (size_t i = 0; i < dirs.size(); i++)
+            if (stat(dirs[i].c_str(), &st) == 0)
+                latest = std::max(latest, int64_t(st.st_mtime));
+        for (size_t i = 0; i < sizeof(summarized)/sizeof(*summarized); i++)
+            if (stat((dir+summarized[i]).c_str(), &st) == 0)
+                latest = std::max(latest, int64_t(st.st_mtime));
+        return latest;
+    }
+
+    int64_t fileSize(const std::string &path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+    }
+
+    /// Video and audio files, and what is written along with them
+    bool isMedia(const std::string &name) {
+        return name.compare(0, 7, "capture") == 0 ||
+            name.compare(0, 5, "audio") == 0;
+    }
+}
+
+// ---------------------------------------------------------------------
+
+Catalog::Filter::Filter() : from(-1), to(-1), value(-1), min_duration(-1),
+                            uploaded(-1) {}
+
+// ---------------------------------------------------------------------
+
+Catalog::Catalog() : db(NULL) {}
+
+Catalog::~Catalog() {
+    close();
+}
+
+// ---------------------------------------------------------------------
+
+bool Catalog::open(const std::string &filename) {
+    close();
+    if (sqlite3_open(filename.c_str(), &db) != SQLITE_OK) {
+        fail("cannot open "+filename);
+        close();
+        return false;
+    }
+    // The recorder and the scanner may write at the same time, and
+    // readers do not block either with a write-ahead log.
+    sqlite3_busy_timeout(db, 5000);
+    return exec("PRAGMA journal_mode=WAL;") &&
+        exec("PRAGMA synchronous=NORMAL;") && exec(schema);
+}
+
+void Catalog::close() {
+    if (db)
+        sqlite3_close(db);
+    db = NULL;
+}
+
+// ---------------------------------------------------------------------
+
+bool Catalog::fail(const std::string &what) {
+    error = what;
+    if (db)
+        error += std::string(": ")+sqlite3_errmsg(db);
+    return false;
+}
+
+bool Catalog::exec(const char *sql) {
+    if (!db)
+        return fail("no catalog open");
+    if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK)
+        return fail(sql);
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+bool Catalog::update(const std::string &dir) {
+    std::string path = absolute(dir);
+    if (!exec("BEGIN;"))
+        return false;
+    if (!store(path, modified(path))) {
+        exec("ROLLBACK;");
+        return false;
+    }
+    return exec("COMMIT;");
+}
+
+// ---------------------------------------------------------------------
+
+int Catalog::rescan(const std::string &where, bool all) {
+    std::string root = absolute(where);
+    DIR *d = opendir(root.c_str());
+    if (!d) {
+        fail("cannot read "+root);
+        return -1;
+    }
+    std::set<std::string> found;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        std::string name(e->d_name);
+        if (name == "." || name == "..")
+            continue;
+        std::string path = root+"/"+name;
+        if (isDirectory(path) && isMeeting(path))
+            found.insert(path);
+    }
+    closedir(d);
+
+    if (!exec("BEGIN;"))
+        return -1;
+
+    std::map<std::string, int64_t> known;
+    {
+        Statement q(db, "SELECT path, mtime FROM meetings"
+                    " WHERE substr(path, 1, ?1) = ?2;");
+        std::string prefix = root+"/";
+        sqlite3_bind_int(q, 1, int(prefix.size()));
+        sqlite3_bind_text(q, 2, prefix.c_str(), -1, SQLITE_TRANSIENT);
+        while (q.ok() && sqlite3_step(q) == SQLITE_ROW)
+            known[(const char *)sqlite3_column_text(q, 0)] =
+                sqlite3_column_int64(q, 1);
+    }
+
+    int n = 0;
+    bool ok = true;
+    std::map<std::string, int64_t>::const_iterator k;
+    for (k = known.begin(); ok && k != known.end(); ++k)
+        if (!found.count(k->first))
+            ok = store(k->first, -1);
+
+    std::set<std::string>::const_iterator f;
+    for (f = found.begin(); ok && f != found.end(); ++f) {
+        int64_t mtime = modified(*f);
+        k = known.find(*f);
+        if (all || k == known.end() || k->second != mtime) {
+            ok = store(*f, mtime);
+            n++;
+        }
+    }
+
+    if (!ok) {
+        exec("ROLLBACK;");
+        return -1;
+    }
+    return exec("COMMIT;") ? n : -1;
+}
+
+// ---------------------------------------------------------------------
+
+// Replaces the rows of a meeting, or only removes them if mtime < 0.
+bool Catalog::store(const std::string &dir, int64_t mtime) {
+    const char *remove[] = {
+        "DELETE FROM streams WHERE meeting IN"
+        " (SELECT id FROM meetings WHERE path = ?1);",
+        "DELETE FROM annotations WHERE meeting IN"
+        " (SELECT id FROM meetings WHERE path = ?1);",
+        "DELETE FROM meetings WHERE path = ?1;" };
+    for (size_t i = 0; i < 3; i++) {
+        Statement q(db, remove[i]);
+        if (!q.ok())
+            return fail(remove[i]);
+        sqlite3_bind_text(q, 1, dir.c_str(), -1, SQLITE_TRANSIENT);
+        if (sqlite3_step(q) != SQLITE_DONE)
+            return fail("cannot remove "+dir);
+    }
+    if (mtime < 0)
+        return true;
+
+    int64_t start = Timeline::parseTime(firstLine(dir+"/starttime.txt"));
+    std::string host = firstLine(dir+"/hostname.txt");
+    std::istringstream uploaded_line(firstLine(dir+"/uploaded.txt"));
+    std::string uploaded_at;
+    uploaded_line >> uploaded_at;
+    int64_t uploaded = uploaded_at.empty() ? -1 :
+        Timeline::parseTime(uploaded_at);
+
+    // master_ns wallclock stream event file [key=value ...]
+    std::map<std::string, std::set<std::string> > streams;
+    long long first_ns = 0, last_ns = 0;
+    bool any = false;
+    {
+        std::ifstream in((dir+"/manifest.txt").c_str());
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            long long ns;
+            std::string wall, stream, event, file;
+            if (!(fields >> ns >> wall >> stream >> event >> file))
+                continue;
+            if (!any && start < 0)
+                start = Timeline::parseTime(wall);
+            first_ns = any ? std::min(first_ns, ns) : ns;
+            last_ns = any ? std::max(last_ns, ns) : ns;
+            any = true;
+            streams[stream].insert(file[0] == '/' ? file : dir+"/"+file);
+        }
+    }
+    int64_t duration = any ? (last_ns-first_ns)/1000000 : -1;
+
+    // Also the status.txt, pose.txt and events.txt of older recordings
+    Timeline timeline;
+    timeline.compile(dir);
+
+    int64_t bytes = 0, media_ms = -1;
+    int files = 0;
+    std::vector<std::string> dirs = MeetingDir::directories(dir);
+    for (size_t v = 0; v < dirs.size(); v++) {
+        DIR *d = opendir(dirs[v].c_str());
+        if (!d)
+            continue;
+        struct dirent *e;
+        while ((e = readdir(d)) != NULL) {
+            std::string name(e->d_name), path = dirs[v]+"/"+name;
+            struct stat st;
+            if ((v > 0 && name == "meeting.txt") ||
+                stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+                continue;
+            bytes += st.st_size;
+            files++;
+            if (isMedia(name))
+                media_ms = std::max(media_ms, int64_t(st.st_mtime)*1000);
+        }
+        closedir(d);
+    }
+
+    // Without a manifest, the media files were last written when the
+    // recording stopped.  Failing that, the annotations give a lower
+    // bound.
+    if (duration < 0 && start >= 0 && media_ms > start)
+        duration = media_ms-start;
+    if (duration < 0 && !timeline.empty()) {
+        if (start < 0)
+            start = timeline.start();
+        duration = timeline.end()-timeline.start();
+    }
+
+    {
+        Statement q(db, "INSERT INTO meetings (path, mtime, start_ms,"
+                    " duration_ms, host, bytes, files, uploaded_ms)"
+                    " VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8);");
+        if (!q.ok())
+            return fail("cannot prepare insert");
+        sqlite3_bind_text(q, 1, dir.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(q, 2, mtime);
+        sqlite3_bind_int64(q, 3, start);
+        sqlite3_bind_int64(q, 4, duration);
+        sqlite3_bind_text(q, 5, host.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(q, 6, bytes);
+        sqlite3_bind_int(q, 7, files);
+        sqlite3_bind_int64(q, 8, uploaded);
+        if (sqlite3_step(q) != SQLITE_DONE)
+            return fail("cannot add "+dir);
+    }
+    sqlite3_int64 id = sqlite3_last_insert_rowid(db);
+
+    Statement sq(db, "INSERT INTO streams (meeting, stream, files, bytes)"
+                 " VALUES (?1, ?2, ?3, ?4);");
+    if (!sq.ok())
+        return fail("cannot prepare insert");
+    std::map<std::string, std::set<std::string> >::const_iterator s;
+    for (s = streams.begin(); s != streams.end(); ++s) {
+        int64_t stream_bytes = 0;
+        std::set<std::string>::const_iterator f;
+        for (f = s->second.begin(); f != s->second.end(); ++f)
+            stream_bytes += fileSize(*f);
+        sqlite3_reset(sq);
+        sqlite3_bind_int64(sq, 1, id);
+        sqlite3_bind_text(sq, 2, s->first.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(sq, 3, int(s->second.size()));
+        sqlite3_bind_int64(sq, 4, stream_bytes);
+        if (sqlite3_step(sq) != SQLITE_DONE)
+            return fail("cannot add the streams of "+dir);
+    }
+
+    // Each change of state and each event, at its start
+    Statement aq(db, "INSERT INTO annotations (meeting, t_ms, type, value)"
+                 " VALUES (?1, ?2, ?3, ?4);");
+    if (!aq.ok())
+        return fail("cannot prepare insert");
+    for (size_t i = 0; i < sizeof(annotated)/sizeof(*annotated); i++) {
+        std::vector<Timeline::Interval> intervals;
+        timeline.between(annotated[i], timeline.start(), timeline.end(),
+                         intervals);
+        for (size_t j = 0; j < intervals.size(); j++) {
+            sqlite3_reset(aq);
+            sqlite3_bind_int64(aq, 1, id);
+            sqlite3_bind_int64(aq, 2, intervals[j].start);
+            sqlite3_bind_text(aq, 3, annotated[i], -1, SQLITE_STATIC);
+            sqlite3_bind_int(aq, 4, intervals[j].value);
+            if (sqlite3_step(aq) != SQLITE_DONE)
+                return fail("cannot add the annotations of "+dir);
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+bool Catalog::find(const Filter &filter, std::vector<Meeting> &out) {
+    if (!db)
+        return fail("no catalog open");
+
+    std::string sql =
+        "SELECT path, host, start_ms, duration_ms, uploaded_ms, bytes,"
+        " files, (SELECT group_concat(stream, ' ') FROM streams s"
+        " WHERE s.meeting = m.id) FROM meetings m WHERE 1";
+    std::vector<int64_t> numbers;
+    std::vector<std::string> texts;
+    std::vector<bool> is_text;
+
+    if (filter.from >= 0) {
+        sql += " AND start_ms >= ?";
+        numbers.push_back(filter.from);
+        is_text.push_back(false);
+    }
+    if (filter.to >= 0) {
+        sql += " AND start_ms >= 0 AND start_ms < ?";
+        numbers.push_back(filter.to);
+        is_text.push_back(false);
+    }
+    if (filter.min_duration >= 0) {
+        sql += " AND duration_ms >= ?";
+        numbers.push_back(filter.min_duration);
+        is_text.push_back(false);
+    }
+    if (!filter.host.empty()) {
+        sql += " AND host = ?";
+        texts.push_back(filter.host);
+        is_text.push_back(true);
+    }
+    if (!filter.name.empty()) {
+        sql += " AND instr(path, ?) > 0";
+        texts.push_back(filter.name);
+        is_text.push_back(true);
+    }
+    if (!filter.stream.empty()) {
+        sql += " AND EXISTS (SELECT 1 FROM streams s"
+            " WHERE s.meeting = m.id AND s.stream = ?)";
+        texts.push_back(filter.stream);
+        is_text.push_back(true);
+    }
+    if (!filter.type.empty()) {
+        sql += " AND EXISTS (SELECT 1 FROM annotations a"
+            " WHERE a.meeting = m.id AND a.type = ?";
+        texts.push_back(filter.type);
+        is_text.push_back(true);
+        if (filter.value >= 0) {
+            sql += " AND a.value = ?";
+            numbers.push_back(filter.value);
+            is_text.push_back(false);
+        }
+        sql += ")";
+    }
+    if (filter.uploaded == 0)
+        sql += " AND uploaded_ms < 0";
+    else if (filter.uploaded > 0)
+        sql += " AND uploaded_ms >= 0";
+    sql += " ORDER BY start_ms, path;";
+
+    Statement q(db, sql);
+    if (!q.ok())
+        return fail("cannot prepare query");
+    size_t n = 0, t = 0;
+    for (size_t i = 0; i < is_text.size(); i++)
+        if (is_text[i])
+            sqlite3_bind_text(q, int(i+1), texts[t++].c_str(), -1,
+                              SQLITE_TRANSIENT);
+        else
+            sqlite3_bind_int64(q, int(i+1), numbers[n++]);
+
+    int rc;
+    while ((rc = sqlite3_step(q)) == SQLITE_ROW) {
+        Meeting m;
+        const unsigned char *host = sqlite3_column_text(q, 1);
+        const unsigned char *streams = sqlite3_column_text(q, 7);
+        m.path = (const char *)sqlite3_column_text(q, 0);
+        m.host = host ? (const char *)host : "";
+        m.start = sqlite3_column_int64(q, 2);
+        m.duration = sqlite3_column_int64(q, 3);
+        m.uploaded = sqlite3_column_int64(q, 4);
+        m.bytes = sqlite3_column_int64(q, 5);
+        m.files = sqlite3_column_int(q, 6);
+        std::istringstream names(streams ? (const char *)streams : "");
+        std::string name;
+        while (names >> name)
+            m.streams.push_back(name);
+        std::sort(m.streams.begin(), m.streams.end());
+        out.push_back(m);
+    }
+    if (rc != SQLITE_DONE)
+        return fail("query failed");
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
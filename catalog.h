@@ -0,0 +1,127 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+// Plain C++ so that the tools can use this without Qt.
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct sqlite3;
+
+/// An SQLite index of the meetings under a directory such as
+/// ~/Meetings, so that they can be searched without reading every
+/// meeting directory.
+///
+/// Each meeting is summarized from its own files and those on the
+/// volumes its streams were placed on (see MeetingDir):
+///
+///   starttime.txt, hostname.txt   start and host
+///   manifest.txt                  duration, streams and their files
+///   annotations.txt, or status.txt, pose.txt and events.txt
+///                                 annotations, as type and value (see
+///                                 Timeline)
+///   uploaded.txt                  time of the last complete upload
+///
+/// Without a manifest the duration runs from the start to the last
+/// write of the video and audio files, or spans the annotations.
+///
+/// The modification times of the directories and of these files are
+/// stored with the summary.  rescan() reads a meeting again only if
+/// one of them has changed, and drops the meetings that are gone.
+///
+/// Times are milliseconds since the epoch, -1 if unknown.
+class Catalog
+{
+public:
+    struct Meeting {
+        std::string path;
+        std::string host;
+        int64_t start;
+        int64_t duration;
+        int64_t uploaded;
+        int64_t bytes;
+        int files;
+        std::vector<std::string> streams;
+    };
+
+    /// Conditions of find(), all of them must hold.  Empty strings and
+    /// negative values match everything.
+    struct Filter {
+        Filter();
+
+        /// Meetings starting in [from, to)
+        int64_t from, to;
+        /// Host name, exact
+        std::string host;
+        /// Part of the path
+        std::string name;
+        /// A stream of the meeting
+        std::string stream;
+        /// An annotation of this type, and value if value >= 0
+        std::string type;
+        int value;
+        /// Meetings at least this long
+        int64_t min_duration;
+        /// 1 for uploaded meetings, 0 for the others
+        int uploaded;
+    };
+
+    Catalog();
+    ~Catalog();
+
+    /// Opens or creates the database file
+    bool open(const std::string &filename);
+    void close();
+
+    /// Reads a meeting directory again, whether it has changed or not
+    bool update(const std::string &dir);
+
+    /// Updates the changed meetings directly under root and drops the
+    /// missing ones.  Returns the number of meetings read, -1 on error.
+    int rescan(const std::string &root, bool all = false);
+
+    /// Meetings in start time order
+    bool find(const Filter &filter, std::vector<Meeting> &out);
+
+    std::string errorString() const { return error; }
+
+private:
+    bool exec(const char *sql);
+    bool store(const std::string &dir, int64_t mtime);
+    bool fail(const std::string &what);
+
+    sqlite3 *db;
+    std::string error;
+};
+
+#endif // CATALOG_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
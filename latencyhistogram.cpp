@@ -0,0 +1,81 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "latencyhistogram.h"
+#include "metrics.h"
+
+// ---------------------------------------------------------------------
+
+LatencyHistogram::LatencyHistogram() {
+    clear();
+}
+
+// ---------------------------------------------------------------------
+
+void LatencyHistogram::clear() {
+    for (int i = 0; i < Buckets; i++)
+        buckets[i] = 0;
+    n = max_us = 0;
+}
+
+// ---------------------------------------------------------------------
+
+// Bucket b holds times below 2^b microseconds
+void LatencyHistogram::add(qint64 us) {
+    int b = 0;
+    while (b < Buckets-1 && (qint64(1) << b) <= us)
+        b++;
+    buckets[b]++;
+    n++;
+    if (us > max_us)
+        max_us = us;
+}
+
+// ---------------------------------------------------------------------
+
+qint64 LatencyHistogram::percentile(double p) const {
+    if (!n)
+        return 0;
+    qint64 rank = qint64(p/100*n+0.5), seen = 0;
+    for (int b = 0; b < Buckets; b++) {
+        seen += buckets[b];
+        if (seen >= rank && seen > 0)
+            return qMin(qint64(1) << b, max_us);
+    }
+    return max_us;
+}
+
+// ---------------------------------------------------------------------
+
+void LatencyHistogram::publish(const QString &prefix) const {
+    Metrics::set(prefix+"_p50", percentile(50));
+    Metrics::set(prefix+"_p99", percentile(99));
+    Metrics::set(prefix+"_max", max_us);
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
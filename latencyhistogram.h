@@ -0,0 +1,63 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QString>
+
+/// Histogram of operation times in power-of-two microsecond buckets,
+/// cheap enough to update for every write.  Percentiles are accurate
+/// to a factor of two, which is enough to tell a page cache hit from a
+/// disk stall.  Not thread-safe, each writer keeps its own.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void add(qint64 us);
+    void clear();
+
+    qint64 count() const { return n; }
+    qint64 max() const { return max_us; }
+
+    /// Upper bound of the bucket holding the p'th percentile
+    qint64 percentile(double p) const;
+
+    /// Sets <prefix>_p50, _p99 and _max in Metrics
+    void publish(const QString &prefix) const;
+
+private:
+    static const int Buckets = 32;
+    qint64 buckets[Buckets];
+    qint64 n;
+    qint64 max_us;
+};
+
+#endif // LATENCYHISTOGRAM_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
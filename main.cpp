@@ -64,6 +64,8 @@
 
 #include "avrecorder.h"
 #include "camerathread.h"
+#include "masterclock.h"
+#include "capturecoordinator.h"
 
 #include <QtWidgets>
 #include <QTextStream>
@@ -72,11 +74,18 @@
 
 void help(const QString& cmd) {
   QTextStream cout(stdout);
-  cout << "USAGE: " << cmd << " [0:videosize] [1:videosize]" << endl
+  cout << "USAGE: " << cmd << " [--sync] [--audio=device]... [--resample]"
+       << " [0:videosize] [1:videosize]" << endl
        << endl
        << "  supported videosizes: WxH, fullhd, 1080p, hd, 720p" << endl
        << "  (currently only for Linux; OS X uses max camera resolution)"
        << endl
+       << "  --sync: grab all cameras together, skew is saved to skew.txt"
+       << endl
+       << "  --audio=device: record also from this audio device, e.g. hw:1,0"
+       << endl
+       << "  --resample: resample all audio devices to the master clock"
+       << endl
        << endl;
 }
 
@@ -90,6 +99,8 @@ int main(int argc, char *argv[])
 
     QApplication app(argc, argv);
 
+    MasterClock::nsecs(); // starts the clock
+
     AvRecorder recorder;
     recorder.show();
 
@@ -109,6 +120,15 @@ int main(int argc, char *argv[])
 #endif
 
     QStringList args = QCoreApplication::arguments();
+    bool sync_capture = args.removeAll("--sync") > 0;
+    recorder.setAudioResampling(args.removeAll("--resample") > 0);
+    QStringList extra_audio;
+    foreach (const QString &arg, args)
+	if (arg.startsWith("--audio="))
+	    extra_audio << arg.mid(8);
+    foreach (const QString &device, extra_audio)
+	args.removeAll("--audio="+device);
+    recorder.setExtraAudioInputs(extra_audio);
     QBitArray use_cameras(2);
     QMap<int, QString> wxhs;
     QMap<QString, QString> resolutions;
@@ -166,6 +186,17 @@ int main(int argc, char *argv[])
 	     << use_cameras.at(0)
 	     << use_cameras.at(1);
     
+    CaptureCoordinator *coordinator = NULL;
+    if (sync_capture) {
+	qDebug() << "Using synchronized capture";
+	coordinator = new CaptureCoordinator;
+	QObject::connect(&recorder, SIGNAL(outputDirectory(const QString&)),
+			 coordinator, SLOT(setOutputDirectory(const QString&)));
+	QObject::connect(&recorder, SIGNAL(cameraFramerate(QString)),
+			 coordinator, SLOT(setCameraFramerate(QString)));
+	coordinator->start();
+    }
+
     QList<CameraThread *> cameras;
     for (int idx=0; idx<2; idx++) {
       if (!use_cameras.at(idx)) {
@@ -185,6 +216,8 @@ int main(int argc, char *argv[])
 	cam = new CameraThread(idx);
       }
 
+        cam->setStartBarrier(recorder.startBarrier());
+        cam->setCaptureCoordinator(coordinator);
         cam->start();
         cameras.append(cam);
 
@@ -203,6 +236,9 @@ int main(int argc, char *argv[])
         QObject::connect(&recorder, SIGNAL(cameraPowerChanged(int, int)),
                          cam, SLOT(setCameraPower(int, int)));
 
+        QObject::connect(&recorder, SIGNAL(snapshotRequested(int, const QString&)),
+                         cam, SLOT(takeSnapshot(int, const QString&)));
+
         QObject::connect(cam, SIGNAL(cameraInfo(int,int,int)),
                          &recorder, SLOT(processCameraInfo(int, int, int)));
 
@@ -211,6 +247,9 @@ int main(int argc, char *argv[])
 
         QObject::connect(cam, SIGNAL(errorMessage(const QString&)),
                          &recorder, SLOT(displayErrorMessage(const QString&)));
+
+        QObject::connect(cam, SIGNAL(writerState(int, bool)),
+                         &recorder, SLOT(processWriterState(int, bool)));
     }
 
     const int retval = app.exec();
@@ -227,6 +266,13 @@ int main(int argc, char *argv[])
 	}
       }
 
+    if (coordinator) {
+	coordinator->breakLoop();
+	if (!coordinator->wait(2000))
+	    qDebug() << "CaptureCoordinator failed to stop!";
+	delete coordinator;
+    }
+
   /*
     if (camera.isRunning()){
         camera.breakLoop();
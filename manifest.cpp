@@ -0,0 +1,74 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDateTime>
+#include <QDebug>
+#include <QTextStream>
+
+#include "manifest.h"
+#include "masterclock.h"
+#include "volumes.h"
+
+QMutex Manifest::mutex;
+QString Manifest::directory;
+
+// ---------------------------------------------------------------------
+
+void Manifest::setDirectory(const QString &dir) {
+    QMutexLocker locker(&mutex);
+    directory = dir;
+}
+
+// ---------------------------------------------------------------------
+
+void Manifest::add(const QString &stream, const QString &event,
+                   const QString &file, const QString &details) {
+    qint64 ns = MasterClock::nsecs();
+    QDateTime now = QDateTime::fromMSecsSinceEpoch(MasterClock::toMSecsSinceEpoch(ns));
+    QString where = Volumes::locate(stream, file);
+
+    QMutexLocker locker(&mutex);
+    if (directory.isEmpty())
+        return;
+
+    QFile mfile(directory+"/manifest.txt");
+    if (!mfile.open(QIODevice::WriteOnly | QIODevice::Append |
+                    QIODevice::Text)) {
+        qWarning() << "WARNING: Failed to open" << mfile.fileName();
+        return;
+    }
+    QTextStream out(&mfile);
+    out << ns << " " << now.toString("yyyy-MM-dd'T'hh:mm:ss.zzz")
+        << " " << stream << " " << event << " " << where;
+    if (!details.isEmpty())
+        out << " " << details;
+    out << "\n";
+    mfile.close();
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
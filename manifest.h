@@ -0,0 +1,59 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <QMutex>
+#include <QFile>
+#include <QString>
+
+/// Append-only list of the files making up a meeting, manifest.txt
+/// in the meeting directory.  Each line is
+///
+///   master_ns wallclock stream event file [key=value ...]
+///
+/// where event is one of open, segment or close.  A segment line
+/// means the stream continues in a new file from that point on.  The
+/// file is a bare name in the meeting directory, or an absolute path
+/// for streams placed on another volume (see Volumes).
+class Manifest
+{
+public:
+    static void setDirectory(const QString &dir);
+
+    static void add(const QString &stream, const QString &event,
+                    const QString &file, const QString &details = QString());
+
+private:
+    static QMutex mutex;
+    static QString directory;
+};
+
+#endif // MANIFEST_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
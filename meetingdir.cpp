@@ -0,0 +1,73 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <algorithm>
+#include <fstream>
+
+#include <sys/stat.h>
+
+#include "meetingdir.h"
+
+namespace {
+
+    bool isDirectory(const std::string &path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    }
+}
+
+// ---------------------------------------------------------------------
+
+std::vector<std::string> MeetingDir::directories(const std::string &meeting) {
+    std::vector<std::string> dirs(1, meeting);
+
+    std::ifstream in((meeting+"/volumes.txt").c_str());
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t sp = line.find(' ');
+        if (sp == std::string::npos)
+            continue;
+        std::string dir = line.substr(sp+1);
+        if (std::find(dirs.begin(), dirs.end(), dir) == dirs.end() &&
+            isDirectory(dir))
+            dirs.push_back(dir);
+    }
+    return dirs;
+}
+
+// ---------------------------------------------------------------------
+
+std::string MeetingDir::meetingOf(const std::string &dir) {
+    std::ifstream in((dir+"/meeting.txt").c_str());
+    std::string meeting;
+    if (std::getline(in, meeting) && isDirectory(meeting))
+        return meeting;
+    return dir;
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
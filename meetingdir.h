@@ -0,0 +1,54 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef MEETINGDIR_H
+#define MEETINGDIR_H
+
+// Plain C++ so that the tools can use this without Qt.
+
+#include <string>
+#include <vector>
+
+/// The files of a meeting whose streams were placed on several
+/// volumes.  The meeting directory lists the volume directories in
+/// volumes.txt, one "stream directory" line each, and every volume
+/// directory has a meeting.txt with the path of the meeting directory.
+class MeetingDir
+{
+public:
+    /// The meeting directory first, then the volume directories that
+    /// exist
+    static std::vector<std::string> directories(const std::string &meeting);
+
+    /// The meeting directory of a volume directory, or the directory
+    /// itself if it is not one
+    static std::string meetingOf(const std::string &dir);
+};
+
+#endif // MEETINGDIR_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,76 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QTextStream>
+
+#include "metrics.h"
+
+QMutex Metrics::mutex;
+QMap<QString, qint64> Metrics::values;
+
+// ---------------------------------------------------------------------
+
+void Metrics::set(const QString &key, qint64 value) {
+    QMutexLocker locker(&mutex);
+    values.insert(key, value);
+}
+
+// ---------------------------------------------------------------------
+
+void Metrics::add(const QString &key, qint64 delta) {
+    QMutexLocker locker(&mutex);
+    values[key] += delta;
+}
+
+// ---------------------------------------------------------------------
+
+qint64 Metrics::value(const QString &key) {
+    QMutexLocker locker(&mutex);
+    return values.value(key, 0);
+}
+
+// ---------------------------------------------------------------------
+
+QMap<QString, qint64> Metrics::snapshot() {
+    QMutexLocker locker(&mutex);
+    return values;
+}
+
+// ---------------------------------------------------------------------
+
+QString Metrics::report() {
+    QMap<QString, qint64> v = snapshot();
+    QString ret;
+    QTextStream out(&ret);
+    QMap<QString, qint64>::const_iterator it;
+    for (it = v.constBegin(); it != v.constEnd(); ++it)
+        out << it.key() << " " << it.value() << "\n";
+    return ret;
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,56 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QMutex>
+#include <QMap>
+#include <QString>
+
+/// Process-wide registry of named performance counters.  Any thread
+/// may update a value; AvRecorder shows them in the status bar and
+/// saves them to metrics.txt when recording stops.
+class Metrics
+{
+public:
+    static void set(const QString &key, qint64 value);
+    static void add(const QString &key, qint64 delta);
+    static qint64 value(const QString &key);
+    static QMap<QString, qint64> snapshot();
+
+    /// One "key value" line per metric
+    static QString report();
+
+private:
+    static QMutex mutex;
+    static QMap<QString, qint64> values;
+};
+
+#endif // METRICS_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
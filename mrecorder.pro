@@ -38,6 +38,30 @@ linux-g++* {
     #LIBS += $$OPENCVDIR/lib/libopencv_imgproc.so
     #LIBS += /usr/lib/x86_64-linux-gnu/libssh2.so.1
     LIBS += -lopencv_core -lopencv_highgui -lopencv_imgproc -lssh2
+
+    # Native audio capture, QAudioInput is used without it:
+    packagesExist(alsa) {
+        DEFINES += HAVE_ALSA
+        LIBS += -lasound
+    }
+}
+
+# Optional audio libraries, WAV is always available:
+unix {
+    CONFIG += link_pkgconfig
+    packagesExist(flac) {
+        DEFINES += HAVE_FLAC
+        PKGCONFIG += flac
+    }
+    packagesExist(libopusenc) {
+        DEFINES += HAVE_OPUSENC
+        PKGCONFIG += libopusenc
+    }
+    # Drift-compensating resampling of audio devices:
+    packagesExist(samplerate) {
+        DEFINES += HAVE_SAMPLERATE
+        PKGCONFIG += samplerate
+    }
 }
 
 win32 {
@@ -58,7 +82,38 @@ QT += widgets
 HEADERS = \
     avrecorder.h \
     qaudiolevel.h \
-    camerathread.h
+    camerathread.h \
+    masterclock.h \
+    startbarrier.h \
+    capturecoordinator.h \
+    metrics.h \
+    streamstats.h \
+    streamposition.h \
+    annotationjournal.h \
+    preallocator.h \
+    storagemonitor.h \
+    preroll.h \
+    snapshotwriter.h \
+    thumbnailatlas.h \
+    volumes.h \
+    meetingdir.h \
+    latencyhistogram.h \
+    videoindex.h \
+    videowriterthread.h \
+    manifest.h \
+    audiolevels.h \
+    audiometer.h \
+    audioring.h \
+    audiosource.h \
+    wavwriter.h \
+    audiosink.h \
+    audioencoder.h \
+    audiodrift.h \
+    audiorecorder.h \
+    voiceactivity.h \
+    vadindex.h \
+    waveform.h \
+    waveformthread.h
 
 !win32 {
     HEADERS += \
@@ -70,7 +125,38 @@ SOURCES = \
     main.cpp \
     avrecorder.cpp \
     qaudiolevel.cpp \
-    camerathread.cpp
+    camerathread.cpp \
+    masterclock.cpp \
+    startbarrier.cpp \
+    capturecoordinator.cpp \
+    metrics.cpp \
+    streamstats.cpp \
+    streamposition.cpp \
+    annotationjournal.cpp \
+    preallocator.cpp \
+    storagemonitor.cpp \
+    preroll.cpp \
+    snapshotwriter.cpp \
+    thumbnailatlas.cpp \
+    volumes.cpp \
+    meetingdir.cpp \
+    latencyhistogram.cpp \
+    videoindex.cpp \
+    videowriterthread.cpp \
+    manifest.cpp \
+    audiolevels.cpp \
+    audiometer.cpp \
+    audioring.cpp \
+    audiosource.cpp \
+    wavwriter.cpp \
+    audiosink.cpp \
+    audioencoder.cpp \
+    audiodrift.cpp \
+    audiorecorder.cpp \
+    voiceactivity.cpp \
+    vadindex.cpp \
+    waveform.cpp \
+    waveformthread.cpp
 
 !win32 {
     SOURCES += \
@@ -78,6 +164,14 @@ SOURCES = \
         uploadthread.cpp
 }
 
+# Meeting catalog for tools/query_catalog:
+unix:packagesExist(sqlite3) {
+    DEFINES += HAVE_SQLITE
+    PKGCONFIG += sqlite3
+    HEADERS += catalog.h timeline.h
+    SOURCES += catalog.cpp timeline.cpp
+}
+
 FORMS += avrecorder.ui
 
 #target.path = /Users/jmakoske/bin/mrecorder
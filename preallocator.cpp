@@ -0,0 +1,131 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDebug>
+#include <QFile>
+#include <QSettings>
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "preallocator.h"
+#include "metrics.h"
+
+// ---------------------------------------------------------------------
+
+Preallocator::Preallocator() : fd(-1), reserved(0), extent(extentBytes())
+{
+}
+
+// ---------------------------------------------------------------------
+
+Preallocator::~Preallocator() {
+    close();
+}
+
+// ---------------------------------------------------------------------
+
+// "storage/extent_mb" in the settings, 0 turns preallocation off
+qint64 Preallocator::extentBytes() {
+    QSettings settings;
+    return settings.value("storage/extent_mb", 64).toLongLong()*1024*1024;
+}
+
+// ---------------------------------------------------------------------
+
+bool Preallocator::open(const QString &fn) {
+    close();
+    filename = fn;
+    reserved = 0;
+#ifdef Q_OS_LINUX
+    if (extent <= 0)
+        return true;
+    fd = ::open(QFile::encodeName(fn).constData(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        qWarning() << "WARNING: Preallocator cannot open" << fn << ":"
+                   << strerror(errno);
+        return false;
+    }
+    return grow(0);
+#else
+    return true;
+#endif
+}
+
+// ---------------------------------------------------------------------
+
+bool Preallocator::grow(qint64 written) {
+#ifdef Q_OS_LINUX
+    if (fd < 0 || written+extent/2 < reserved)
+        return true;
+
+    qint64 target = (written/extent+2)*extent;
+    int ret = fallocate(fd, FALLOC_FL_KEEP_SIZE, reserved, target-reserved);
+    if (ret == 0) {
+        reserved = target;
+        return true;
+    }
+    if (errno == EOPNOTSUPP) {
+        // Not on this file system, just write without reserving:
+        ::close(fd);
+        fd = -1;
+        return true;
+    }
+    qWarning() << "WARNING: Preallocating" << filename << "failed:"
+               << strerror(errno);
+    Metrics::add("storage.prealloc_failures", 1);
+    return errno != ENOSPC;
+#else
+    Q_UNUSED(written);
+    return true;
+#endif
+}
+
+// ---------------------------------------------------------------------
+
+// Truncating to the current size releases the blocks reserved beyond
+// the end of the file.
+void Preallocator::close() {
+#ifdef Q_OS_LINUX
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && ftruncate(fd, st.st_size) != 0)
+        qWarning() << "WARNING: Trimming" << filename << "failed:"
+                   << strerror(errno);
+    ::close(fd);
+    fd = -1;
+#endif
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,68 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef PREALLOCATOR_H
+#define PREALLOCATOR_H
+
+#include <QString>
+
+/// Reserves disk space for a growing recording file in large extents,
+/// so that it does not fragment and a full disk shows up here rather
+/// than as a failed write.  The space is reserved beyond the end of
+/// the file (FALLOC_FL_KEEP_SIZE), so readers and a crash only ever
+/// see what has been written.  close() trims the unused reservation.
+///
+/// The file is opened separately from its writer, which also works
+/// for cv::VideoWriter.  Only does something on Linux.
+class Preallocator
+{
+public:
+    Preallocator();
+    ~Preallocator();
+
+    bool open(const QString &filename);
+
+    /// Called as the file grows, reserves the next extent when less
+    /// than half of the current one is left.  Returns false if the
+    /// disk is full.
+    bool grow(qint64 written);
+
+    /// After the writer has closed the file
+    void close();
+
+    static qint64 extentBytes();
+
+private:
+    int fd;
+    qint64 reserved;
+    qint64 extent;
+    QString filename;
+};
+
+#endif // PREALLOCATOR_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,186 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDebug>
+#include <QSettings>
+
+#include "preroll.h"
+#include "metrics.h"
+
+QAtomicInteger<qint64> PreRoll::used(0);
+QAtomicInt PreRoll::instances(0);
+
+// ---------------------------------------------------------------------
+
+PreRoll::PreRoll(const QString &st) : stream(st), length_ns(length()),
+                                      bytes(0), last_ns(0), holding(false),
+                                      published_ns(0)
+{
+    QSettings settings;
+    budget = qMax(1, settings.value("preroll/memory_mb", 256).toInt())
+        *1024LL*1024;
+    instances.ref();
+}
+
+// ---------------------------------------------------------------------
+
+PreRoll::~PreRoll() {
+    clear();
+    instances.deref();
+}
+
+// ---------------------------------------------------------------------
+
+qint64 PreRoll::length() {
+    QSettings settings;
+    return qMax(0, settings.value("preroll/seconds", 0).toInt())
+        *1000000000LL;
+}
+
+// ---------------------------------------------------------------------
+
+void PreRoll::release(const Entry &e) {
+    bytes -= e.data.size();
+    used.fetchAndAddOrdered(-e.data.size());
+}
+
+// ---------------------------------------------------------------------
+
+// Makes room for the new entry from the oldest end: first what is too
+// old, then what exceeds this buffer's share or the total.  An entry
+// that does not fit even in an empty buffer is dropped.
+void PreRoll::push(qint64 t_ns, qint64 index, int frames,
+                   const QByteArray &data) {
+    QMutexLocker locker(&mutex);
+    qint64 total = budget;
+    qint64 share = total/qMax(1, instances.load());
+    qint64 size = data.size();
+
+    while (!entries.isEmpty() && !holding &&
+           entries.head().t_ns < t_ns-length_ns)
+        release(entries.dequeue());
+    while (!entries.isEmpty() &&
+           (bytes+size > share || used.load()+size > total))
+        release(entries.dequeue());
+
+    if (bytes+size > share || used.load()+size > total) {
+        Metrics::add(stream+".preroll_dropped", 1);
+        return;
+    }
+
+    Entry e;
+    e.t_ns = t_ns;
+    e.index = index;
+    e.frames = frames;
+    e.data = data;
+    entries.enqueue(e);
+    bytes += size;
+    used.fetchAndAddOrdered(size);
+    last_ns = t_ns;
+
+    if (t_ns-published_ns >= 1000000000LL)
+        publish(t_ns);
+}
+
+// ---------------------------------------------------------------------
+
+void PreRoll::publish(qint64 now_ns) {
+    published_ns = now_ns;
+    Metrics::set("preroll.memory_kb", used.load()/1024);
+    Metrics::set(stream+".preroll_ms", entries.isEmpty() ? 0 :
+                 (last_ns-entries.head().t_ns)/1000000);
+}
+
+// ---------------------------------------------------------------------
+
+qint64 PreRoll::hold(qint64 now_ns) {
+    QMutexLocker locker(&mutex);
+    while (!entries.isEmpty() && entries.head().t_ns < now_ns-length_ns)
+        release(entries.dequeue());
+    holding = true;
+    return entries.isEmpty() ? -1 : entries.head().t_ns;
+}
+
+// ---------------------------------------------------------------------
+
+qint64 PreRoll::oldest() {
+    QMutexLocker locker(&mutex);
+    return entries.isEmpty() ? -1 : entries.head().t_ns;
+}
+
+// ---------------------------------------------------------------------
+
+bool PreRoll::take(qint64 from_ns, qint64 until_ns, Entry &entry) {
+    QMutexLocker locker(&mutex);
+    while (entries.size() >= 2 && entries.at(1).t_ns <= from_ns)
+        release(entries.dequeue());
+    if (entries.isEmpty() || entries.head().t_ns >= until_ns) {
+        holding = false;
+        return false;
+    }
+    entry = entries.dequeue();
+    release(entry);
+    Metrics::set("preroll.memory_kb", used.load()/1024);
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+int PreRoll::trim(qint64 from_ns, qint64 until_ns, qint64 &index,
+                  qint64 &t_ns) {
+    QMutexLocker locker(&mutex);
+    while (entries.size() >= 2 && entries.at(1).t_ns <= from_ns)
+        release(entries.dequeue());
+    int n = 0;
+    while (n < entries.size() && entries.at(n).t_ns < until_ns)
+        n++;
+    if (n) {
+        index = entries.head().index;
+        t_ns = entries.head().t_ns;
+    }
+    return n;
+}
+
+// ---------------------------------------------------------------------
+
+void PreRoll::clear() {
+    QMutexLocker locker(&mutex);
+    while (!entries.isEmpty())
+        release(entries.dequeue());
+    holding = false;
+    publish(last_ns);
+}
+
+// ---------------------------------------------------------------------
+
+bool PreRoll::isEmpty() {
+    QMutexLocker locker(&mutex);
+    return entries.isEmpty();
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
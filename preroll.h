@@ -0,0 +1,114 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef PREROLL_H
+#define PREROLL_H
+
+#include <QMutex>
+#include <QQueue>
+#include <QByteArray>
+#include <QString>
+#include <QAtomicInteger>
+
+/// The last seconds of a stream kept in memory while it is not
+/// recording, so that Record can start the files from before the
+/// click.  Cameras keep JPEG-compressed frames, audio the PCM periods.
+///
+/// "preroll/seconds" sets how far back (0, the default, disables
+/// pre-roll) and "preroll/memory_mb" the memory all buffers together
+/// may use.  Each buffer gets an equal share of it, and drops its
+/// oldest entries rather than grow past the share, so the total is
+/// strictly bounded.  preroll.memory_kb and <stream>.preroll_ms show
+/// the use.
+///
+/// The owner pushes, the writer takes; both may be different threads.
+class PreRoll
+{
+public:
+    struct Entry {
+        /// Master clock time of the first frame in the entry
+        qint64 t_ns;
+        /// Index of the first frame in the capture stream
+        qint64 index;
+        int frames;
+        QByteArray data;
+    };
+
+    PreRoll(const QString &stream);
+    ~PreRoll();
+
+    /// "preroll/seconds" in ns, 0 if pre-roll is disabled
+    static qint64 length();
+
+    void push(qint64 t_ns, qint64 index, int frames, const QByteArray &data);
+
+    /// Drops what is older than the pre-roll length from now, then
+    /// stops dropping by age until clear(), so that nothing more is
+    /// lost while the streams agree on a start
+    qint64 hold(qint64 now_ns);
+
+    /// Time of the oldest entry, -1 if empty
+    qint64 oldest();
+
+    /// Takes the oldest entry that starts before until_ns, first
+    /// dropping the entries that another one at or before from_ns
+    /// follows.  Returns false when there is no such entry, and then
+    /// resumes dropping by age.
+    bool take(qint64 from_ns, qint64 until_ns, Entry &entry);
+
+    /// Drops what take() would skip and counts the entries it will
+    /// return, with the index and time of the first
+    int trim(qint64 from_ns, qint64 until_ns, qint64 &index, qint64 &t_ns);
+
+    /// Empties the buffer and resumes dropping by age
+    void clear();
+
+    bool isEmpty();
+
+private:
+    void release(const Entry &);
+    void publish(qint64 now_ns);
+
+    QString stream;
+    qint64 length_ns;
+    /// "preroll/memory_mb" for all buffers together
+    qint64 budget;
+
+    QMutex mutex;
+    QQueue<Entry> entries;
+    qint64 bytes;
+    qint64 last_ns;
+    bool holding;
+    qint64 published_ns;
+
+    static QAtomicInteger<qint64> used;
+    static QAtomicInt instances;
+};
+
+#endif // PREROLL_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
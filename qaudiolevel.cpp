@@ -44,15 +44,33 @@
 QAudioLevel::QAudioLevel(QWidget *parent)
   : QWidget(parent)
   , m_level(0.0)
+  , m_rms(0.0)
+  , m_held(0.0)
 {
     setMinimumHeight(15);
     setMaximumHeight(50);
+    m_clock.start();
 }
 
 void QAudioLevel::setLevel(qreal level)
 {
-    if (m_level != level) {
+    m_peakHold.reset();
+    if (m_level != level || m_rms != 0.0 || m_held != 0.0) {
         m_level = level;
+        m_rms = 0.0;
+        m_held = 0.0;
+        update();
+    }
+}
+
+void QAudioLevel::setLevels(qreal peak, qreal rms)
+{
+    m_peakHold.update(peak, rms, m_clock.elapsed()/1000.0);
+    if (m_level != m_peakHold.level() || m_rms != m_peakHold.rms() ||
+        m_held != m_peakHold.held()) {
+        m_level = m_peakHold.level();
+        m_rms = m_peakHold.rms();
+        m_held = m_peakHold.held();
         update();
     }
 }
@@ -67,4 +85,10 @@ void QAudioLevel::paintEvent(QPaintEvent *event)
     painter.fillRect(0, 0, widthLevel, height(), Qt::red);
     // clear the rest of the control
     painter.fillRect(widthLevel, 0, width(), height(), Qt::black);
+    // RMS level inside the peak bar
+    qreal widthRms = m_rms * width();
+    painter.fillRect(0, height()/4, widthRms, height()/2, Qt::darkRed);
+    // held peak
+    if (m_held > 0.0)
+        painter.fillRect(m_held * width() - 2, 0, 2, height(), Qt::white);
 }
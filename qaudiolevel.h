@@ -42,6 +42,9 @@
 #define QAUDIOLEVEL_H
 
 #include <QWidget>
+#include <QElapsedTimer>
+
+#include "audiolevels.h"
 
 class QAudioLevel : public QWidget
 {
@@ -52,11 +55,19 @@ public:
     // Using [0; 1.0] range
     void setLevel(qreal level);
 
+    // Peak and RMS of the latest buffer, shown with peak-hold
+    void setLevels(qreal peak, qreal rms);
+
 protected:
     void paintEvent(QPaintEvent *event);
 
 private:
     qreal m_level;
+    qreal m_rms;
+    qreal m_held;
+
+    AudioLevels::PeakHold m_peakHold;
+    QElapsedTimer m_clock;
 };
 
 #endif // QAUDIOLEVEL_H
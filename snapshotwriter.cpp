@@ -0,0 +1,148 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSettings>
+#include <QThreadPool>
+
+#include <vector>
+
+#include "opencv2/highgui/highgui.hpp"
+
+#include "snapshotwriter.h"
+#include "annotationjournal.h"
+#include "masterclock.h"
+#include "metrics.h"
+
+QMutex SnapshotWriter::mutex;
+QThreadPool *SnapshotWriter::pool_ = NULL;
+int SnapshotWriter::max_pending = 8;
+QAtomicInt SnapshotWriter::pending(0);
+QAtomicPointer<AnnotationJournal> SnapshotWriter::journal(NULL);
+
+// ---------------------------------------------------------------------
+
+SnapshotWriter::SnapshotWriter(const cv::Mat &f, const QString &fn, int c)
+    : frame(f), filename(fn), camera(c)
+{
+    setAutoDelete(true);
+}
+
+// ---------------------------------------------------------------------
+
+// Created by the first snapshot, on whichever camera thread
+QThreadPool *SnapshotWriter::pool() {
+    QMutexLocker locker(&mutex);
+    if (!pool_) {
+        QSettings settings;
+        pool_ = new QThreadPool;
+        pool_->setMaxThreadCount(qMax(1, settings.value("snapshot/threads",
+                                                        2).toInt()));
+        max_pending = qMax(1, settings.value("snapshot/max_pending",
+                                             8).toInt());
+    }
+    return pool_;
+}
+
+// ---------------------------------------------------------------------
+
+bool SnapshotWriter::submit(const cv::Mat &frame, const QString &filename,
+                            int camera) {
+    QThreadPool *workers = pool();
+    if (frame.empty()) {
+        Metrics::add("snapshot.dropped", 1);
+        qWarning() << "WARNING: No frame for snapshot" << filename;
+        return false;
+    }
+    if (pending.fetchAndAddOrdered(1) >= max_pending) {
+        pending.deref();
+        Metrics::add("snapshot.dropped", 1);
+        qWarning() << "WARNING: Dropped snapshot" << filename;
+        return false;
+    }
+    workers->start(new SnapshotWriter(frame, filename, camera));
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+// Not under mutex, which waitForDone() holds while the workers finish
+void SnapshotWriter::setJournal(AnnotationJournal *j) {
+    journal.storeRelease(j);
+}
+
+// ---------------------------------------------------------------------
+
+void SnapshotWriter::waitForDone() {
+    QMutexLocker locker(&mutex);
+    if (pool_)
+        pool_->waitForDone();
+}
+
+// ---------------------------------------------------------------------
+
+// QSaveFile only replaces the file once it is complete, so a reader
+// never sees half a JPEG.
+void SnapshotWriter::run() {
+    qint64 t0 = MasterClock::nsecs();
+
+    QSettings settings;
+    std::vector<int> params;
+    params.push_back(CV_IMWRITE_JPEG_QUALITY);
+    params.push_back(settings.value("snapshot/jpeg_quality", 95).toInt());
+
+    std::vector<uchar> jpeg;
+    bool ok = cv::imencode(".jpg", frame, jpeg, params);
+    frame.release();
+
+    if (ok) {
+        QSaveFile file(filename);
+        ok = file.open(QIODevice::WriteOnly) &&
+            file.write(reinterpret_cast<const char*>(&jpeg[0]),
+                       jpeg.size()) == qint64(jpeg.size()) &&
+            file.commit();
+    }
+    pending.deref();
+
+    if (!ok) {
+        qWarning() << "WARNING: Failed to save snapshot" << filename;
+        Metrics::add("snapshot.failed", 1);
+        return;
+    }
+    Metrics::add("snapshot.saved", 1);
+    Metrics::set("snapshot.encode_ms", (MasterClock::nsecs()-t0)/1000000);
+
+    AnnotationJournal *j = journal.loadAcquire();
+    if (j)
+        j->addSnapshot(camera, QFileInfo(filename).fileName());
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,85 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef SNAPSHOTWRITER_H
+#define SNAPSHOTWRITER_H
+
+#include <QRunnable>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QMutex>
+#include <QString>
+
+#include "opencv2/core/core.hpp"
+
+class QThreadPool;
+class AnnotationJournal;
+
+/// Saves a full-resolution still of a camera for an annotation.
+///
+/// The camera thread hands over the last frame it captured and never
+/// touches it again, so nothing is compressed there.  JPEG compression
+/// ("snapshot/jpeg_quality", 95) and the write happen on a pool of
+/// "snapshot/threads" (2) workers.  At most "snapshot/max_pending" (8)
+/// stills wait for a worker, more are dropped and counted in
+/// snapshot.dropped.  Only a still that was written completely is
+/// linked in the journal.
+class SnapshotWriter : public QRunnable
+{
+public:
+    /// Returns false if the still was dropped
+    static bool submit(const cv::Mat &frame, const QString &filename,
+                       int camera);
+
+    /// Where the saved stills are linked, or NULL
+    static void setJournal(AnnotationJournal *);
+
+    /// Lets the queued stills be written, at exit
+    static void waitForDone();
+
+    void run();
+
+private:
+    SnapshotWriter(const cv::Mat &frame, const QString &filename,
+                   int camera);
+
+    static QThreadPool *pool();
+
+    cv::Mat frame;
+    QString filename;
+    int camera;
+
+    static QMutex mutex;
+    static QThreadPool *pool_;
+    static int max_pending;
+    static QAtomicInt pending;
+    static QAtomicPointer<AnnotationJournal> journal;
+};
+
+#endif // SNAPSHOTWRITER_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
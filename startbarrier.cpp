@@ -0,0 +1,210 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDebug>
+#include <QTextStream>
+
+#include "startbarrier.h"
+#include "masterclock.h"
+
+// ---------------------------------------------------------------------
+
+StartBarrier::StartBarrier() : armed(false), armed_ns(0), start_ns(-1),
+                               from_ns(-1),
+                               lead_ns(100*1000000LL),
+                               timeout_ns(3000*1000000LL)
+{
+}
+
+// ---------------------------------------------------------------------
+
+void StartBarrier::join(const QString &stream) {
+    QMutexLocker locker(&mutex);
+    streams.insert(stream);
+}
+
+// ---------------------------------------------------------------------
+
+void StartBarrier::leave(const QString &stream) {
+    QMutexLocker locker(&mutex);
+    streams.remove(stream);
+    waiting.remove(stream);
+    if (armed && start_ns < 0)
+        checkAllReady(MasterClock::nsecs());
+}
+
+// ---------------------------------------------------------------------
+
+void StartBarrier::arm(bool resume) {
+    QMutexLocker locker(&mutex);
+    armed = true;
+    armed_ns = MasterClock::nsecs();
+    start_ns = -1;
+    from_ns = -1;
+    waiting = streams;
+    joined_start.clear();
+    buffered.clear();
+    if (!resume)
+        runs.clear();
+    runs.append(Run());
+    runs.last().start_ns = -1;
+    qDebug() << "StartBarrier armed with" << waiting.size() << "streams";
+}
+
+// ---------------------------------------------------------------------
+
+void StartBarrier::disarm() {
+    QMutexLocker locker(&mutex);
+    armed = false;
+    waiting.clear();
+}
+
+// ---------------------------------------------------------------------
+
+bool StartBarrier::isArmed() {
+    QMutexLocker locker(&mutex);
+    return armed;
+}
+
+// ---------------------------------------------------------------------
+
+void StartBarrier::ready(const QString &stream) {
+    QMutexLocker locker(&mutex);
+    if (!armed)
+        return;
+    waiting.remove(stream);
+    joined_start.insert(stream);
+    checkAllReady(MasterClock::nsecs());
+}
+
+// ---------------------------------------------------------------------
+
+void StartBarrier::setBuffered(const QString &stream, qint64 oldest_ns) {
+    QMutexLocker locker(&mutex);
+    if (armed && oldest_ns >= 0)
+        buffered.insert(stream, oldest_ns);
+}
+
+// ---------------------------------------------------------------------
+
+void StartBarrier::withdraw(const QString &stream) {
+    QMutexLocker locker(&mutex);
+    if (!armed)
+        return;
+    waiting.remove(stream);
+    checkAllReady(MasterClock::nsecs());
+}
+
+// ---------------------------------------------------------------------
+
+qint64 StartBarrier::startTime() {
+    QMutexLocker locker(&mutex);
+    if (!armed)
+        return -1;
+    if (start_ns < 0) {
+        qint64 now = MasterClock::nsecs();
+        if (now - armed_ns > timeout_ns) {
+            qWarning() << "WARNING: StartBarrier timed out waiting for"
+                       << waiting.values();
+            waiting.clear();
+        }
+        checkAllReady(now);
+    }
+    return start_ns;
+}
+
+// ---------------------------------------------------------------------
+
+qint64 StartBarrier::recordFrom() {
+    startTime();
+    QMutexLocker locker(&mutex);
+    return armed ? from_ns : -1;
+}
+
+// ---------------------------------------------------------------------
+
+// A stream without pre-roll would start late, so pre-roll is used
+// only if all of them have one.
+void StartBarrier::checkAllReady(qint64 now) {
+    if (start_ns >= 0 || !waiting.isEmpty())
+        return;
+    start_ns = now + lead_ns;
+    from_ns = start_ns;
+    if (!runs.isEmpty())
+        runs.last().start_ns = start_ns;
+    bool all = !joined_start.isEmpty();
+    qint64 covered = 0;
+    foreach (const QString &stream, joined_start) {
+        if (!buffered.contains(stream)) {
+            all = false;
+            break;
+        }
+        covered = qMax(covered, buffered.value(stream));
+    }
+    if (all)
+        from_ns = qMin(covered, start_ns);
+    qDebug() << "StartBarrier: all streams ready after"
+             << (now-armed_ns)/1000000 << "ms, starting at" << start_ns
+             << "with" << (start_ns-from_ns)/1000000 << "ms pre-roll";
+}
+
+// ---------------------------------------------------------------------
+
+void StartBarrier::setStartIndex(const QString &stream, qint64 index,
+                                 qint64 ts_ns) {
+    QMutexLocker locker(&mutex);
+    if (runs.isEmpty())
+        return;
+    StartRecord r;
+    r.index = index;
+    r.ts_ns = ts_ns;
+    runs.last().started.insert(stream, r);
+    qDebug() << "StartBarrier:" << stream << "started at index" << index
+             << "offset" << (ts_ns-start_ns)/1000 << "us";
+}
+
+// ---------------------------------------------------------------------
+
+QString StartBarrier::report() {
+    QMutexLocker locker(&mutex);
+    QString ret;
+    QTextStream out(&ret);
+    out << "# stream index start_ns offset_us" << "\n";
+    foreach (const Run &run, runs) {
+        out << "master 0 " << run.start_ns << " 0" << "\n";
+        QMap<QString, StartRecord>::const_iterator it;
+        for (it = run.started.constBegin(); it != run.started.constEnd();
+             ++it)
+            out << it.key() << " " << it.value().index << " "
+                << it.value().ts_ns << " "
+                << (it.value().ts_ns-run.start_ns)/1000 << "\n";
+    }
+    return ret;
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
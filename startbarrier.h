@@ -0,0 +1,124 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef STARTBARRIER_H
+#define STARTBARRIER_H
+
+#include <QMutex>
+#include <QList>
+#include <QMap>
+#include <QSet>
+#include <QString>
+
+/// Armed-start barrier for synchronized recording.
+///
+/// Every stream (camera or audio) joins the barrier once.  When Record
+/// is pressed the barrier is armed, and each stream reports ready()
+/// after it has opened its writer.  Once all joined streams are ready
+/// (or the timeout has passed), a common start instant on the master
+/// clock is fixed slightly in the future.  Streams poll startTime()
+/// and begin writing with their first frame or sample at or after that
+/// instant, recording its index with setStartIndex().
+///
+/// Streams with a pre-roll (see PreRoll) report how far back their
+/// buffer reaches before ready().  If every ready stream has one, the
+/// recording begins at recordFrom(), the latest of these, which all
+/// of them cover.
+class StartBarrier
+{
+public:
+    StartBarrier();
+
+    void join(const QString &stream);
+    void leave(const QString &stream);
+
+    /// Called on the GUI thread when Record is pressed, or with
+    /// resume set when a paused recording continues.  A resume keeps
+    /// the start records of the earlier runs.
+    void arm(bool resume = false);
+    void disarm();
+    bool isArmed();
+
+    /// Stream has its writer open and is waiting for the start instant
+    void ready(const QString &stream);
+
+    /// Oldest frame in the stream's pre-roll, before ready()
+    void setBuffered(const QString &stream, qint64 oldest_ns);
+
+    /// Stream will not take part in the current start (e.g. inactive
+    /// camera)
+    void withdraw(const QString &stream);
+
+    /// Master clock start instant in ns, or -1 if not yet fixed
+    qint64 startTime();
+
+    /// Where the files begin: startTime(), or earlier with pre-roll
+    qint64 recordFrom();
+
+    /// Records the frame or sample index at which a stream started
+    void setStartIndex(const QString &stream, qint64 index, qint64 ts_ns);
+
+    /// Contents of sync.txt for the current recording, one block of
+    /// lines for each run after a pause
+    QString report();
+
+private:
+    void checkAllReady(qint64 now);
+
+    struct StartRecord {
+        qint64 index;
+        qint64 ts_ns;
+    };
+
+    struct Run {
+        qint64 start_ns;
+        QMap<QString, StartRecord> started;
+    };
+
+    QMutex mutex;
+
+    QSet<QString> streams;
+    QSet<QString> waiting;
+    QSet<QString> joined_start;
+    QMap<QString, qint64> buffered;
+    QList<Run> runs;
+
+    bool armed;
+    qint64 armed_ns;
+    qint64 start_ns;
+    qint64 from_ns;
+
+    /// How far in the future the start instant is placed
+    qint64 lead_ns;
+
+    /// Give up waiting for slow or broken streams after this
+    qint64 timeout_ns;
+};
+
+#endif // STARTBARRIER_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
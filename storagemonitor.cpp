@@ -0,0 +1,208 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDebug>
+#include <QMap>
+#include <QSettings>
+#include <QStorageInfo>
+
+#include "storagemonitor.h"
+#include "streamstats.h"
+#include "metrics.h"
+#include "volumes.h"
+
+// ---------------------------------------------------------------------
+
+StorageMonitor::StorageMonitor(QObject *parent)
+    : QThread(parent), active(false), stopping(false), warned(false),
+      stop_requested(false)
+{
+}
+
+// ---------------------------------------------------------------------
+
+void StorageMonitor::setDirectory(const QString &dir) {
+    QMutexLocker locker(&mutex);
+    directory = dir;
+}
+
+// ---------------------------------------------------------------------
+
+void StorageMonitor::setActive(bool on) {
+    QMutexLocker locker(&mutex);
+    active = on;
+    changed.wakeOne();
+}
+
+// ---------------------------------------------------------------------
+
+void StorageMonitor::breakLoop() {
+    QMutexLocker locker(&mutex);
+    stopping = true;
+    changed.wakeOne();
+}
+
+// ---------------------------------------------------------------------
+
+qint64 StorageMonitor::freeBytes(const QString &dir) {
+    QStorageInfo info(dir);
+    if (!info.isValid() || !info.isReady())
+        return -1;
+    return info.bytesAvailable();
+}
+
+// ---------------------------------------------------------------------
+
+qint64 StorageMonitor::expectedBitrate() {
+    QSettings settings;
+    return settings.value("storage/bitrate", 50000000).toLongLong();
+}
+
+// ---------------------------------------------------------------------
+
+void StorageMonitor::saveBitrate(qint64 bps) {
+    QSettings settings;
+    settings.setValue("storage/bitrate", bps);
+}
+
+// ---------------------------------------------------------------------
+
+qint64 StorageMonitor::minutesLeft(qint64 free, qint64 bps) {
+    QSettings settings;
+    qint64 reserve = settings.value("storage/reserve_mb", 256).toLongLong()
+        *1024*1024;
+    if (free < reserve)
+        return 0;
+    if (bps <= 0)
+        return -1;
+    return (free-reserve)*8/bps/60;
+}
+
+// ---------------------------------------------------------------------
+
+void StorageMonitor::check() {
+    mutex.lock();
+    QString meeting = directory;
+    mutex.unlock();
+    if (meeting.isEmpty())
+        return;
+
+    // Before the writers have measured a second, assume the last
+    // recording's rate:
+    qint64 total_bps = StreamStats::total().bitrate;
+    if (total_bps <= 0)
+        total_bps = expectedBitrate();
+
+    // Streams placed on other volumes count only there, the meeting
+    // directory gets the rest:
+    QMap<QString, StreamStats::Entry> stats = StreamStats::snapshot();
+    QMap<QString, qint64> volume_bps;
+    qint64 elsewhere = 0;
+    foreach (const QString &dir, Volumes::directories()) {
+        if (dir == meeting)
+            continue;
+        qint64 bps = 0;
+        foreach (const QString &stream, Volumes::streamsIn(dir))
+            bps += stats.value(stream).bitrate;
+        volume_bps[dir] = bps;
+        elsewhere += bps;
+    }
+    volume_bps[meeting] = qMax(total_bps-elsewhere, qint64(0));
+
+    QSettings settings;
+    qint64 reserve = settings.value("storage/reserve_mb", 256).toLongLong()
+        *1024*1024;
+    int warn_minutes = settings.value("storage/warn_minutes", 10).toInt();
+
+    // The volume that fills first decides:
+    QString dir;
+    qint64 free = -1, minutes = -1;
+    bool full = false;
+    QMap<QString, qint64>::const_iterator it;
+    for (it = volume_bps.constBegin(); it != volume_bps.constEnd(); ++it) {
+        qint64 f = freeBytes(it.key());
+        if (f < 0)
+            continue;
+        qint64 m = minutesLeft(f, it.value());
+        // Stop while the encoder queues and the file trailers still
+        // fit:
+        bool f_full = f < reserve+it.value()/8*30;
+        if (dir.isEmpty() || (f_full && !full) ||
+            (f_full == full && m >= 0 && (minutes < 0 || m < minutes))) {
+            dir = it.key();
+            free = f;
+            minutes = m;
+            full = f_full;
+        }
+    }
+    if (free < 0)
+        return;
+
+    Metrics::set("storage.free_mb", free/1024/1024);
+    Metrics::set("storage.minutes_left", minutes);
+
+    if (full) {
+        if (!stop_requested) {
+            qWarning() << "WARNING: Only" << free/1024/1024 << "MB left on"
+                       << dir << ", stopping the recording";
+            stop_requested = true;
+            emit outOfSpace();
+        }
+        return;
+    }
+
+    if (minutes >= 0 && minutes < warn_minutes) {
+        if (!warned) {
+            qWarning() << "WARNING: About" << minutes
+                       << "minutes of disk space left on" << dir;
+            warned = true;
+            emit lowSpace(int(minutes));
+        }
+    } else
+        warned = false;
+}
+
+// ---------------------------------------------------------------------
+
+void StorageMonitor::run() {
+    QMutexLocker locker(&mutex);
+    while (!stopping) {
+        if (!active) {
+            warned = stop_requested = false;
+            changed.wait(&mutex);
+            continue;
+        }
+        locker.unlock();
+        check();
+        locker.relock();
+        if (!stopping)
+            changed.wait(&mutex, 2000);
+    }
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,92 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef STORAGEMONITOR_H
+#define STORAGEMONITOR_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+
+/// Watches the free space of the meeting directory, and of the volumes
+/// streams are placed on (see Volumes), while recording.
+/// The time left is forecast from the bitrate the writers publish in
+/// StreamStats.  lowSpace() is emitted when less than
+/// "storage/warn_minutes" remain, and outOfSpace() while there is
+/// still "storage/reserve_mb" plus half a minute of data left, so that
+/// recording can stop and every file be finalized before the disk is
+/// full.  Each volume is forecast with the bitrate of its own streams
+/// and the one that fills first decides.
+class StorageMonitor : public QThread
+{
+    Q_OBJECT
+
+public:
+    StorageMonitor(QObject *parent = 0);
+
+    void setDirectory(const QString &dir);
+
+    /// Checks only while recording
+    void setActive(bool);
+
+    void breakLoop();
+
+    /// Free bytes on the file system of a directory, -1 if unknown
+    static qint64 freeBytes(const QString &dir);
+
+    /// Bits per second of the last recording, or a guess for two
+    /// cameras before the first one
+    static qint64 expectedBitrate();
+    static void saveBitrate(qint64 bits_per_second);
+
+    /// Minutes of recording that fit in the free space, leaving the
+    /// reserve
+    static qint64 minutesLeft(qint64 free, qint64 bits_per_second);
+
+signals:
+    void lowSpace(int minutes_left);
+    void outOfSpace();
+
+private:
+    void run();
+    void check();
+
+    QMutex mutex;
+    QWaitCondition changed;
+    QString directory;
+    bool active;
+    bool stopping;
+
+    /// Only touched on the monitor thread
+    bool warned;
+    bool stop_requested;
+};
+
+#endif // STORAGEMONITOR_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
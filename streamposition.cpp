@@ -0,0 +1,59 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "streamposition.h"
+
+QMutex StreamPosition::mutex;
+QMap<QString, StreamPosition::Position> StreamPosition::positions;
+
+// ---------------------------------------------------------------------
+
+void StreamPosition::set(const QString &stream, int segment, qint64 frame,
+                         qint64 t_ns) {
+    QMutexLocker locker(&mutex);
+    Position &p = positions[stream];
+    p.segment = segment;
+    p.frame = frame;
+    p.t_ns = t_ns;
+}
+
+// ---------------------------------------------------------------------
+
+QMap<QString, StreamPosition::Position> StreamPosition::snapshot() {
+    QMutexLocker locker(&mutex);
+    return positions;
+}
+
+// ---------------------------------------------------------------------
+
+void StreamPosition::clear() {
+    QMutexLocker locker(&mutex);
+    positions.clear();
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
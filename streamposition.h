@@ -0,0 +1,62 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef STREAMPOSITION_H
+#define STREAMPOSITION_H
+
+#include <QMutex>
+#include <QMap>
+#include <QString>
+
+/// Process-wide registry of where each recording stream is: the last
+/// frame written (a video frame or an audio sample frame), counted
+/// from the start of its file segment, and when it was captured on
+/// the master clock.  The writer threads update it for every frame,
+/// annotations read it.
+class StreamPosition
+{
+public:
+    struct Position {
+        Position() : segment(0), frame(-1), t_ns(0) {}
+        int segment;
+        qint64 frame;
+        qint64 t_ns;
+    };
+
+    static void set(const QString &stream, int segment, qint64 frame,
+                    qint64 t_ns);
+    static QMap<QString, Position> snapshot();
+    static void clear();
+
+private:
+    static QMutex mutex;
+    static QMap<QString, Position> positions;
+};
+
+#endif // STREAMPOSITION_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
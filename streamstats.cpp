@@ -0,0 +1,97 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "streamstats.h"
+#include "masterclock.h"
+
+QMutex StreamStats::mutex;
+QMap<QString, StreamStats::Entry> StreamStats::entries;
+
+// ---------------------------------------------------------------------
+
+void StreamStats::addFile(const QString &stream) {
+    QMutexLocker locker(&mutex);
+    entries[stream].files++;
+}
+
+// ---------------------------------------------------------------------
+
+void StreamStats::update(const QString &stream, qint64 bytes,
+                         qint64 frames) {
+    qint64 now = MasterClock::nsecs();
+    QMutexLocker locker(&mutex);
+    Entry &e = entries[stream];
+    e.bytes = bytes;
+    e.frames = frames;
+
+    if (e.mark_ns == 0) {
+        e.mark_bytes = bytes;
+        e.mark_ns = now;
+    } else if (now-e.mark_ns >= 1000000000LL) {
+        e.bitrate = (bytes-e.mark_bytes)*8000000000LL/(now-e.mark_ns);
+        e.mark_bytes = bytes;
+        e.mark_ns = now;
+    }
+}
+
+// ---------------------------------------------------------------------
+
+StreamStats::Entry StreamStats::value(const QString &stream) {
+    QMutexLocker locker(&mutex);
+    return entries.value(stream);
+}
+
+// ---------------------------------------------------------------------
+
+QMap<QString, StreamStats::Entry> StreamStats::snapshot() {
+    QMutexLocker locker(&mutex);
+    return entries;
+}
+
+// ---------------------------------------------------------------------
+
+StreamStats::Entry StreamStats::total() {
+    QMutexLocker locker(&mutex);
+    Entry sum;
+    foreach (const Entry &e, entries) {
+        sum.bytes += e.bytes;
+        sum.frames += e.frames;
+        sum.bitrate += e.bitrate;
+        sum.files += e.files;
+    }
+    return sum;
+}
+
+// ---------------------------------------------------------------------
+
+void StreamStats::clear() {
+    QMutexLocker locker(&mutex);
+    entries.clear();
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
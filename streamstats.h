@@ -0,0 +1,77 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef STREAMSTATS_H
+#define STREAMSTATS_H
+
+#include <QMutex>
+#include <QMap>
+#include <QString>
+
+/// Process-wide registry of what each writer has put on disk.  The
+/// writer threads publish their own running totals, so the status bar
+/// and the upload dialog never need to look at the files.
+class StreamStats
+{
+public:
+    struct Entry {
+        Entry() : bytes(0), frames(0), bitrate(0), files(0), mark_bytes(0),
+                  mark_ns(0) {}
+        /// Totals over all files (segments) of the stream
+        qint64 bytes;
+        qint64 frames;
+        /// Bits per second over about the last second
+        qint64 bitrate;
+        int files;
+
+        qint64 mark_bytes;
+        qint64 mark_ns;
+    };
+
+    /// A writer opened a new file for the stream
+    static void addFile(const QString &stream);
+
+    /// Running totals of a stream, called by its writer thread
+    static void update(const QString &stream, qint64 bytes, qint64 frames);
+
+    static Entry value(const QString &stream);
+    static QMap<QString, Entry> snapshot();
+
+    /// Sum over all streams
+    static Entry total();
+
+    /// Forget everything, when a new recording starts
+    static void clear();
+
+private:
+    static QMutex mutex;
+    static QMap<QString, Entry> entries;
+};
+
+#endif // STREAMSTATS_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,204 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QSettings>
+#include <QTextStream>
+
+#include "opencv2/highgui/highgui.hpp"
+
+#include "thumbnailatlas.h"
+#include "masterclock.h"
+#include "metrics.h"
+
+namespace {
+    const int max_items = 16;
+}
+
+// ---------------------------------------------------------------------
+
+ThumbnailAtlas::ThumbnailAtlas(const QString &st)
+    : stream(st), last_ns(-1), stopping(false), atlas_number(-1), tiles(0)
+{
+    QSettings settings;
+    interval_ns = qint64(settings.value("thumbnails/seconds", 10)
+                         .toDouble()*1e9);
+    columns = qMax(1, settings.value("thumbnails/columns", 8).toInt());
+    rows = qMax(1, settings.value("thumbnails/rows", 8).toInt());
+    jpeg_params.push_back(CV_IMWRITE_JPEG_QUALITY);
+    jpeg_params.push_back(settings.value("thumbnails/jpeg_quality",
+                                         80).toInt());
+}
+
+// ---------------------------------------------------------------------
+
+bool ThumbnailAtlas::due(qint64 t_ns) const {
+    return interval_ns > 0 && (last_ns < 0 || t_ns-last_ns >= interval_ns);
+}
+
+// ---------------------------------------------------------------------
+
+void ThumbnailAtlas::begin(const QString &d) {
+    last_ns = -1;
+    Item item;
+    item.t_ns = 0;
+    item.segment = 0;
+    item.frame = 0;
+    item.dir = d;
+
+    QMutexLocker locker(&mutex);
+    items.enqueue(item);
+    queued.wakeOne();
+}
+
+// ---------------------------------------------------------------------
+
+// The preview is redrawn for the next frame, so it is copied here.
+// That is a few tens of kilobytes every few seconds.
+void ThumbnailAtlas::add(const cv::Mat &image, qint64 t_ns, int segment,
+                         qint64 frame) {
+    last_ns = t_ns;
+    {
+        QMutexLocker locker(&mutex);
+        if (items.size() >= max_items) {
+            locker.unlock();
+            Metrics::add(stream+".thumbnails_dropped", 1);
+            return;
+        }
+    }
+
+    Item item;
+    item.image = image.clone();
+    item.t_ns = t_ns;
+    item.segment = segment;
+    item.frame = frame;
+
+    QMutexLocker locker(&mutex);
+    items.enqueue(item);
+    queued.wakeOne();
+}
+
+// ---------------------------------------------------------------------
+
+void ThumbnailAtlas::breakLoop() {
+    QMutexLocker locker(&mutex);
+    stopping = true;
+    queued.wakeOne();
+}
+
+// ---------------------------------------------------------------------
+
+// A new atlas is started when the last one is full, and when the
+// preview size changes.
+void ThumbnailAtlas::addTile(const Item &item) {
+    qint64 t0 = MasterClock::nsecs();
+    int w = item.image.cols, h = item.image.rows;
+    if (atlas.empty() || tiles == columns*rows ||
+        atlas.cols != w*columns || atlas.rows != h*rows) {
+        atlas = cv::Mat::zeros(h*rows, w*columns, item.image.type());
+        atlas_number++;
+        tiles = 0;
+    }
+    cv::Rect tile((tiles%columns)*w, (tiles/columns)*h, w, h);
+    item.image.copyTo(atlas(tile));
+    tiles++;
+
+    if (!saveAtlas())
+        return;
+
+    QFile index(QDir(dir).filePath(stream+"-thumbs.txt"));
+    if (!index.open(QIODevice::WriteOnly | QIODevice::Append |
+                    QIODevice::Text)) {
+        qWarning() << "WARNING: Failed to open" << index.fileName();
+        return;
+    }
+    QTextStream out(&index);
+    if (index.size() == 0)
+        out << "# master_ns wallclock atlas x y width height segment frame\n";
+    QDateTime wall = QDateTime::fromMSecsSinceEpoch(
+        MasterClock::toMSecsSinceEpoch(item.t_ns));
+    out << item.t_ns << " " << wall.toString("yyyy-MM-dd'T'hh:mm:ss.zzz")
+        << " " << QString("%1-thumbs-%2.jpg").arg(stream).arg(atlas_number)
+        << " " << tile.x << " " << tile.y << " " << w << " " << h << " "
+        << item.segment << " " << item.frame << "\n";
+    index.close();
+
+    Metrics::add(stream+".thumbnails", 1);
+    Metrics::set(stream+".atlas_ms", (MasterClock::nsecs()-t0)/1000000);
+}
+
+// ---------------------------------------------------------------------
+
+// QSaveFile replaces the atlas only once the new one is complete, so
+// a viewer always finds a whole image.
+bool ThumbnailAtlas::saveAtlas() {
+    QString filename = QDir(dir).filePath(QString("%1-thumbs-%2.jpg")
+                                          .arg(stream).arg(atlas_number));
+    std::vector<uchar> jpeg;
+    bool ok = cv::imencode(".jpg", atlas, jpeg, jpeg_params);
+    if (ok) {
+        QSaveFile file(filename);
+        ok = file.open(QIODevice::WriteOnly) &&
+            file.write(reinterpret_cast<const char*>(&jpeg[0]),
+                       jpeg.size()) == qint64(jpeg.size()) &&
+            file.commit();
+    }
+    if (!ok)
+        qWarning() << "WARNING: Failed to save" << filename;
+    return ok;
+}
+
+// ---------------------------------------------------------------------
+
+void ThumbnailAtlas::run() {
+    for (;;) {
+        mutex.lock();
+        while (items.isEmpty() && !stopping)
+            queued.wait(&mutex);
+        if (items.isEmpty()) {
+            mutex.unlock();
+            break;
+        }
+        Item item = items.dequeue();
+        mutex.unlock();
+
+        if (item.image.empty()) {
+            dir = item.dir;
+            atlas.release();
+            atlas_number = -1;
+            tiles = 0;
+        } else if (!dir.isEmpty())
+            addTile(item);
+    }
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,110 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef THUMBNAILATLAS_H
+#define THUMBNAILATLAS_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QString>
+
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+/// A contact sheet of a camera's recording, kept up to date while
+/// recording so that it is complete as soon as the recording stops.
+///
+/// Every "thumbnails/seconds" (10, 0 for none) the camera thread hands
+/// over its preview image.  A worker thread of the lowest priority
+/// tiles these "thumbnails/columns" (8) by "thumbnails/rows" (8) into
+/// <stream>-thumbs-<n>.jpg in the meeting directory, and lists them in
+/// <stream>-thumbs.txt, one line per thumbnail:
+///
+///   master_ns wallclock atlas x y width height segment frame
+///
+/// The atlas being filled is saved again with each new thumbnail, and
+/// its line is added once it is saved.  At most 16 thumbnails wait
+/// for the worker, more are dropped and counted in
+/// <stream>.thumbnails_dropped.
+class ThumbnailAtlas : public QThread
+{
+    Q_OBJECT
+
+public:
+    ThumbnailAtlas(const QString &stream);
+
+    /// Whether a thumbnail is due at t_ns, for the camera thread
+    bool due(qint64 t_ns) const;
+
+    /// Starts the contact sheet of a recording in dir
+    void begin(const QString &dir);
+
+    /// Queues a thumbnail of frame number frame in a segment
+    void add(const cv::Mat &image, qint64 t_ns, int segment, qint64 frame);
+
+    /// Writes what is queued and exits
+    void breakLoop();
+
+private:
+    struct Item {
+        cv::Mat image;
+        qint64 t_ns;
+        int segment;
+        qint64 frame;
+        QString dir;
+    };
+
+    void run();
+
+    void addTile(const Item &);
+    bool saveAtlas();
+
+    QString stream;
+    qint64 interval_ns;
+    int columns, rows;
+    std::vector<int> jpeg_params;
+
+    /// Only touched on the camera thread
+    qint64 last_ns;
+
+    QMutex mutex;
+    QWaitCondition queued;
+    QQueue<Item> items;
+    bool stopping;
+
+    /// Only touched on the worker thread
+    QString dir;
+    cv::Mat atlas;
+    int atlas_number, tiles;
+};
+
+#endif // THUMBNAILATLAS_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,425 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <limits>
+
+#include <ctype.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "timeline.h"
+#include "voiceactivity.h"
+#include "meetingdir.h"
+
+const int64_t Timeline::Open = std::numeric_limits<int64_t>::max();
+
+namespace {
+
+    bool startsBefore(const Timeline::Interval &a,
+                      const Timeline::Interval &b) {
+        return a.start < b.start;
+    }
+
+    bool endsWith(const std::string &s, const std::string &suffix) {
+        return s.size() >= suffix.size() &&
+            s.compare(s.size()-suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    /// Epoch milliseconds at master clock zero, from the first line of
+    /// manifest.txt or annotations.txt, which both start with
+    /// "master_ns wallclock".  Returns false if neither has one.
+    bool masterOffset(const std::string &dir, int64_t &offset) {
+        const char *files[] = { "/manifest.txt", "/annotations.txt" };
+        for (int i = 0; i < 2; i++) {
+            std::ifstream in((dir+files[i]).c_str());
+            std::string line;
+            while (std::getline(in, line)) {
+                if (line.empty() || line[0] == '#')
+                    continue;
+                std::istringstream fields(line);
+                long long ns;
+                std::string wall;
+                if (!(fields >> ns >> wall))
+                    break;
+                int64_t t = Timeline::parseTime(wall);
+                if (t < 0)
+                    break;
+                offset = t-ns/1000000;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Start of a stream on the master clock from sync.txt
+    bool syncStart(const std::string &dir, const std::string &stream,
+                   int64_t &ns) {
+        std::ifstream in((dir+"/sync.txt").c_str());
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string name;
+            long long index, ts;
+            if (fields >> name >> index >> ts && name == stream) {
+                ns = ts;
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+// ---------------------------------------------------------------------
+
+int64_t Timeline::parseTime(const std::string &s) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    int n = 0;
+    if (sscanf(s.c_str(), "%d-%d-%dT%d:%d:%d%n", &tm.tm_year, &tm.tm_mon,
+               &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &n) < 6)
+        return -1;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+
+    std::string rest = s.substr(n);
+    int ms = 0;
+    if (!rest.empty() && rest[0] == '.') {
+        size_t i = 1, scale = 100;
+        for (; i < rest.size() && isdigit(rest[i]); i++, scale /= 10)
+            ms += (rest[i]-'0')*scale;
+        rest = rest.substr(i);
+    }
+
+    int zone_s = 0;
+    bool zone = true;
+    if (rest == "EET")
+        zone_s = 2*3600;
+    else if (rest == "EEST")
+        zone_s = 3*3600;
+    else if (rest == "UTC" || rest == "GMT" || rest == "Z")
+        zone_s = 0;
+    else if (rest.size() == 5 && (rest[0] == '+' || rest[0] == '-')) {
+        int hhmm = atoi(rest.c_str()+1);
+        zone_s = (hhmm/100*3600+hhmm%100*60)*(rest[0] == '-' ? -1 : 1);
+    } else
+        zone = false;
+
+    time_t t;
+    if (zone)
+        t = timegm(&tm)-zone_s;
+    else {
+        tm.tm_isdst = -1;
+        t = mktime(&tm);
+    }
+    if (t == (time_t)-1)
+        return -1;
+    return int64_t(t)*1000+ms;
+}
+
+// ---------------------------------------------------------------------
+
+void Timeline::addState(const std::string &track, int64_t t, int value) {
+    Interval i = { t, Open, value };
+    tracks_[track].push_back(i);
+}
+
+// ---------------------------------------------------------------------
+
+// master_ns wallclock type value [positions ...]
+void Timeline::readAnnotations(const std::string &filename) {
+    std::ifstream in(filename.c_str());
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        long long ns;
+        std::string wall, type;
+        int value;
+        if (!(fields >> ns >> wall >> type >> value))
+            continue;
+        int64_t t = parseTime(wall);
+        if (t < 0)
+            continue;
+        if (type == "event") {
+            Interval i = { t, t, value };
+            tracks_["event"].push_back(i);
+        } else if (type == "status" || type == "pose")
+            addState(type, t, value);
+        // snapshot lines link stills, they are no annotation
+    }
+}
+
+// ---------------------------------------------------------------------
+
+// value yyyy-MM-ddThh:mm:ss<zone>, one file per type
+void Timeline::readLegacy(const std::string &filename,
+                          const std::string &track) {
+    std::ifstream in(filename.c_str());
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        int value;
+        std::string when;
+        if (!(fields >> value >> when))
+            continue;
+        int64_t t = parseTime(when);
+        if (t < 0)
+            continue;
+        if (track == "event") {
+            Interval i = { t, t, value };
+            tracks_[track].push_back(i);
+        } else
+            addState(track, t, value);
+    }
+}
+
+// ---------------------------------------------------------------------
+
+// The indexes are relative to the start of their stream.  The start
+// comes from sync.txt and the master clock, or from starttime.txt in
+// recordings without a master clock.  The indexes of streams placed
+// on other volumes are next to their audio files there.
+void Timeline::readSpeech(const std::string &dir) {
+    int64_t offset = 0;
+    bool have_offset = masterOffset(dir, offset);
+    int64_t fallback = -1;
+    std::ifstream timefile((dir+"/starttime.txt").c_str());
+    std::string timestring;
+    if (std::getline(timefile, timestring))
+        fallback = parseTime(timestring);
+
+    std::vector<std::string> dirs = MeetingDir::directories(dir);
+    for (size_t v = 0; v < dirs.size(); v++) {
+        DIR *d = opendir(dirs[v].c_str());
+        if (!d)
+            continue;
+
+        struct dirent *e;
+        while ((e = readdir(d)) != NULL) {
+            std::string name(e->d_name);
+            if (!endsWith(name, "-vad.txt"))
+                continue;
+            std::string stream = name.substr(0, name.size()-8);
+
+            int64_t ns, base = fallback;
+            if (have_offset && syncStart(dir, stream, ns))
+                base = offset+ns/1000000;
+            if (base < 0)
+                continue;
+
+            std::vector<VoiceActivity::Segment> segments;
+            if (!VoiceActivity::readIndex(dirs[v]+"/"+name, segments, 1000))
+                continue;
+            std::vector<Interval> &track = tracks_["speech."+stream];
+            for (size_t i = 0; i < segments.size(); i++) {
+                Interval iv = { base+segments[i].start, base+segments[i].end,
+                                int(segments[i].level_db) };
+                track.push_back(iv);
+            }
+        }
+        closedir(d);
+    }
+}
+
+// ---------------------------------------------------------------------
+
+// Sorts the tracks and closes each state at the next change.  A state
+// replaced within the same millisecond is dropped.
+void Timeline::finish() {
+    std::map<std::string, std::vector<Interval> >::iterator it;
+    for (it = tracks_.begin(); it != tracks_.end(); ++it) {
+        std::vector<Interval> &v = it->second;
+        std::stable_sort(v.begin(), v.end(), startsBefore);
+
+        std::vector<Interval> out;
+        for (size_t i = 0; i < v.size(); i++) {
+            Interval iv = v[i];
+            if (iv.end == Open && i+1 < v.size()) {
+                iv.end = v[i+1].start;
+                if (iv.end == iv.start)
+                    continue;
+            }
+            out.push_back(iv);
+        }
+        v.swap(out);
+    }
+}
+
+// ---------------------------------------------------------------------
+
+bool Timeline::compile(const std::string &where) {
+    tracks_.clear();
+
+    // Also accepts a volume directory of the meeting:
+    std::string dir = MeetingDir::meetingOf(where);
+
+    readAnnotations(dir+"/annotations.txt");
+    readLegacy(dir+"/status.txt", "status");
+    readLegacy(dir+"/pose.txt", "pose");
+    readLegacy(dir+"/events.txt", "event");
+    readSpeech(dir);
+    finish();
+
+    if (tracks_.empty()) {
+        error = "no annotations or voice activity found in "+dir;
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+bool Timeline::save(const std::string &filename) const {
+    std::ofstream out(filename.c_str());
+    if (!out)
+        return false;
+    out << "# track value start_ms end_ms" << std::endl;
+    std::map<std::string, std::vector<Interval> >::const_iterator it;
+    for (it = tracks_.begin(); it != tracks_.end(); ++it)
+        for (size_t i = 0; i < it->second.size(); i++) {
+            const Interval &iv = it->second[i];
+            out << it->first << " " << iv.value << " " << iv.start << " "
+                << (iv.end == Open ? -1 : iv.end) << "\n";
+        }
+    return bool(out);
+}
+
+// ---------------------------------------------------------------------
+
+bool Timeline::load(const std::string &filename) {
+    tracks_.clear();
+    std::ifstream in(filename.c_str());
+    if (!in) {
+        error = "cannot read "+filename;
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        std::string track;
+        long long start, end;
+        int value;
+        if (!(fields >> track >> value >> start >> end))
+            continue;
+        Interval iv = { start, end < 0 ? Open : end, value };
+        tracks_[track].push_back(iv);
+    }
+    // Written sorted, but a hand-edited file may not be:
+    std::map<std::string, std::vector<Interval> >::iterator it;
+    for (it = tracks_.begin(); it != tracks_.end(); ++it)
+        std::stable_sort(it->second.begin(), it->second.end(), startsBefore);
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+std::vector<std::string> Timeline::tracks() const {
+    std::vector<std::string> ret;
+    std::map<std::string, std::vector<Interval> >::const_iterator it;
+    for (it = tracks_.begin(); it != tracks_.end(); ++it)
+        ret.push_back(it->first);
+    return ret;
+}
+
+// ---------------------------------------------------------------------
+
+int64_t Timeline::start() const {
+    int64_t t = Open;
+    std::map<std::string, std::vector<Interval> >::const_iterator it;
+    for (it = tracks_.begin(); it != tracks_.end(); ++it)
+        if (!it->second.empty())
+            t = std::min(t, it->second.front().start);
+    return t == Open ? 0 : t;
+}
+
+// ---------------------------------------------------------------------
+
+int64_t Timeline::end() const {
+    int64_t t = 0;
+    std::map<std::string, std::vector<Interval> >::const_iterator it;
+    for (it = tracks_.begin(); it != tracks_.end(); ++it)
+        if (!it->second.empty()) {
+            const Interval &last = it->second.back();
+            t = std::max(t, last.end == Open ? last.start : last.end);
+        }
+    return t;
+}
+
+// ---------------------------------------------------------------------
+
+const Timeline::Interval *Timeline::at(const std::string &track,
+                                       int64_t t) const {
+    std::map<std::string, std::vector<Interval> >::const_iterator it =
+        tracks_.find(track);
+    if (it == tracks_.end())
+        return NULL;
+    const std::vector<Interval> &v = it->second;
+
+    // Last interval starting at or before t:
+    Interval key = { t, t, 0 };
+    std::vector<Interval>::const_iterator i =
+        std::upper_bound(v.begin(), v.end(), key, startsBefore);
+    if (i == v.begin())
+        return NULL;
+    --i;
+    if (t < i->end || (i->start == i->end && t == i->start))
+        return &*i;
+    return NULL;
+}
+
+// ---------------------------------------------------------------------
+
+void Timeline::between(const std::string &track, int64_t t0, int64_t t1,
+                       std::vector<Interval> &out) const {
+    std::map<std::string, std::vector<Interval> >::const_iterator it =
+        tracks_.find(track);
+    if (it == tracks_.end())
+        return;
+    const std::vector<Interval> &v = it->second;
+
+    // The intervals do not overlap, so only the one before the first
+    // start in the range can reach into it:
+    Interval key = { t0, t0, 0 };
+    std::vector<Interval>::const_iterator i =
+        std::lower_bound(v.begin(), v.end(), key, startsBefore);
+    if (i != v.begin() && (i-1)->end > t0)
+        --i;
+    for (; i != v.end() && i->start <= t1; ++i)
+        out.push_back(*i);
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,111 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+// Plain C++ so that the tools can use this without Qt.
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/// All annotations of a meeting on one time axis, as intervals.
+///
+/// compile() reads a meeting directory: annotations.txt, or the
+/// status.txt, pose.txt and events.txt of older recordings, and the
+/// voice activity indexes <stream>-vad.txt, also from the volumes the
+/// streams were placed on (see MeetingDir).  Each of these becomes a
+/// track of intervals sorted by start time:
+///
+///   status, pose      the value is active until the next change
+///   event             instants, start == end
+///   speech.<stream>   speech segments, the value is the level in dB
+///
+/// Times are milliseconds since the epoch.  Intervals of a track do
+/// not overlap, so the interval at a time and the intervals in a
+/// range are both found by binary search.
+///
+/// The compiled file, timeline.txt, has a comment line and then one
+/// interval per line, grouped by track:
+///
+///   track value start_ms end_ms
+///
+/// where end_ms is -1 for a state still active at the end.
+class Timeline
+{
+public:
+    struct Interval {
+        int64_t start;
+        /// Exclusive, except for instants.  Open intervals end at
+        /// Timeline::Open.
+        int64_t end;
+        int value;
+    };
+
+    static const int64_t Open;
+
+    bool compile(const std::string &dir);
+    bool load(const std::string &filename);
+    bool save(const std::string &filename) const;
+
+    std::vector<std::string> tracks() const;
+    bool empty() const { return tracks_.empty(); }
+
+    /// First and last instant with anything on the timeline
+    int64_t start() const;
+    int64_t end() const;
+
+    /// The interval active at time t, NULL if none
+    const Interval *at(const std::string &track, int64_t t) const;
+
+    /// Intervals that overlap [t0, t1], in time order
+    void between(const std::string &track, int64_t t0, int64_t t1,
+                 std::vector<Interval> &out) const;
+
+    std::string errorString() const { return error; }
+
+    /// Milliseconds since the epoch from yyyy-MM-ddThh:mm:ss[.zzz],
+    /// optionally followed by a zone: EET, EEST, UTC or +hhmm.
+    /// Without a zone the time is local.  Returns -1 on error.
+    static int64_t parseTime(const std::string &s);
+
+private:
+    void readAnnotations(const std::string &filename);
+    void readLegacy(const std::string &filename, const std::string &track);
+    void readSpeech(const std::string &dir);
+    void addState(const std::string &track, int64_t t, int value);
+    void finish();
+
+    std::map<std::string, std::vector<Interval> > tracks_;
+    std::string error;
+};
+
+#endif // TIMELINE_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
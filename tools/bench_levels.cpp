@@ -0,0 +1,194 @@
+/*
+Copyright (c) 2015-2016 University of Helsinki
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// Micro-benchmark of the audio level kernels in ../audiolevels.cpp
+// against the per-sample template that AvRecorder used before.
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <climits>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "audiolevels.h"
+
+using namespace std;
+using namespace boost::posix_time;
+
+// ----------------------------------------------------------------------
+
+void help(char** av) {
+  cout << "Usage:" << endl << av[0] 
+       << " [options]"
+       << endl << endl
+       << "Options:" << endl
+       << "  [--frames=X]           : "
+       << "sample frames per buffer, default is 4800" << endl
+       << "  [--channels=X]         : "
+       << "interleaved channels, default is 8" << endl
+       << "  [--rounds=X]           : "
+       << "buffers to process per measurement, default is 2000" << endl;
+}
+
+// ----------------------------------------------------------------------
+
+// The old getBufferLevels<T>() from avrecorder.cpp
+template <class T>
+vector<double> legacy_levels(const T *buffer, int frames, int channels) {
+  vector<double> max_values(channels, 0.0);
+
+  for (int i = 0; i < frames; ++i) {
+    for (int j = 0; j < channels; ++j) {
+      double value = fabs(double(buffer[i * channels + j]));
+      if (value > max_values.at(j))
+	max_values[j] = value;
+    }
+  }
+
+  return max_values;
+}
+
+// ----------------------------------------------------------------------
+
+template <class T>
+void fill_buffer(vector<T> &buf, int frames, int channels, double amplitude,
+		 double bias) {
+  buf.resize(size_t(frames)*channels);
+  for (int i = 0; i < frames; ++i)
+    for (int j = 0; j < channels; ++j) {
+      double v = amplitude*(j+1)/channels*sin(0.01*i*(j+1));
+      buf[size_t(i)*channels+j] = T(v + bias);
+    }
+}
+
+// ----------------------------------------------------------------------
+
+template <class T>
+bool run_format(const string &name, AudioLevels::SampleFormat format,
+		double amplitude, double bias, double fullscale,
+		int frames, int channels, int rounds) {
+  vector<T> buf;
+  fill_buffer(buf, frames, channels, amplitude, bias);
+
+  bool ok = true;
+  vector<float> peak(channels), rms(channels);
+  vector<float> ref_peak(channels), ref_rms(channels);
+  AudioLevels::compute(AudioLevels::Scalar, &buf[0], frames, channels, format,
+		       &ref_peak[0], &ref_rms[0]);
+
+  ptime t0 = microsec_clock::local_time();
+  volatile double sink = 0;
+  for (int r = 0; r < rounds; ++r) {
+    vector<double> v = legacy_levels(&buf[0], frames, channels);
+    sink += v[0];
+  }
+  double legacy_us = (microsec_clock::local_time()-t0).total_microseconds();
+
+  cout << name << ": legacy " << legacy_us/rounds << " us/buffer";
+
+  for (int k = AudioLevels::Scalar; k <= AudioLevels::AVX2; ++k) {
+    AudioLevels::Kernel kernel = AudioLevels::Kernel(k);
+    if (k > AudioLevels::bestKernel())
+      break;
+    t0 = microsec_clock::local_time();
+    for (int r = 0; r < rounds; ++r)
+      AudioLevels::compute(kernel, &buf[0], frames, channels, format,
+			   &peak[0], &rms[0]);
+    double us = (microsec_clock::local_time()-t0).total_microseconds();
+    cout << ", " << AudioLevels::kernelName(kernel) << " " << us/rounds
+	 << " us/buffer (x" << legacy_us/us << ")";
+
+    for (int c = 0; c < channels; ++c)
+      if (fabs(peak[c]-ref_peak[c]) > 1e-5 || 
+	  fabs(rms[c]-ref_rms[c]) > 1e-4*(ref_rms[c]+1e-3)) {
+	cout << endl << "ERROR: " << AudioLevels::kernelName(kernel)
+	     << " channel " << c << " peak " << peak[c] << " != "
+	     << ref_peak[c] << " or rms " << rms[c] << " != " << ref_rms[c];
+	ok = false;
+      }
+  }
+  cout << endl;
+
+  // The legacy code only reports the peak, compare against that for
+  // signed formats where it is meaningful:
+  if (bias == 0.0) {
+    vector<double> legacy = legacy_levels(&buf[0], frames, channels);
+    for (int c = 0; c < channels; ++c)
+      if (fabs(legacy[c]/fullscale-ref_peak[c]) > 1e-5) {
+	cout << "ERROR: legacy peak " << legacy[c]/fullscale << " != "
+	     << ref_peak[c] << " on channel " << c << endl;
+	ok = false;
+      }
+  }
+
+  return ok;
+}
+
+// ----------------------------------------------------------------------
+
+int main(int ac, char** av) {
+
+  int frames = 4800, channels = 8, rounds = 2000;
+
+  for (int i=1; i<ac; i++) {
+    string arg(av[i]);
+
+    if (boost::starts_with(arg, "--frames=") && arg.size()>9) {
+      frames = atoi(arg.substr(9).c_str());
+    } else if (boost::starts_with(arg, "--channels=") && arg.size()>11) {
+      channels = atoi(arg.substr(11).c_str());
+    } else if (boost::starts_with(arg, "--rounds=") && arg.size()>9) {
+      rounds = atoi(arg.substr(9).c_str());
+    } else {
+      help(av);
+      return 1;
+    }
+  }
+
+  cout << "frames=" << frames << " channels=" << channels
+       << " rounds=" << rounds << " best kernel="
+       << AudioLevels::kernelName(AudioLevels::bestKernel()) << endl;
+
+  bool ok = true;
+  ok &= run_format<float>("float32", AudioLevels::Float32,
+			  0.9, 0, 1.0, frames, channels, rounds);
+  ok &= run_format<short>("int16", AudioLevels::Int16,
+			  30000, 0, 32768.0, frames, channels, rounds);
+  ok &= run_format<int>("int32", AudioLevels::Int32,
+			2e9, 0, 2147483648.0, frames, channels, rounds);
+  ok &= run_format<signed char>("int8", AudioLevels::Int8,
+				120, 0, 128.0, frames, channels, rounds);
+  ok &= run_format<unsigned char>("uint8", AudioLevels::UInt8,
+				  120, 128, 128.0, frames, channels, rounds);
+  ok &= run_format<unsigned short>("uint16", AudioLevels::UInt16,
+				   30000, 32768, 32768.0, frames, channels, rounds);
+  ok &= run_format<unsigned int>("uint32", AudioLevels::UInt32,
+				 2e9, 2147483648.0, 2147483648.0, frames, channels, rounds);
+
+  return ok ? 0 : 1;
+}
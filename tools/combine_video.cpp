@@ -36,6 +36,10 @@ OTHER DEALINGS IN THE SOFTWARE.
 
 #include <MediaInfo/MediaInfo.h>
 
+#include "timeline.h"
+#include "meetingdir.h"
+#include "indexedcapture.h"
+
 using namespace cv;
 using namespace std;
 
@@ -48,7 +52,7 @@ using namespace std;
 // ----------------------------------------------------------------------
 
 struct capturestruct {
-  capturestruct(int _idx, time_t _start_epoch, VideoCapture _cap) : 
+  capturestruct(int _idx, time_t _start_epoch, IndexedCapture _cap) : 
     idx(_idx), start_epoch(_start_epoch), status(true), 
     current_frame(0), cap(_cap), successor(0), transform(false), 
     rotate(false), special_fps(0) { }
@@ -57,7 +61,7 @@ struct capturestruct {
   bool status;
   int current_frame;
   map <int, string> matches;
-  VideoCapture cap; 
+  IndexedCapture cap; 
   size_t successor;
   bool transform;
   bool rotate;
@@ -99,10 +103,15 @@ void help(char** av) {
        << "filename of a fixed slide shown continously" << endl
        << "  [--fps=X]              : "
        << "set framerate to X, default is 25" << endl
+       << "  [--start=X]            : "
+       << "start X seconds after the earliest video" << endl
        << "  [--title=X]            : "
        << "set title of video to X" << endl
        << "  [--hr=X]               : " 
-       << "filename of heart rate CSV data to be shown" << endl;
+       << "filename of heart rate CSV data to be shown" << endl
+       << "  [--timeline=X]         : "
+       << "show status, pose and events from a meeting directory or" << endl
+       << "                           its timeline.txt" << endl;
 }
 
 // ----------------------------------------------------------------------
@@ -156,6 +165,16 @@ string timestampfn(const string &fn) {
     boost::replace_first(ret, "capture1.avi", "starttime.txt");
   else
     ret += ".txt";
+
+  // A video placed on another volume has its timestamp file in the
+  // meeting directory:
+  if (!ifstream(ret.c_str())) {
+    size_t slash = ret.rfind('/');
+    string dir = slash == string::npos ? "." : ret.substr(0, slash);
+    string meeting = MeetingDir::meetingOf(dir);
+    if (meeting != dir)
+      ret = meeting + "/" + ret.substr(slash == string::npos ? 0 : slash+1);
+  }
   
   return ret;
 }
@@ -352,6 +371,32 @@ void initialize_output(size_t width, size_t height, Size &totalsize,
 
 
 
+// ----------------------------------------------------------------------
+
+// Active status and pose, and events of the last two seconds, at the
+// top left of the frame.
+void draw_annotations(Mat &frame, const Timeline &tl, int64_t t_ms) {
+  stringstream ss;
+  const Timeline::Interval *iv = tl.at("status", t_ms);
+  if (iv)
+    ss << "status " << iv->value << "  ";
+  iv = tl.at("pose", t_ms);
+  if (iv)
+    ss << "pose " << iv->value << "  ";
+  vector<Timeline::Interval> events;
+  tl.between("event", t_ms-2000, t_ms, events);
+  for (size_t i=0; i<events.size(); i++)
+    ss << "event " << events[i].value << "  ";
+
+  string text = ss.str();
+  if (text.empty())
+    return;
+  rectangle(frame, Point(2,2), Point(12+8*int(text.size()), 28),
+	    Scalar(0,0,0), CV_FILLED);
+  putText(frame, text.c_str(), Point(10,20), FONT_HERSHEY_PLAIN, 1.0,
+	  Scalar(255,255,255));
+}
+
 // ----------------------------------------------------------------------
 
 int main(int ac, char** av) {
@@ -368,10 +413,12 @@ int main(int ac, char** av) {
   string outputfn = "output.avi", slidedir = ".", fixedslidefn = "";
   string title;
   size_t framerate = 25;
+  int start_offset = 0;
   //map <size_t, string> transforms;
   map<time_t, double> hr;
   bool debug_printcaptures = true;
   bool doublewidth_zero = false;
+  Timeline timeline;
 
   for (int i=1; i<ac; i++) {
     string arg(av[i]);
@@ -413,6 +460,10 @@ int main(int ac, char** av) {
       framerate = atoi(arg.substr(6).c_str());
       continue;
 
+    } else if (boost::starts_with(arg, "--start=") && arg.size()>8) {
+      start_offset = atoi(arg.substr(8).c_str());
+      continue;
+
     } else if (boost::starts_with(arg, "--startidx=") && arg.size()>11) {
       startidx = atoi(arg.substr(11).c_str());
       continue;
@@ -421,6 +472,16 @@ int main(int ac, char** av) {
       process_hr(arg.substr(5), hr);
       continue;
 
+    } else if (boost::starts_with(arg, "--timeline=") && arg.size()>11) {
+      string tlfn = arg.substr(11);
+      bool ok = boost::ends_with(tlfn, ".txt") ? timeline.load(tlfn) :
+	timeline.compile(tlfn);
+      if (!ok) {
+	cerr << "ERROR: " << timeline.errorString() << endl;
+	return 1;
+      }
+      continue;
+
     } else if (boost::starts_with(arg, "--title=") && arg.size()>8) {
       title = arg.substr(8);
       continue;
@@ -473,8 +534,8 @@ int main(int ac, char** av) {
     string &fn = parts[1];
     if (idx > nidx)
       nidx = idx;
-    VideoCapture capture(fn);
-    if (!capture.isOpened()) {
+    IndexedCapture capture;
+    if (!capture.open(fn)) {
       cerr << "ERROR: Failed to open a video file [" << fn << "]" << endl;
       return 1;
     }
@@ -663,7 +724,27 @@ int main(int ac, char** av) {
 
   int fourcc = CV_FOURCC('m','p','4','v');
 
-  time_t current_epoch = min_epoch; 
+  time_t current_epoch = min_epoch + start_offset; 
+
+  // Videos that started earlier seek to the start, by their indexes
+  // only from the keyframe before it:
+  for (size_t c=0; start_offset>0 && c<captures.size(); c++) {
+    if (!captures.at(c).status ||
+	captures.at(c).start_epoch >= current_epoch)
+      continue;
+    if (captures.at(c).successor)
+      cout << "WARNING: --start does not follow continued videos, "
+	   << "idx=" << captures.at(c).idx << endl;
+    IndexedCapture& vc = captures.at(c).cap;
+    if (!vc.seekTime(current_epoch-captures.at(c).start_epoch)) {
+      cerr << "ERROR: Seeking idx=" << captures.at(c).idx << " failed"
+	   << endl;
+      return 1;
+    }
+    captures.at(c).current_frame = vc.position();
+    cout << "Started idx=" << captures.at(c).idx << " from frame "
+	 << vc.position() << (vc.indexed() ? "" : " (no index)") << endl;
+  }
 
   VideoWriter video;
   ofstream slideoutfile;
@@ -728,7 +809,7 @@ int main(int ac, char** av) {
 	continue;
 
       int idx            = captures.at(c).idx;
-      VideoCapture& vc   = captures.at(c).cap;
+      IndexedCapture& vc = captures.at(c).cap;
       int& current_frame = captures.at(c).current_frame;
 
       bool& frameok = frames.at(idx).first;
@@ -841,6 +922,10 @@ int main(int ac, char** av) {
 		Point(frame.cols-150,frame.rows-50), FONT_HERSHEY_PLAIN, 5.0,
 		Scalar(0,0,255), 8);
       }
+      if (!timeline.empty())
+	draw_annotations(frame, timeline,
+			 int64_t(current_epoch)*1000+(nf-1)*1000/framerate);
+
       if (current_epoch < recstart_epoch) {
 	string recstart_text = "Recording will start at " + 
 	  timedatestr(recstart_epoch);
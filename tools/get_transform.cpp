@@ -32,13 +32,17 @@ OTHER DEALINGS IN THE SOFTWARE.
 
 #include <boost/algorithm/string.hpp>
 
+#include "indexedcapture.h"
+
 using namespace cv;
 using namespace std;
 
 // ----------------------------------------------------------------------
 
 void help(char** av) {
-  cout << "Usage:" << endl << av[0] << " [--rotate] file" << endl;
+  cout << "Usage:" << endl << av[0] << " [--rotate] [--at=S] file" << endl
+       << endl
+       << "  --at=S : pick the corners S seconds into the video" << endl;
 }
 
 // ----------------------------------------------------------------------
@@ -101,8 +105,9 @@ int main(int ac, char** av) {
     return 1;
   }
 
-  VideoCapture capture;
+  IndexedCapture capture;
   bool rotate = false;
+  double at = 0;
 
   for (int i=1; i<ac; i++) {
     string arg(av[i]);
@@ -110,13 +115,20 @@ int main(int ac, char** av) {
     if (boost::starts_with(arg, "--rotate")) {
       rotate = true;
       continue;
+    } else if (boost::starts_with(arg, "--at=") && arg.size()>5) {
+      at = atof(arg.substr(5).c_str());
+      continue;
     }
 
-    capture.open(arg);
-    if (!capture.isOpened()) {
+    if (!capture.open(arg)) {
       cerr << "ERROR: Failed to open a video file [" << arg << "]" << endl;
       return 1;
     }
+    if (at > 0 && !capture.seekTime(at)) {
+      cerr << "ERROR: Failed to seek to " << at << " s in [" << arg << "]"
+	   << endl;
+      return 1;
+    }
     break;
   }
 
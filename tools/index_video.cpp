@@ -0,0 +1,277 @@
+/*
+Copyright (c) 2015-2016 University of Helsinki
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// Builds the seek index of existing recordings, the same one the
+// recorder writes when it closes a file.  The frame times come from
+// the start of the file in manifest.txt and the frame rate, as older
+// recordings have no time for each frame.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "videoindex.h"
+#include "meetingdir.h"
+#include "indexedcapture.h"
+
+using namespace std;
+using namespace boost::posix_time;
+
+// ----------------------------------------------------------------------
+
+void help(char** av) {
+  cout << "Usage:" << endl << av[0]
+       << " [options] meetingdir|videofile [...]"
+       << endl << endl
+       << "Writes capture0-index.txt for capture0.avi, for a meeting"
+       << " directory for every" << endl
+       << "video file in its manifest.txt or else every capture*.avi."
+       << endl << endl
+       << "Options:" << endl
+       << "  [--force]              : "
+       << "replace existing indexes, also those of the recorder" << endl
+       << "  [--check=N]            : "
+       << "compare N seeks with decoding the file in order" << endl;
+}
+
+// ----------------------------------------------------------------------
+
+bool is_directory(const string &path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// ----------------------------------------------------------------------
+
+string dirname(const string &path) {
+  size_t slash = path.rfind('/');
+  return slash == string::npos ? "." : path.substr(0, slash);
+}
+
+// ----------------------------------------------------------------------
+
+// Master clock time of the first frame of each file in the manifest:
+// master_ns wallclock stream event file [key=value ...]
+map<string, int64_t> read_manifest(const string &meeting) {
+  map<string, int64_t> starts;
+  ifstream in((meeting+"/manifest.txt").c_str());
+  string line;
+  while (getline(in, line)) {
+    istringstream fields(line);
+    long long ns;
+    string wall, stream, event, file;
+    if (!(fields >> ns >> wall >> stream >> event >> file) ||
+	(event != "open" && event != "segment") ||
+	!boost::ends_with(file, ".avi"))
+      continue;
+    starts[file[0] == '/' ? file : meeting+"/"+file] = ns;
+  }
+  return starts;
+}
+
+// ----------------------------------------------------------------------
+
+bool index_file(const string &fn, int64_t t0_ns, bool force) {
+  string out = VideoIndex::sidecar(fn);
+  struct stat st;
+  if (!force && stat(out.c_str(), &st) == 0) {
+    cout << out << ": exists" << endl;
+    return true;
+  }
+
+  ptime t0 = microsec_clock::local_time();
+  VideoIndex index;
+  if (!index.readAvi(fn)) {
+    cerr << "ERROR: " << index.errorString() << endl;
+    return false;
+  }
+  index.setTimes(t0_ns);
+  if (!index.save(out)) {
+    cerr << "ERROR: cannot write " << out << endl;
+    return false;
+  }
+
+  size_t keys = 0, gop = 0, maxgop = 0;
+  for (size_t i=0; i<index.size(); i++) {
+    if (index.at(i).key) {
+      keys++;
+      gop = 0;
+    }
+    maxgop = max(maxgop, ++gop);
+  }
+  cout << out << ": " << index.size() << " frames, " << keys
+       << " keyframes, at most " << maxgop << " frames apart, in "
+       << (microsec_clock::local_time()-t0).total_milliseconds() << " ms"
+       << endl;
+  return true;
+}
+
+// ----------------------------------------------------------------------
+
+// FNV-1a of the pixels, to compare frames without keeping them
+uint64_t frame_hash(const cv::Mat &frame) {
+  uint64_t h = 14695981039346656037ULL;
+  for (int r=0; r<frame.rows; r++) {
+    const uchar *p = frame.ptr(r);
+    for (size_t i=0; i<frame.cols*frame.elemSize(); i++)
+      h = (h^p[i])*1099511628211ULL;
+  }
+  return h;
+}
+
+// ----------------------------------------------------------------------
+
+// Decodes the file once in order, then seeks to the same frames in
+// random order and checks that each seek finds the frame it asked for.
+bool check_file(const string &fn, size_t n) {
+  IndexedCapture cap;
+  if (!cap.open(fn) || !cap.indexed()) {
+    cerr << "ERROR: cannot check " << fn << endl;
+    return false;
+  }
+  size_t nframes = cap.index().size();
+  vector<size_t> targets;
+  set<size_t> chosen;
+  srand(time(NULL));
+  while (chosen.size() < min(n, nframes))
+    chosen.insert(size_t(rand())%nframes);
+  targets.assign(chosen.begin(), chosen.end());
+
+  map<size_t, uint64_t> expected;
+  cv::VideoCapture in(fn);
+  cv::Mat frame;
+  for (size_t i=0, t=0; t<targets.size() && in.read(frame); i++)
+    if (i == targets[t]) {
+      expected[i] = frame_hash(frame);
+      t++;
+    }
+  if (expected.size() < targets.size()) {
+    cerr << "ERROR: " << fn << " ends before frame " << targets.back()
+	 << endl;
+    return false;
+  }
+
+  for (size_t t=targets.size(); t>1; t--)
+    swap(targets[t-1], targets[size_t(rand())%t]);
+  size_t wrong = 0;
+  ptime t0 = microsec_clock::local_time();
+  for (size_t t=0; t<targets.size(); t++)
+    if (!cap.seekFrame(targets[t]) || !cap.read(frame) ||
+	frame_hash(frame) != expected[targets[t]]) {
+      cerr << fn << ": seek to frame " << targets[t] << " failed" << endl;
+      wrong++;
+    }
+  int64_t ms = (microsec_clock::local_time()-t0).total_milliseconds();
+  cout << fn << ": " << targets.size() << " seeks, " << wrong
+       << " wrong, " << (targets.size() ? ms/int64_t(targets.size()) : 0)
+       << " ms each" << endl;
+  return wrong == 0;
+}
+
+// ----------------------------------------------------------------------
+
+int main(int ac, char** av) {
+
+  bool force = false;
+  size_t check = 0;
+  vector<string> args;
+
+  for (int i=1; i<ac; i++) {
+    string arg(av[i]);
+
+    if (arg == "--force") {
+      force = true;
+    } else if (boost::starts_with(arg, "--check=") && arg.size()>8) {
+      check = atoi(arg.substr(8).c_str());
+    } else if (boost::starts_with(arg, "--")) {
+      help(av);
+      return 1;
+    } else
+      args.push_back(arg);
+  }
+
+  if (args.empty()) {
+    help(av);
+    return 1;
+  }
+
+  bool ok = true;
+  for (size_t a=0; a<args.size(); a++) {
+    string meeting = MeetingDir::meetingOf(is_directory(args[a]) ? args[a] :
+					   dirname(args[a]));
+    map<string, int64_t> starts = read_manifest(meeting);
+
+    if (!is_directory(args[a])) {
+      // The streams have their own file names, wherever the files are:
+      string name = args[a].substr(args[a].rfind('/')+1);
+      int64_t t0_ns = 0;
+      for (map<string, int64_t>::const_iterator s = starts.begin();
+	   s != starts.end(); ++s)
+	if (s->first.substr(s->first.rfind('/')+1) == name)
+	  t0_ns = s->second;
+      ok = index_file(args[a], t0_ns, force) && ok;
+      if (check)
+	ok = check_file(args[a], check) && ok;
+      continue;
+    }
+
+    if (starts.empty()) {
+      vector<string> dirs = MeetingDir::directories(meeting);
+      for (size_t v=0; v<dirs.size(); v++) {
+	DIR *d = opendir(dirs[v].c_str());
+	if (!d)
+	  continue;
+	struct dirent *e;
+	while ((e = readdir(d)) != NULL) {
+	  string name(e->d_name);
+	  if (boost::starts_with(name, "capture") &&
+	      boost::ends_with(name, ".avi"))
+	    starts[dirs[v]+"/"+name] = 0;
+	}
+	closedir(d);
+      }
+    }
+
+    for (map<string, int64_t>::const_iterator s = starts.begin();
+	 s != starts.end(); ++s) {
+      ok = index_file(s->first, s->second, force) && ok;
+      if (check)
+	ok = check_file(s->first, check) && ok;
+    }
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+/*
+Copyright (c) 2015-2016 University of Helsinki
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <iostream>
+
+#include "indexedcapture.h"
+
+using namespace std;
+
+// ----------------------------------------------------------------------
+
+bool IndexedCapture::open(const string &filename) {
+  pos = 0;
+  if (!cap.open(filename))
+    return false;
+  if (!idx.load(VideoIndex::sidecar(filename)) && !idx.readAvi(filename))
+    cerr << "WARNING: " << idx.errorString()
+	 << ", seeking without an index" << endl;
+  return true;
+}
+
+// ----------------------------------------------------------------------
+
+bool IndexedCapture::read(cv::Mat &frame) {
+  if (!cap.read(frame))
+    return false;
+  pos++;
+  return true;
+}
+
+// ----------------------------------------------------------------------
+
+// The backend may land on another frame than it was asked for, so
+// pos is always taken from where it says it is.
+bool IndexedCapture::setPosition(size_t n) {
+  if (!cap.set(CV_CAP_PROP_POS_FRAMES, double(n)))
+    return false;
+  double at = cap.get(CV_CAP_PROP_POS_FRAMES);
+  if (at < 0)
+    return false;
+  pos = size_t(at+0.5);
+  return true;
+}
+
+// ----------------------------------------------------------------------
+
+bool IndexedCapture::seekFrame(size_t n) {
+  if (!indexed())
+    return setPosition(n) && pos == n;
+  if (n >= idx.size())
+    return false;
+
+  // Past the keyframe is no use, as the frames after it need it.  An
+  // earlier keyframe only costs more decoding:
+  size_t key = idx.keyframeBefore(n);
+  if (pos < key || pos > n) {
+    for (;;) {
+      if (!setPosition(key))
+	return false;
+      if (pos <= key)
+	break;
+      if (key == 0)
+	return false;
+      key = idx.keyframeBefore(key-1);
+    }
+  }
+  // grab() decodes without converting the frames:
+  for (; pos < n; pos++)
+    if (!cap.grab())
+      return false;
+  return true;
+}
+
+// ----------------------------------------------------------------------
+
+bool IndexedCapture::seekTime(double s) {
+  if (!indexed()) {
+    if (!cap.set(CV_CAP_PROP_POS_MSEC, s*1000))
+      return false;
+    pos = size_t(cap.get(CV_CAP_PROP_POS_FRAMES));
+    return true;
+  }
+  return seekFrame(idx.frameAt(int64_t(s*1e9)));
+}
@@ -0,0 +1,69 @@
+/*
+Copyright (c) 2015-2016 University of Helsinki
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef INDEXEDCAPTURE_H
+#define INDEXEDCAPTURE_H
+
+#include <string>
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include "videoindex.h"
+
+// ----------------------------------------------------------------------
+
+// A cv::VideoCapture that seeks by the index of the file, the
+// capture0-index.txt written by the recorder or index_video, or else
+// one read from the AVI file itself.  A seek goes to the keyframe
+// before the frame and only decodes from there on, and not at all
+// when reading on from the current frame is shorter.  Where the
+// backend actually landed is read back, and if that is past the
+// keyframe the seek starts from an earlier one.  index_video --check
+// compares seeks with decoding the file in order.
+
+class IndexedCapture {
+public:
+  bool open(const std::string &filename);
+  bool isOpened() const { return cap.isOpened(); }
+
+  bool read(cv::Mat &frame);
+
+  bool seekFrame(size_t n);
+  // Seconds after the first frame, by the recorded frame times
+  bool seekTime(double s);
+
+  size_t position() const { return pos; }
+  const VideoIndex &index() const { return idx; }
+  bool indexed() const { return idx.size() > 0; }
+
+private:
+  bool setPosition(size_t n);
+
+  cv::VideoCapture cap;
+  VideoIndex idx;
+  size_t pos;
+};
+
+#endif // INDEXEDCAPTURE_H
@@ -0,0 +1,205 @@
+/*
+Copyright (c) 2015-2016 University of Helsinki
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// Keeps the meeting catalog of a directory such as ~/Meetings up to
+// date and searches it: by start time, host, stream, annotation,
+// duration and upload state.
+
+#include <iostream>
+#include <cstdlib>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/date_time/c_local_time_adjustor.hpp>
+
+#include "catalog.h"
+#include "timeline.h"
+
+using namespace std;
+using namespace boost::posix_time;
+
+// ----------------------------------------------------------------------
+
+void help(char** av) {
+  cout << "Usage:" << endl << av[0]
+       << " [options] [meetingsdir]"
+       << endl << endl
+       << "The catalog is meetingsdir/catalog.sqlite, by default in"
+       << " $HOME/Meetings." << endl
+       << "It is brought up to date before every query." << endl
+       << endl
+       << "Options:" << endl
+       << "  [--db=FILE]            : "
+       << "use another catalog file" << endl
+       << "  [--rebuild]            : "
+       << "read every meeting again" << endl
+       << "  [--no-scan]            : "
+       << "query the catalog as it is" << endl
+       << "  [--from=T] [--to=T]    : "
+       << "meetings that started in this range" << endl
+       << "  [--host=X]             : "
+       << "recorded on host X" << endl
+       << "  [--name=X]             : "
+       << "X is part of the directory path" << endl
+       << "  [--stream=X]           : "
+       << "with stream X, e.g. capture0 or audio" << endl
+       << "  [--annotation=X[=N]]   : "
+       << "with an annotation of type X, and value N" << endl
+       << "  [--event=N]            : "
+       << "same as --annotation=event=N" << endl
+       << "  [--min-duration=S]     : "
+       << "at least S seconds long" << endl
+       << "  [--uploaded]           : "
+       << "only uploaded meetings" << endl
+       << "  [--not-uploaded]       : "
+       << "only meetings not uploaded" << endl
+       << endl
+       << "Times are local, yyyy-mm-dd[Thh:mm:ss]." << endl;
+}
+
+// ----------------------------------------------------------------------
+
+int64_t parse_time(const string &s) {
+  if (s.find('T') == string::npos)
+    return Timeline::parseTime(s+"T00:00:00");
+  return Timeline::parseTime(s);
+}
+
+// ----------------------------------------------------------------------
+
+string timestr(int64_t ms) {
+  if (ms < 0)
+    return "-";
+  typedef boost::date_time::c_local_adjustor<ptime> local;
+  ptime t = local::utc_to_local(from_time_t(ms/1000));
+  return to_iso_extended_string(t);
+}
+
+// ----------------------------------------------------------------------
+
+int main(int ac, char** av) {
+
+  string db, root, from, to;
+  bool rebuild = false, scan = true;
+  Catalog::Filter filter;
+
+  for (int i=1; i<ac; i++) {
+    string arg(av[i]);
+
+    if (boost::starts_with(arg, "--db=") && arg.size()>5) {
+      db = arg.substr(5);
+    } else if (arg == "--rebuild") {
+      rebuild = true;
+    } else if (arg == "--no-scan") {
+      scan = false;
+    } else if (boost::starts_with(arg, "--from=") && arg.size()>7) {
+      from = arg.substr(7);
+    } else if (boost::starts_with(arg, "--to=") && arg.size()>5) {
+      to = arg.substr(5);
+    } else if (boost::starts_with(arg, "--host=") && arg.size()>7) {
+      filter.host = arg.substr(7);
+    } else if (boost::starts_with(arg, "--name=") && arg.size()>7) {
+      filter.name = arg.substr(7);
+    } else if (boost::starts_with(arg, "--stream=") && arg.size()>9) {
+      filter.stream = arg.substr(9);
+    } else if (boost::starts_with(arg, "--annotation=") && arg.size()>13) {
+      string a = arg.substr(13);
+      size_t eq = a.find('=');
+      filter.type = a.substr(0, eq);
+      if (eq != string::npos)
+	filter.value = atoi(a.substr(eq+1).c_str());
+    } else if (boost::starts_with(arg, "--event=") && arg.size()>8) {
+      filter.type = "event";
+      filter.value = atoi(arg.substr(8).c_str());
+    } else if (boost::starts_with(arg, "--min-duration=") && arg.size()>15) {
+      filter.min_duration = int64_t(atof(arg.substr(15).c_str())*1000);
+    } else if (arg == "--uploaded") {
+      filter.uploaded = 1;
+    } else if (arg == "--not-uploaded") {
+      filter.uploaded = 0;
+    } else if (boost::starts_with(arg, "--") || !root.empty()) {
+      help(av);
+      return 1;
+    } else
+      root = arg;
+  }
+
+  if (root.empty()) {
+    const char *home = getenv("HOME");
+    root = string(home ? home : ".")+"/Meetings";
+  }
+  if (db.empty())
+    db = root+"/catalog.sqlite";
+
+  if (!from.empty() && (filter.from = parse_time(from)) < 0) {
+    cerr << "ERROR: cannot parse time " << from << endl;
+    return 1;
+  }
+  if (!to.empty() && (filter.to = parse_time(to)) < 0) {
+    cerr << "ERROR: cannot parse time " << to << endl;
+    return 1;
+  }
+
+  Catalog catalog;
+  if (!catalog.open(db)) {
+    cerr << "ERROR: " << catalog.errorString() << endl;
+    return 1;
+  }
+
+  ptime t0 = microsec_clock::local_time();
+  if (scan) {
+    int n = catalog.rescan(root, rebuild);
+    if (n < 0) {
+      cerr << "ERROR: " << catalog.errorString() << endl;
+      return 1;
+    }
+    cerr << db << ": " << n << " meetings read in "
+	 << (microsec_clock::local_time()-t0).total_milliseconds() << " ms"
+	 << endl;
+    t0 = microsec_clock::local_time();
+  }
+
+  vector<Catalog::Meeting> found;
+  if (!catalog.find(filter, found)) {
+    cerr << "ERROR: " << catalog.errorString() << endl;
+    return 1;
+  }
+
+  for (size_t i=0; i<found.size(); i++) {
+    const Catalog::Meeting &m = found[i];
+    cout << m.path << " " << timestr(m.start) << " "
+	 << (m.duration < 0 ? string("-") :
+	     to_simple_string(milliseconds(m.duration)).substr(0, 8))
+	 << " " << (m.host.empty() ? "-" : m.host) << " "
+	 << m.bytes/1024/1024 << "MB " << m.files << " files "
+	 << (m.streams.empty() ? "-" : boost::join(m.streams, ","))
+	 << " uploaded=" << timestr(m.uploaded) << endl;
+  }
+  cerr << found.size() << " meetings found in "
+       << (microsec_clock::local_time()-t0).total_milliseconds() << " ms"
+       << endl;
+
+  return 0;
+}
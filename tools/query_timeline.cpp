@@ -0,0 +1,169 @@
+/*
+Copyright (c) 2015-2016 University of Helsinki
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// Compiles the annotations and voice activity indexes of a meeting
+// into timeline.txt, and answers queries on it: what was active at a
+// time, and what happened between two times.
+
+#include <iostream>
+#include <cstdlib>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/date_time/c_local_time_adjustor.hpp>
+
+#include <sys/stat.h>
+
+#include "timeline.h"
+
+using namespace std;
+using namespace boost::posix_time;
+
+// ----------------------------------------------------------------------
+
+void help(char** av) {
+  cout << "Usage:" << endl << av[0]
+       << " [options] meetingdir|timeline.txt"
+       << endl << endl
+       << "A meeting directory is compiled to meetingdir/timeline.txt first."
+       << endl << endl
+       << "Options:" << endl
+       << "  [--at=T]               : "
+       << "show what every track has active at T" << endl
+       << "  [--from=T --to=T]      : "
+       << "list everything between the two times" << endl
+       << "  [--track=X]            : "
+       << "limit the queries to track X, e.g. status or event" << endl
+       << endl
+       << "Times are local, yyyy-mm-ddThh:mm:ss[.zzz], or +S for S seconds"
+       << " from the start." << endl;
+}
+
+// ----------------------------------------------------------------------
+
+int64_t parse_time(const Timeline &tl, const string &s) {
+  if (boost::starts_with(s, "+"))
+    return tl.start()+int64_t(atof(s.substr(1).c_str())*1000);
+  return Timeline::parseTime(s);
+}
+
+// ----------------------------------------------------------------------
+
+string timestr(int64_t ms) {
+  if (ms == Timeline::Open)
+    return "end";
+  typedef boost::date_time::c_local_adjustor<ptime> local;
+  ptime t = local::utc_to_local(from_time_t(ms/1000))+milliseconds(ms%1000);
+  return to_iso_extended_string(t);
+}
+
+// ----------------------------------------------------------------------
+
+int main(int ac, char** av) {
+
+  string at, from, to, track;
+  vector<string> files;
+
+  for (int i=1; i<ac; i++) {
+    string arg(av[i]);
+
+    if (boost::starts_with(arg, "--at=") && arg.size()>5) {
+      at = arg.substr(5);
+    } else if (boost::starts_with(arg, "--from=") && arg.size()>7) {
+      from = arg.substr(7);
+    } else if (boost::starts_with(arg, "--to=") && arg.size()>5) {
+      to = arg.substr(5);
+    } else if (boost::starts_with(arg, "--track=") && arg.size()>8) {
+      track = arg.substr(8);
+    } else if (boost::starts_with(arg, "--")) {
+      help(av);
+      return 1;
+    } else
+      files.push_back(arg);
+  }
+
+  if (files.size() != 1 || from.empty() != to.empty()) {
+    help(av);
+    return 1;
+  }
+
+  Timeline tl;
+  struct stat st;
+  if (stat(files[0].c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+    ptime t0 = microsec_clock::local_time();
+    if (!tl.compile(files[0])) {
+      cerr << "ERROR: " << tl.errorString() << endl;
+      return 1;
+    }
+    string out = files[0]+"/timeline.txt";
+    if (!tl.save(out)) {
+      cerr << "ERROR: cannot write " << out << endl;
+      return 1;
+    }
+    cout << out << ": " << tl.tracks().size() << " tracks from "
+	 << timestr(tl.start()) << " to " << timestr(tl.end()) << " in "
+	 << (microsec_clock::local_time()-t0).total_milliseconds() << " ms"
+	 << endl;
+  } else if (!tl.load(files[0])) {
+    cerr << "ERROR: " << tl.errorString() << endl;
+    return 1;
+  }
+
+  vector<string> tracks = tl.tracks();
+  if (!track.empty())
+    tracks = vector<string>(1, track);
+
+  if (!at.empty()) {
+    int64_t t = parse_time(tl, at);
+    if (t < 0) {
+      cerr << "ERROR: cannot parse time " << at << endl;
+      return 1;
+    }
+    for (size_t i=0; i<tracks.size(); i++) {
+      const Timeline::Interval *iv = tl.at(tracks[i], t);
+      if (iv)
+	cout << tracks[i] << " " << iv->value << " " << timestr(iv->start)
+	     << " " << timestr(iv->end) << endl;
+    }
+  }
+
+  if (!from.empty()) {
+    int64_t t0 = parse_time(tl, from), t1 = parse_time(tl, to);
+    if (t0 < 0 || t1 < 0) {
+      cerr << "ERROR: cannot parse time range " << from << " " << to << endl;
+      return 1;
+    }
+    for (size_t i=0; i<tracks.size(); i++) {
+      vector<Timeline::Interval> found;
+      tl.between(tracks[i], t0, t1, found);
+      for (size_t j=0; j<found.size(); j++)
+	cout << tracks[i] << " " << found[j].value << " "
+	     << timestr(found[j].start) << " " << timestr(found[j].end)
+	     << endl;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,165 @@
+/*
+Copyright (c) 2015-2016 University of Helsinki
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// Draws the waveform of a whole recording, or a part of it, from the
+// <stream>.peaks pyramid written by mrecorder, without reading the
+// audio.
+
+#include <iostream>
+#include <cstdlib>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "waveform.h"
+
+using namespace std;
+using namespace cv;
+using namespace boost::posix_time;
+
+// ----------------------------------------------------------------------
+
+void help(char** av) {
+  cout << "Usage:" << endl << av[0]
+       << " [options] audio.peaks output.png"
+       << endl << endl
+       << "Options:" << endl
+       << "  [--width=X]            : "
+       << "image width, default is 1920" << endl
+       << "  [--height=X]           : "
+       << "height per channel, default is 120" << endl
+       << "  [--start=X]            : "
+       << "start time in seconds, default is 0" << endl
+       << "  [--end=X]              : "
+       << "end time in seconds, default is the end" << endl;
+}
+
+// ----------------------------------------------------------------------
+
+int main(int ac, char** av) {
+
+  int width = 1920, height = 120;
+  double start_s = 0, end_s = -1;
+  vector<string> files;
+
+  for (int i=1; i<ac; i++) {
+    string arg(av[i]);
+
+    if (boost::starts_with(arg, "--width=") && arg.size()>8) {
+      width = atoi(arg.substr(8).c_str());
+    } else if (boost::starts_with(arg, "--height=") && arg.size()>9) {
+      height = atoi(arg.substr(9).c_str());
+    } else if (boost::starts_with(arg, "--start=") && arg.size()>8) {
+      start_s = atof(arg.substr(8).c_str());
+    } else if (boost::starts_with(arg, "--end=") && arg.size()>6) {
+      end_s = atof(arg.substr(6).c_str());
+    } else if (boost::starts_with(arg, "--")) {
+      help(av);
+      return 1;
+    } else
+      files.push_back(arg);
+  }
+
+  if (files.size() != 2 || width < 1 || height < 2) {
+    help(av);
+    return 1;
+  }
+
+  ptime t0 = microsec_clock::local_time();
+
+  WaveformReader reader;
+  if (!reader.open(files[0])) {
+    cerr << "ERROR: cannot read " << files[0] << endl;
+    return 1;
+  }
+
+  int64_t first = int64_t(start_s*reader.rate());
+  int64_t last = end_s < 0 ? reader.frames() : int64_t(end_s*reader.rate());
+  if (last > reader.frames())
+    last = reader.frames();
+  if (first < 0 || first >= last) {
+    cerr << "ERROR: empty range, the recording has " << reader.frames()
+	 << " frames" << endl;
+    return 1;
+  }
+
+  // Finest level with at most a few bins per pixel:
+  int level = 0;
+  while (level < Waveform::Levels-1 &&
+	 (last-first)/Waveform::SamplesPerBin[level] > 4*width)
+    level++;
+  int64_t spb = Waveform::SamplesPerBin[level];
+
+  int channels = reader.channels();
+  Mat image(height*channels, width, CV_8UC3, Scalar(255, 255, 255));
+
+  for (int x = 0; x < width; x++) {
+    int64_t b0 = (first+(last-first)*x/width)/spb;
+    int64_t b1 = (first+(last-first)*(x+1)/width)/spb;
+    if (b1 <= b0)
+      b1 = b0+1;
+
+    for (int c = 0; c < channels; c++) {
+      int lo = 0, hi = 0, rms = 0, n = 0;
+      for (int64_t b = b0; b < b1; b++) {
+	const WaveformBin *bin = reader.bin(level, b);
+	if (!bin)
+	  break;
+	if (!n || bin[c].min < lo)
+	  lo = bin[c].min;
+	if (!n || bin[c].max > hi)
+	  hi = bin[c].max;
+	rms = max(rms, int(bin[c].rms));
+	n++;
+      }
+      if (!n)
+	continue;
+
+      int mid = height*c+height/2;
+      double scale = (height/2-1)/32768.0;
+      line(image, Point(x, mid-hi*scale), Point(x, mid-lo*scale),
+	   Scalar(200, 120, 40));
+      line(image, Point(x, mid-rms*scale), Point(x, mid+rms*scale),
+	   Scalar(120, 60, 10));
+    }
+  }
+
+  time_duration elapsed = microsec_clock::local_time()-t0;
+
+  if (!imwrite(files[1], image)) {
+    cerr << "ERROR: cannot write " << files[1] << endl;
+    return 1;
+  }
+
+  cout << files[1] << ": " << double(last-first)/reader.rate()
+       << " s from level " << level << " (1:" << spb << ") in "
+       << elapsed.total_milliseconds() << " ms" << endl;
+
+  return 0;
+}
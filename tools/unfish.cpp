@@ -28,6 +28,8 @@ OTHER DEALINGS IN THE SOFTWARE.
 
 #include <boost/algorithm/string.hpp>
 
+#include "indexedcapture.h"
+
 using namespace cv;
 using namespace std;
 
@@ -64,7 +66,9 @@ void help(char** av) {
        << endl
        << "  [--fov=X]              : "
        << "set FOV to X, default is " << DEFAULT_FOV << " (only method 1)"
-       << endl;
+       << endl
+       << "  [--start=X]            : "
+       << "start X seconds into the video" << endl;
 }
 
 // ----------------------------------------------------------------------
@@ -161,7 +165,8 @@ int main(int ac, char** av) {
 
   bool write_video = false, imgmode = false;
   string outputfn = "output.avi", imgfn = "";
-  VideoCapture capture;
+  IndexedCapture capture;
+  double start = 0;
   size_t framerate = DEFAULT_FRAMERATE, method = DEFAULT_METHOD;
   size_t crop_out = DEFAULT_CROP_OUT, crop_in = DEFAULT_CROP_IN;
   size_t fov = DEFAULT_FOV;
@@ -192,16 +197,23 @@ int main(int ac, char** av) {
     } else if (boost::starts_with(arg, "--fov=") && arg.size()>6) {
       fov = atoi(arg.substr(6).c_str());
       continue;
+    } else if (boost::starts_with(arg, "--start=") && arg.size()>8) {
+      start = atof(arg.substr(8).c_str());
+      continue;
     }
 
     if (imgmode) {
       imgfn = arg;
     }  else {
-      capture.open(arg);
-      if (!capture.isOpened()) {
+      if (!capture.open(arg)) {
         cerr << "ERROR: Failed to open a video file [" << arg << "]" << endl;
         return 1;
       }
+      if (start > 0 && !capture.seekTime(start)) {
+        cerr << "ERROR: Failed to seek to " << start << " s in [" << arg
+             << "]" << endl;
+        return 1;
+      }
     }
     break;
   }
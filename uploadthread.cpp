@@ -22,10 +22,14 @@
   SOFTWARE.
 */
 
+#include <QDateTime>
 #include <QDebug>
 #include <QDir>
+#include <QFile>
+#include <QTextStream>
 
 #include "uploadthread.h"
+#include "volumes.h"
 
 extern "C" {
 #include <sys/socket.h>
@@ -119,9 +123,20 @@ void UploadThread::run() Q_DECL_OVERRIDE {
 
   LIBSSH2_SFTP *sftp_session;
 
-  QDir dir(directory);
-  dir.setFilter(QDir::NoDotAndDotDot|QDir::Files);
-  QStringList files = dir.entryList();
+  // Streams placed on other volumes are uploaded into the same
+  // remote meeting directory.  Their meeting.txt only points back
+  // here.
+  QStringList files;
+  QStringList dirs = Volumes::directories(directory);
+  for (int d = 0; d < dirs.size(); ++d) {
+    QDir dir(dirs.at(d));
+    dir.setFilter(QDir::NoDotAndDotDot|QDir::Files);
+    QStringList names = dir.entryList();
+    for (int i = 0; i < names.size(); ++i)
+      if ((d == 0 || names.at(i) != "meeting.txt") &&
+	  names.at(i) != "uploaded.txt")
+	files << dir.filePath(names.at(i));
+  }
   long long totalsize = 0;
 
   LIBSSH2_AGENT* agent = trySshAgent(session);
@@ -180,8 +195,7 @@ void UploadThread::run() Q_DECL_OVERRIDE {
     goto shutdown;
 
   for (int i = 0; i < files.size(); ++i) {
-    QString lf = directory + "/" + files.at(i);
-    QFileInfo lf_info(lf);
+    QFileInfo lf_info(files.at(i));
     totalsize += lf_info.size();
   }
   emit nBlocks(totalsize/buffersize+1);
@@ -190,6 +204,18 @@ void UploadThread::run() Q_DECL_OVERRIDE {
     if (!processFile(sftp_session, files.at(i)))
       goto shutdown;
 
+  // Only kept locally, for the meeting catalog:
+  {
+    QFile upfile(directory+"/uploaded.txt");
+    if (upfile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+      QTextStream out(&upfile);
+      out << QDateTime::currentDateTime().toString(Qt::ISODate) << " "
+	  << username << "@" << server_ip << ":" << server_path_meeting
+	  << "\n";
+      upfile.close();
+    }
+  }
+
   libssh2_sftp_shutdown(sftp_session);
 
 shutdown:
@@ -310,9 +336,9 @@ LIBSSH2_AGENT* UploadThread::shutdownAgent(LIBSSH2_AGENT* agent) {
 // ---------------------------------------------------------------------
 
 bool UploadThread::processFile(LIBSSH2_SFTP *sftp_session,
-			       const QString &filename) {
+			       const QString &lf) {
 
-  QString lf = directory + "/" + filename;
+  QString filename = QFileInfo(lf).fileName();
 
   QByteArray ba_lf = lf.toLatin1();
   const char *loclfile = ba_lf.data();
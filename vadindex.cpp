@@ -0,0 +1,103 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include "vadindex.h"
+#include "metrics.h"
+
+// ---------------------------------------------------------------------
+
+VadIndexThread::VadIndexThread(const QString &st, const QString &dir,
+                               int r, int c, qint64 max)
+    : AudioSinkThread(st, "vad", r, c, max),
+      file(dir+"/"+st+"-vad.txt"), vad(r), speech_frames(0), window_us(0)
+{
+}
+
+// ---------------------------------------------------------------------
+
+// A missing index is not worth stopping the recording for, so errors
+// are only logged.
+void VadIndexThread::begin() {
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate |
+                   QIODevice::Text)) {
+        qWarning() << "WARNING: Failed to open" << file.fileName();
+        return;
+    }
+    file.write(VoiceActivity::header().c_str());
+    file.flush();
+}
+
+// ---------------------------------------------------------------------
+
+bool VadIndexThread::consume(const qint16 *data, int frames) {
+    QElapsedTimer timer;
+    timer.start();
+    vad.process(data, frames, channels, segments);
+    window_us += timer.nsecsElapsed()/1000;
+    return writeSegments();
+}
+
+// ---------------------------------------------------------------------
+
+void VadIndexThread::end() {
+    vad.finish(segments);
+    writeSegments();
+    report(0);
+    file.close();
+}
+
+// ---------------------------------------------------------------------
+
+void VadIndexThread::report(qint64) {
+    Metrics::set(stream+".vad_us", window_us);
+    Metrics::set(stream+".speech_ms", speech_frames*1000/rate);
+    window_us = 0;
+}
+
+// ---------------------------------------------------------------------
+
+// Segments are rare, each is flushed so that the index is usable
+// while recording.
+bool VadIndexThread::writeSegments() {
+    if (segments.empty())
+        return true;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        speech_frames += segments[i].end-segments[i].start;
+        if (file.isOpen())
+            file.write(VoiceActivity::format(segments[i], rate).c_str());
+    }
+    segments.clear();
+    if (file.isOpen())
+        file.flush();
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,68 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef VADINDEX_H
+#define VADINDEX_H
+
+#include <QFile>
+#include <vector>
+
+#include "audiosink.h"
+#include "voiceactivity.h"
+
+/// Writes the speech segments of a recorded stream to
+/// <stream>-vad.txt in the meeting directory as they are found.
+/// Segments are in frames consumed, which include the silence for
+/// dropped blocks, so they stay at the frame positions of the file.
+class VadIndexThread : public AudioSinkThread
+{
+    Q_OBJECT
+
+public:
+    VadIndexThread(const QString &stream, const QString &directory,
+                   int rate, int channels, qint64 max_bytes);
+
+protected:
+    void begin();
+    bool consume(const qint16 *data, int frames);
+    void end();
+    void report(qint64 backlog);
+
+private:
+    bool writeSegments();
+
+    QFile file;
+    VoiceActivity vad;
+    std::vector<VoiceActivity::Segment> segments;
+
+    qint64 speech_frames;
+    qint64 window_us;
+};
+
+#endif // VADINDEX_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
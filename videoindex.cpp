@@ -0,0 +1,341 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "videoindex.h"
+
+namespace {
+
+    const uint32_t AVIIF_KEYFRAME = 0x10;
+
+    uint32_t le32(const unsigned char *p) {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+    }
+
+    uint64_t le64(const unsigned char *p) {
+        return le32(p) | (uint64_t(le32(p+4)) << 32);
+    }
+
+    bool seekTo(FILE *f, int64_t pos) {
+        return fseeko(f, off_t(pos), SEEK_SET) == 0;
+    }
+
+    bool readBytes(FILE *f, int64_t pos, size_t n,
+                   std::vector<unsigned char> &buf) {
+        buf.resize(n);
+        return seekTo(f, pos) && (n == 0 || fread(&buf[0], 1, n, f) == n);
+    }
+
+    /// A chunk or list header: fourcc, size and for lists the type
+    struct Chunk {
+        char id[5], type[5];
+        int64_t pos, data, end;
+
+        bool read(FILE *f, int64_t at) {
+            unsigned char h[12];
+            if (!seekTo(f, at) || fread(h, 1, 8, f) != 8)
+                return false;
+            memcpy(id, h, 4);
+            id[4] = type[4] = 0;
+            type[0] = 0;
+            pos = at;
+            data = at+8;
+            end = data+le32(h+4)+(le32(h+4) & 1);
+            if (isList()) {
+                if (fread(h+8, 1, 4, f) != 4)
+                    return false;
+                memcpy(type, h+8, 4);
+                data += 4;
+            }
+            return true;
+        }
+
+        bool isList() const {
+            return !strcmp(id, "LIST") || !strcmp(id, "RIFF");
+        }
+        bool is(const char *s) const { return !strcmp(id, s); }
+        bool isList(const char *s) const {
+            return isList() && !strcmp(type, s);
+        }
+    };
+}
+
+// ---------------------------------------------------------------------
+
+std::string VideoIndex::sidecar(const std::string &video) {
+    size_t slash = video.rfind('/'), dot = video.rfind('.');
+    if (dot == std::string::npos ||
+        (slash != std::string::npos && dot < slash))
+        return video+"-index.txt";
+    return video.substr(0, dot)+"-index.txt";
+}
+
+// ---------------------------------------------------------------------
+
+// RIFF AVI: hdrl with avih and a strl per stream, the video stream's
+// strh of type vids and, in OpenDML files, its indx pointing to the
+// ix## chunks; then movi and idx1.  Later RIFF AVIX parts only have
+// movi.
+bool VideoIndex::readAvi(const std::string &filename) {
+    frames.clear();
+    period_ns = 0;
+
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f) {
+        error = "cannot open "+filename;
+        return false;
+    }
+    fseeko(f, 0, SEEK_END);
+    int64_t filesize = ftello(f);
+
+    Chunk riff;
+    if (!riff.read(f, 0) || !riff.isList("AVI ")) {
+        fclose(f);
+        error = filename+" is not an AVI file";
+        return false;
+    }
+    riff.end = std::min(riff.end, filesize);
+
+    int video = -1, streams = 0;
+    int64_t movi = -1, idx1 = -1;
+    uint32_t idx1_size = 0;
+    std::vector<int64_t> indexes;
+    std::vector<unsigned char> buf;
+
+    Chunk c;
+    for (int64_t at = riff.data; at+8 <= riff.end && c.read(f, at);
+         at = c.end) {
+        if (c.isList("movi"))
+            movi = c.data-4;
+        else if (c.is("idx1")) {
+            idx1 = c.data;
+            idx1_size = uint32_t(c.end-c.data);
+        } else if (c.isList("hdrl")) {
+            Chunk h;
+            for (int64_t hat = c.data; hat+8 <= c.end && h.read(f, hat);
+                 hat = h.end) {
+                if (h.is("avih") && readBytes(f, h.data, 4, buf))
+                    period_ns = int64_t(le32(&buf[0]))*1000;
+                if (!h.isList("strl"))
+                    continue;
+                bool vids = false;
+                Chunk s;
+                for (int64_t sat = h.data; sat+8 <= h.end && s.read(f, sat);
+                     sat = s.end) {
+                    if (s.is("strh") && readBytes(f, s.data, 4, buf) &&
+                        !memcmp(&buf[0], "vids", 4) && video < 0) {
+                        video = streams;
+                        vids = true;
+                    }
+                    // wLongsPerEntry, bIndexSubType, bIndexType,
+                    // nEntriesInUse, dwChunkId, 3 reserved, entries
+                    // of qwOffset, dwSize, dwDuration
+                    if (s.is("indx") && vids &&
+                        readBytes(f, s.data, 24, buf) && buf[3] == 0) {
+                        uint32_t n = le32(&buf[4]);
+                        if (readBytes(f, s.data+24, size_t(n)*16, buf))
+                            for (uint32_t i = 0; i < n; i++)
+                                indexes.push_back(le64(&buf[i*16]));
+                    }
+                }
+                streams++;
+            }
+        }
+    }
+
+    bool ok = false;
+    if (video < 0)
+        error = "no video stream in "+filename;
+    else if (!indexes.empty())
+        ok = readOpenDml(f, indexes);
+    else if (idx1 >= 0 && movi >= 0 &&
+             readBytes(f, idx1, idx1_size/16*16, buf)) {
+        // ckid, dwFlags, dwOffset, dwSize; the offsets usually count
+        // from the movi list type, sometimes from the file start
+        char dc[] = { char('0'+video/10%10), char('0'+video%10), 'd', 'c' };
+        char db[] = { dc[0], dc[1], 'd', 'b' };
+        size_t n = buf.size()/16;
+        int64_t base = -1;
+        for (size_t i = 0; i < n; i++) {
+            const unsigned char *e = &buf[i*16];
+            if (memcmp(e, dc, 4) && memcmp(e, db, 4))
+                continue;
+            if (base < 0)
+                base = le32(e+8) < movi ? movi : 0;
+            Frame fr = { base+le32(e+8)+8, le32(e+12),
+                         (le32(e+4) & AVIIF_KEYFRAME) != 0, -1 };
+            frames.push_back(fr);
+        }
+        ok = true;
+    } else
+        error = "no index in "+filename;
+
+    fclose(f);
+    if (ok && frames.empty()) {
+        error = "no frames indexed in "+filename;
+        ok = false;
+    }
+    return ok;
+}
+
+// ---------------------------------------------------------------------
+
+// ix## chunks: wLongsPerEntry, bIndexSubType, bIndexType,
+// nEntriesInUse, dwChunkId, qwBaseOffset, dwReserved, then entries of
+// dwOffset and dwSize, whose top bit marks frames that are not
+// keyframes.
+bool VideoIndex::readOpenDml(FILE *f, const std::vector<int64_t> &indexes) {
+    std::vector<unsigned char> buf;
+    for (size_t i = 0; i < indexes.size(); i++) {
+        Chunk c;
+        if (!c.read(f, indexes[i]) || !readBytes(f, c.data, 24, buf) ||
+            buf[3] != 1) {
+            error = "broken OpenDML index";
+            return false;
+        }
+        uint32_t n = le32(&buf[4]);
+        int64_t base = le64(&buf[12]);
+        if (!readBytes(f, c.data+24, size_t(n)*8, buf)) {
+            error = "truncated OpenDML index";
+            return false;
+        }
+        for (uint32_t j = 0; j < n; j++) {
+            uint32_t size = le32(&buf[j*8+4]);
+            Frame fr = { base+le32(&buf[j*8]), size & 0x7fffffff,
+                         (size & 0x80000000) == 0, -1 };
+            frames.push_back(fr);
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+void VideoIndex::setTimes(const std::vector<int64_t> &t_ns) {
+    for (size_t i = 0; i < frames.size(); i++)
+        frames[i].t_ns = i < t_ns.size() ? t_ns[i] : -1;
+}
+
+void VideoIndex::setTimes(int64_t t0_ns) {
+    for (size_t i = 0; i < frames.size(); i++)
+        frames[i].t_ns = period_ns > 0 ? t0_ns+int64_t(i)*period_ns : -1;
+}
+
+// ---------------------------------------------------------------------
+
+bool VideoIndex::save(const std::string &filename) const {
+    FILE *f = fopen(filename.c_str(), "w");
+    if (!f)
+        return false;
+    fprintf(f, "# frame offset size key t_ns, %lld ns per frame\n",
+            (long long)period_ns);
+    for (size_t i = 0; i < frames.size(); i++)
+        fprintf(f, "%lu %lld %u %d %lld\n", (unsigned long)i,
+                (long long)frames[i].offset, (unsigned)frames[i].size,
+                frames[i].key ? 1 : 0, (long long)frames[i].t_ns);
+    return fclose(f) == 0;
+}
+
+// ---------------------------------------------------------------------
+
+bool VideoIndex::load(const std::string &filename) {
+    frames.clear();
+    period_ns = 0;
+
+    std::ifstream in(filename.c_str());
+    if (!in) {
+        error = "cannot open "+filename;
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty())
+            continue;
+        if (line[0] == '#') {
+            size_t comma = line.find(", ");
+            if (comma != std::string::npos)
+                period_ns = atoll(line.c_str()+comma+2);
+            continue;
+        }
+        std::istringstream fields(line);
+        long long n, offset, t_ns;
+        unsigned size;
+        int key;
+        if (!(fields >> n >> offset >> size >> key >> t_ns) ||
+            n != (long long)frames.size()) {
+            error = "broken line in "+filename+": "+line;
+            frames.clear();
+            return false;
+        }
+        Frame fr = { offset, size, key != 0, t_ns };
+        frames.push_back(fr);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+size_t VideoIndex::keyframeBefore(size_t n) const {
+    if (frames.empty())
+        return 0;
+    n = std::min(n, frames.size()-1);
+    while (n > 0 && !frames[n].key)
+        n--;
+    return n;
+}
+
+// ---------------------------------------------------------------------
+
+namespace {
+    bool timeBefore(int64_t t, const VideoIndex::Frame &f) {
+        return t < f.t_ns;
+    }
+}
+
+size_t VideoIndex::frameAt(int64_t offset_ns) const {
+    if (frames.empty() || offset_ns <= 0)
+        return 0;
+    size_t n;
+    if (frames.front().t_ns >= 0 && frames.back().t_ns >= 0)
+        n = std::upper_bound(frames.begin(), frames.end(),
+                             frames.front().t_ns+offset_ns, timeBefore)
+            -frames.begin()-1;
+    else if (period_ns > 0)
+        n = size_t(offset_ns/period_ns);
+    else
+        n = 0;
+    return std::min(n, frames.size()-1);
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
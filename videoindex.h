@@ -0,0 +1,101 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef VIDEOINDEX_H
+#define VIDEOINDEX_H
+
+// Plain C++ so that the tools can use this without Qt.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/// Where each frame of an AVI file is, so that a reader can seek to a
+/// frame by decoding only from the keyframe before it.
+///
+/// readAvi() takes the frames of the first video stream from the
+/// OpenDML indexes of the file, or from idx1 for files under 1 GB.
+/// The recorder adds the master clock time of each frame and saves
+/// the index next to the file when it closes, capture0.avi indexed in
+/// capture0-index.txt.  That has a comment line and then a line per
+/// frame:
+///
+///   frame offset size key t_ns
+///
+/// where offset is the position of the frame data in the file, key is
+/// 1 for keyframes and t_ns is -1 if the time is not known.
+class VideoIndex
+{
+public:
+    struct Frame {
+        int64_t offset;
+        uint32_t size;
+        bool key;
+        int64_t t_ns;
+    };
+
+    VideoIndex() : period_ns(0) {}
+
+    bool readAvi(const std::string &filename);
+    bool load(const std::string &filename);
+    bool save(const std::string &filename) const;
+
+    /// The index file of a video file
+    static std::string sidecar(const std::string &video);
+
+    /// Times for the frames in order, or from t0_ns by the frame rate
+    /// of the file
+    void setTimes(const std::vector<int64_t> &t_ns);
+    void setTimes(int64_t t0_ns);
+
+    size_t size() const { return frames.size(); }
+    const Frame &at(size_t n) const { return frames[n]; }
+
+    /// Nanoseconds per frame from the AVI header, 0 if not known
+    int64_t framePeriod() const { return period_ns; }
+
+    /// The last keyframe at or before frame n
+    size_t keyframeBefore(size_t n) const;
+
+    /// The frame shown at offset_ns after the first one, by the times
+    /// of the frames or else by the frame rate
+    size_t frameAt(int64_t offset_ns) const;
+
+    std::string errorString() const { return error; }
+
+private:
+    bool readOpenDml(FILE *f, const std::vector<int64_t> &indexes);
+
+    std::vector<Frame> frames;
+    int64_t period_ns;
+    std::string error;
+};
+
+#endif // VIDEOINDEX_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
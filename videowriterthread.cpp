@@ -0,0 +1,352 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+
+#include "videowriterthread.h"
+#include "masterclock.h"
+#include "metrics.h"
+#include "manifest.h"
+#include "streamstats.h"
+#include "preroll.h"
+#include "videoindex.h"
+
+// ---------------------------------------------------------------------
+
+VideoWriterThread::VideoWriterThread(const QString &st, int max)
+    : stream(st), max_frames(qMax(1, max)), queued_frames(0), submitted(0),
+      completed(0), open_ok(false), stopping(false), failed(0), fourcc(0),
+      nwritten(0), closed_bytes(0), closed_frames(0)
+{
+    QSettings settings;
+    seek_index = settings.value("video/seek_index", true).toBool();
+}
+
+// ---------------------------------------------------------------------
+
+void VideoWriterThread::enqueue(const Item &item) {
+    QMutexLocker locker(&mutex);
+    items.enqueue(item);
+    submitted++;
+    queued.wakeOne();
+}
+
+// ---------------------------------------------------------------------
+
+bool VideoWriterThread::open(const QString &d, const QString &file, int fcc,
+                             int fps, cv::Size size, const QString &details) {
+    Item item;
+    item.type = Item::Open;
+    item.repeat = 0;
+    item.dir = d;
+    item.file = file;
+    item.details = details;
+    item.fourcc = fcc;
+    item.fps = fps;
+    item.size = size;
+
+    QMutexLocker locker(&mutex);
+    failed = 0;
+    items.enqueue(item);
+    qint64 id = ++submitted;
+    queued.wakeOne();
+    while (completed < id)
+        done.wait(&mutex);
+    return open_ok;
+}
+
+// ---------------------------------------------------------------------
+
+void VideoWriterThread::startSegment(const QString &file, int fps,
+                                     cv::Size size, const QString &details) {
+    Item item;
+    item.type = Item::Segment;
+    item.repeat = 0;
+    item.file = file;
+    item.details = details;
+    item.fourcc = 0;
+    item.fps = fps;
+    item.size = size;
+    enqueue(item);
+}
+
+// ---------------------------------------------------------------------
+
+// The copy is taken here, as the capture may reuse its buffer for the
+// next frame.
+bool VideoWriterThread::write(const cv::Mat &frame, qint64 t_ns) {
+    mutex.lock();
+    bool full = queued_frames >= max_frames && !items.isEmpty() &&
+        items.last().type == Item::Frame;
+    if (full) {
+        items.last().repeat++;
+        items.last().repeat_ns.push_back(t_ns);
+        mutex.unlock();
+        Metrics::add(stream+".repeated_frames", 1);
+        return false;
+    }
+    mutex.unlock();
+
+    Item item;
+    item.type = Item::Frame;
+    item.frame = frame.clone();
+    item.t_ns = t_ns;
+    item.repeat = 0;
+
+    QMutexLocker locker(&mutex);
+    items.enqueue(item);
+    queued_frames++;
+    submitted++;
+    queued.wakeOne();
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+void VideoWriterThread::writePreRoll(PreRoll *p, qint64 from, qint64 until) {
+    Item item;
+    item.type = Item::Backlog;
+    item.repeat = 0;
+    item.preroll = p;
+    item.from_ns = from;
+    item.until_ns = until;
+    enqueue(item);
+}
+
+// ---------------------------------------------------------------------
+
+void VideoWriterThread::close() {
+    Item item;
+    item.type = Item::Close;
+    item.repeat = 0;
+    enqueue(item);
+}
+
+// ---------------------------------------------------------------------
+
+void VideoWriterThread::breakLoop() {
+    QMutexLocker locker(&mutex);
+    stopping = true;
+    queued.wakeOne();
+}
+
+// ---------------------------------------------------------------------
+
+bool VideoWriterThread::openFile(const Item &item) {
+    video.open(QString(dir+item.file).toStdString(), fourcc, item.fps,
+               item.size);
+    nwritten = 0;
+    frame_ns.clear();
+    if (!video.isOpened())
+        return false;
+    filename = item.file;
+    prealloc.open(dir+filename);
+    StreamStats::addFile(stream);
+    publishStats();
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+void VideoWriterThread::closeFile() {
+    if (!video.isOpened())
+        return;
+    video.release();
+    prealloc.close();
+    Manifest::add(stream, "close", filename,
+                  QString("frames=%1").arg(nwritten));
+    publishStats();
+    closed_bytes += QFileInfo(dir+filename).size();
+    closed_frames += nwritten;
+    nwritten = 0;
+    if (seek_index) {
+        index_file = dir+filename;
+        index_ns.swap(frame_ns);
+    }
+    frame_ns.clear();
+}
+
+// ---------------------------------------------------------------------
+
+// The index is read from the finished file, after the next segment
+// has been opened so that the switch is not held up.
+void VideoWriterThread::writeIndex() {
+    if (index_file.isEmpty())
+        return;
+    qint64 t0 = MasterClock::nsecs();
+    std::string file = QFile::encodeName(index_file).constData();
+    VideoIndex index;
+    if (!index.readAvi(file)) {
+        qWarning() << "WARNING:" << stream << ": no seek index,"
+                   << QString::fromStdString(index.errorString());
+    } else {
+        if (index.size() != index_ns.size())
+            qWarning() << "WARNING:" << stream << ":" << index.size()
+                       << "frames in" << index_file << "for"
+                       << index_ns.size() << "written";
+        index.setTimes(index_ns);
+        if (!index.save(VideoIndex::sidecar(file)))
+            qWarning() << "WARNING: Failed to write the seek index of"
+                       << index_file;
+    }
+    Metrics::set(stream+".index_ms", (MasterClock::nsecs()-t0)/1000000);
+    index_file.clear();
+    index_ns.clear();
+}
+
+// ---------------------------------------------------------------------
+
+// The pre-roll frames were scaled and stamped like live ones, so they
+// only need decoding.
+void VideoWriterThread::writeBacklog(const Item &item) {
+    PreRoll::Entry e;
+    int n = 0;
+    while (item.preroll->take(item.from_ns, item.until_ns, e)) {
+        if (!video.isOpened())
+            continue;
+        cv::Mat frame = cv::imdecode(cv::Mat(1, e.data.size(), CV_8UC1,
+                                             e.data.data()),
+                                     CV_LOAD_IMAGE_COLOR);
+        if (frame.empty())
+            continue;
+        qint64 t0 = MasterClock::nsecs();
+        video << frame;
+        latency.add((MasterClock::nsecs()-t0)/1000);
+        frame_ns.push_back(e.t_ns);
+        nwritten++;
+        n++;
+    }
+    qDebug() << stream << ": wrote" << n << "pre-roll frames";
+}
+
+// ---------------------------------------------------------------------
+
+// Totals over all segments, for the status bar, and more space for
+// the file as it grows.
+void VideoWriterThread::publishStats() {
+    qint64 bytes = video.isOpened() ? QFileInfo(dir+filename).size() : 0;
+    prealloc.grow(bytes);
+    StreamStats::update(stream, closed_bytes+bytes, closed_frames+nwritten);
+}
+
+// ---------------------------------------------------------------------
+
+void VideoWriterThread::run() {
+    QElapsedTimer window;
+    window.start();
+
+    for (;;) {
+        mutex.lock();
+        while (items.isEmpty() && !stopping)
+            queued.wait(&mutex);
+        if (items.isEmpty()) {
+            mutex.unlock();
+            break;
+        }
+        Item item = items.dequeue();
+        if (item.type == Item::Frame)
+            queued_frames--;
+        int backlog = queued_frames;
+        mutex.unlock();
+
+        switch (item.type) {
+        case Item::Open: {
+            closeFile();
+            closed_bytes = closed_frames = 0;
+            dir = item.dir;
+            fourcc = item.fourcc;
+            bool ok = openFile(item);
+            if (ok)
+                Manifest::add(stream, "open", filename, item.details);
+            mutex.lock();
+            open_ok = ok;
+            mutex.unlock();
+            break;
+        }
+        case Item::Segment: {
+            qint64 t0 = MasterClock::nsecs();
+            QString prev = filename;
+            closeFile();
+            if (!openFile(item)) {
+                failed = 1;
+                emit errorMessage(QString("ERROR: Failed to start new "
+                                          "segment for %1").arg(stream));
+                break;
+            }
+            Manifest::add(stream, "segment", filename, item.details);
+            qDebug() << stream << ": switched from" << prev << "to"
+                     << filename << "in" << (MasterClock::nsecs()-t0)/1000000
+                     << "ms";
+            Metrics::set(stream+".segment_switch_ms",
+                         (MasterClock::nsecs()-t0)/1000000);
+            break;
+        }
+        case Item::Frame:
+            if (!video.isOpened())
+                break;
+            for (int i = 0; i <= item.repeat; i++) {
+                qint64 t0 = MasterClock::nsecs();
+                video << item.frame;
+                latency.add((MasterClock::nsecs()-t0)/1000);
+                frame_ns.push_back(i ? item.repeat_ns[i-1] : item.t_ns);
+                nwritten++;
+            }
+            break;
+        case Item::Backlog:
+            writeBacklog(item);
+            break;
+        case Item::Close:
+            closeFile();
+            break;
+        }
+        writeIndex();
+
+        mutex.lock();
+        completed++;
+        done.wakeAll();
+        mutex.unlock();
+
+        if (window.elapsed() >= 1000) {
+            latency.publish(stream+".write_us");
+            latency.clear();
+            Metrics::set(stream+".writer_queue", backlog);
+            if (video.isOpened())
+                publishStats();
+            window.restart();
+        }
+    }
+
+    closeFile();
+    writeIndex();
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
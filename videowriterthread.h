@@ -0,0 +1,152 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef VIDEOWRITERTHREAD_H
+#define VIDEOWRITERTHREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QString>
+
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/highgui/highgui.hpp"
+
+#include "preallocator.h"
+#include "latencyhistogram.h"
+
+class PreRoll;
+
+/// Encodes and writes the frames of one camera on its own thread, so
+/// that a slow encoder or disk never holds up capture.
+///
+/// The camera thread queues commands and frames, in order.  The queue
+/// holds at most max_frames frames.  When it is full the last queued
+/// frame is written once more instead of the new one, which costs no
+/// memory and keeps the file in time with the capture; such frames
+/// are counted in <stream>.repeated_frames.
+///
+/// The writer also keeps the manifest, the stream stats and the
+/// preallocation of its files, and publishes the time taken by each
+/// write in <stream>.write_us_p50, _p99 and _max.  Each closed file
+/// gets a seek index with the capture time of every frame (see
+/// VideoIndex), unless "video/seek_index" is false.
+class VideoWriterThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    VideoWriterThread(const QString &stream, int max_frames);
+
+    /// Opens a file and waits for the result, for the first file of
+    /// a recording
+    bool open(const QString &dir, const QString &file, int fourcc, int fps,
+              cv::Size size, const QString &details);
+
+    /// Continues in a new file after the queued frames, without
+    /// waiting
+    void startSegment(const QString &file, int fps, cv::Size size,
+                      const QString &details);
+
+    /// Queues a frame captured at t_ns, returns false if it was
+    /// replaced by a repeat
+    bool write(const cv::Mat &frame, qint64 t_ns);
+
+    /// Queues the frames of a pre-roll from from_ns up to until_ns.
+    /// They are decoded and taken out one at a time on the writer
+    /// thread, so the memory stays within the pre-roll's bound.
+    void writePreRoll(PreRoll *preroll, qint64 from_ns, qint64 until_ns);
+
+    void close();
+
+    /// Writes what is queued and exits
+    void breakLoop();
+
+    /// An asynchronous open has failed, cleared by open()
+    bool hasFailed() const { return failed.load(); }
+
+signals:
+    void errorMessage(const QString &);
+
+private:
+    struct Item {
+        enum Type { Open, Segment, Frame, Backlog, Close };
+        Type type;
+        cv::Mat frame;
+        qint64 t_ns;
+        int repeat;
+        /// Capture times of the frames the repeats stand for
+        std::vector<int64_t> repeat_ns;
+        PreRoll *preroll;
+        qint64 from_ns, until_ns;
+        QString dir, file, details;
+        int fourcc, fps;
+        cv::Size size;
+    };
+
+    void run();
+
+    void enqueue(const Item &);
+    bool openFile(const Item &);
+    void closeFile();
+    void writeBacklog(const Item &);
+    void writeIndex();
+    void publishStats();
+
+    QString stream;
+    int max_frames;
+
+    QMutex mutex;
+    QWaitCondition queued;
+    QWaitCondition done;
+    QQueue<Item> items;
+    int queued_frames;
+    qint64 submitted, completed;
+    bool open_ok;
+    bool stopping;
+    QAtomicInt failed;
+
+    /// Only touched on the writer thread
+    cv::VideoWriter video;
+    Preallocator prealloc;
+    LatencyHistogram latency;
+    QString dir, filename;
+    int fourcc;
+    qint64 nwritten;
+    qint64 closed_bytes, closed_frames;
+    bool seek_index;
+    /// Frame times of the open file, and of the file to index next
+    std::vector<int64_t> frame_ns, index_ns;
+    QString index_file;
+};
+
+#endif // VIDEOWRITERTHREAD_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,188 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <math.h>
+#include <stdio.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "voiceactivity.h"
+
+// Decision thresholds, tuned on meeting room recordings
+static const float SpeechAboveNoiseDb = 9.0f;
+static const float SilenceDb = -65.0f;
+static const float MaxTilt = 1.0f;
+static const float MaxZeroCrossings = 0.35f;
+
+// ---------------------------------------------------------------------
+
+VoiceActivity::VoiceActivity(int r) : rate_(r), fill(0), prev(0.0f),
+                                      position(0), have_noise(false),
+                                      noise_db(0.0f), in_speech(false),
+                                      onset(0), seg_start(0),
+                                      last_speech(0), level_sum(0.0),
+                                      level_n(0)
+{
+    frame_len = rate_/50;
+    hangover = rate_*3/10;
+    min_length = rate_/5;
+    frame.resize(frame_len+1);
+}
+
+// ---------------------------------------------------------------------
+
+void VoiceActivity::process(const int16_t *data, int frames, int channels,
+                            std::vector<Segment> &out) {
+    const float scale = 1.0f/(32768.0f*channels);
+
+    for (int i = 0; i < frames; ++i) {
+        int sum = 0;
+        for (int c = 0; c < channels; ++c)
+            sum += data[i*channels+c];
+        // frame[0] holds the last sample of the previous frame for
+        // the differences:
+        frame[1+fill++] = sum*scale;
+        if (fill == frame_len)
+            analyse(out);
+    }
+}
+
+// ---------------------------------------------------------------------
+
+void VoiceActivity::analyse(std::vector<Segment> &out) {
+    const float *x = &frame[1];
+    const float *xp = &frame[0];
+    const int n = frame_len;
+
+    frame[0] = prev;
+    float e = 0.0f, d = 0.0f, zc = 0.0f;
+    for (int i = 0; i < n; ++i)
+        e += x[i]*x[i];
+    for (int i = 0; i < n; ++i) {
+        float diff = x[i]-xp[i];
+        d += diff*diff;
+    }
+    for (int i = 0; i < n; ++i)
+        zc += (x[i]*xp[i] < 0.0f) ? 1.0f : 0.0f;
+    prev = x[n-1];
+
+    float db = 10.0f*log10f(e/n+1e-12f);
+    float tilt = d/(e+1e-12f);
+    zc /= n;
+
+    // The floor follows quiet frames quickly and creeps up slowly
+    // (about 1 dB/s), so it settles on the room noise:
+    if (!have_noise) {
+        noise_db = db;
+        have_noise = true;
+    } else if (db < noise_db)
+        noise_db += 0.2f*(db-noise_db);
+    else
+        noise_db += 0.02f;
+
+    bool speech = db > noise_db+SpeechAboveNoiseDb && db > SilenceDb &&
+        tilt < MaxTilt && zc < MaxZeroCrossings;
+
+    int64_t start = position;
+    position += n;
+    fill = 0;
+
+    if (speech) {
+        if (!in_speech && ++onset >= 2) {
+            in_speech = true;
+            seg_start = start-n;
+            level_sum = 0.0;
+            level_n = 0;
+        }
+        last_speech = position;
+        level_sum += db;
+        level_n++;
+    } else {
+        onset = 0;
+        if (in_speech && position-last_speech > hangover) {
+            in_speech = false;
+            if (last_speech-seg_start >= min_length) {
+                Segment s = { seg_start, last_speech,
+                              float(level_sum/level_n) };
+                out.push_back(s);
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------
+
+void VoiceActivity::finish(std::vector<Segment> &out) {
+    if (in_speech && last_speech-seg_start >= min_length) {
+        Segment s = { seg_start, last_speech, float(level_sum/level_n) };
+        out.push_back(s);
+    }
+    in_speech = false;
+}
+
+// ---------------------------------------------------------------------
+
+std::string VoiceActivity::header() {
+    return "# speech segments in audio file time: start_ms end_ms level_db\n";
+}
+
+// ---------------------------------------------------------------------
+
+std::string VoiceActivity::format(const Segment &s, int rate) {
+    char line[64];
+    snprintf(line, sizeof(line), "%lld %lld %.1f\n",
+             (long long)(s.start*1000/rate), (long long)(s.end*1000/rate),
+             s.level_db);
+    return line;
+}
+
+// ---------------------------------------------------------------------
+
+bool VoiceActivity::readIndex(const std::string &filename,
+                              std::vector<Segment> &out, int rate) {
+    std::ifstream in(filename.c_str());
+    if (!in)
+        return false;
+
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        long long start_ms, end_ms;
+        float level;
+        if (!(fields >> start_ms >> end_ms >> level))
+            continue;
+        Segment s = { start_ms*rate/1000, end_ms*rate/1000, level };
+        out.push_back(s);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,102 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef VOICEACTIVITY_H
+#define VOICEACTIVITY_H
+
+// Plain C++ so that the tools can use this without Qt.
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// Incremental voice-activity detection on 16-bit PCM.
+///
+/// Audio is mixed to mono and analysed in 20 ms frames.  Each frame
+/// has three features, all simple reductions over the frame that the
+/// compiler can vectorize: energy, spectral tilt (energy of the first
+/// difference relative to the energy, low for voiced speech and near
+/// 2 for white noise) and zero-crossing rate.  A frame is speech if
+/// its energy is well above an adaptive noise floor and the tilt and
+/// zero crossings look like speech.  Short gaps are bridged and very
+/// short bursts ignored, so the result is a list of segments.
+class VoiceActivity
+{
+public:
+    struct Segment {
+        /// Frame (sample) indices in the stream, end exclusive
+        int64_t start;
+        int64_t end;
+        /// Mean energy of the speech frames, dBFS
+        float level_db;
+    };
+
+    VoiceActivity(int rate);
+
+    /// Analyses interleaved frames and appends finished segments
+    void process(const int16_t *data, int frames, int channels,
+                 std::vector<Segment> &out);
+
+    /// Closes a segment still open at the end of the stream
+    void finish(std::vector<Segment> &out);
+
+    int rate() const { return rate_; }
+
+    /// Index files have a comment line and then one segment per line:
+    ///   start_ms end_ms level_db
+    static std::string header();
+    static std::string format(const Segment &s, int rate);
+    static bool readIndex(const std::string &filename,
+                          std::vector<Segment> &out, int rate);
+
+private:
+    void analyse(std::vector<Segment> &out);
+
+    int rate_;
+    int frame_len;
+    int hangover;
+    int min_length;
+
+    std::vector<float> frame;
+    int fill;
+    float prev;
+    int64_t position;
+
+    bool have_noise;
+    float noise_db;
+
+    bool in_speech;
+    int onset;
+    int64_t seg_start;
+    int64_t last_speech;
+    double level_sum;
+    int level_n;
+};
+
+#endif // VOICEACTIVITY_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,142 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSettings>
+#include <QTextStream>
+
+#include "volumes.h"
+#include "meetingdir.h"
+
+QMutex Volumes::mutex;
+QString Volumes::meeting_dir;
+QMap<QString, QString> Volumes::placed;
+QStringList Volumes::resolved;
+
+// ---------------------------------------------------------------------
+
+void Volumes::setMeeting(const QString &dir) {
+    QMutexLocker locker(&mutex);
+    meeting_dir = dir;
+    placed.clear();
+    resolved.clear();
+}
+
+// ---------------------------------------------------------------------
+
+QString Volumes::meeting() {
+    QMutexLocker locker(&mutex);
+    return meeting_dir;
+}
+
+// ---------------------------------------------------------------------
+
+QString Volumes::directory(const QString &stream) {
+    QMutexLocker locker(&mutex);
+    if (resolved.contains(stream))
+        return placed.value(stream, meeting_dir);
+    resolved << stream;
+
+    QSettings settings;
+    QString mount = settings.value("volumes/"+stream).toString();
+    if (mount.isEmpty() || meeting_dir.isEmpty())
+        return meeting_dir;
+
+    QString dir = QDir(mount).absoluteFilePath(QFileInfo(meeting_dir)
+                                               .fileName());
+    if (QFileInfo(dir).canonicalFilePath() ==
+        QFileInfo(meeting_dir).canonicalFilePath())
+        return meeting_dir;
+    if (!QDir(mount).exists() || !QDir(dir).mkpath(".")) {
+        qWarning() << "WARNING: Volume" << mount << "for" << stream
+                   << "is not usable, writing to" << meeting_dir;
+        return meeting_dir;
+    }
+
+    QFile back(dir+"/meeting.txt");
+    if (back.open(QIODevice::WriteOnly | QIODevice::Truncate |
+                  QIODevice::Text))
+        QTextStream(&back) << QDir(meeting_dir).absolutePath() << "\n";
+
+    QFile list(meeting_dir+"/volumes.txt");
+    if (list.open(QIODevice::WriteOnly | QIODevice::Append |
+                  QIODevice::Text))
+        QTextStream(&list) << stream << " " << dir << "\n";
+    else
+        qWarning() << "WARNING: Failed to open" << list.fileName();
+
+    qDebug() << "Volumes::directory():" << stream << "on" << dir;
+    placed[stream] = dir;
+    return dir;
+}
+
+// ---------------------------------------------------------------------
+
+QString Volumes::locate(const QString &stream, const QString &file) {
+    QMutexLocker locker(&mutex);
+    if (!placed.contains(stream))
+        return file;
+    return placed.value(stream)+"/"+file;
+}
+
+// ---------------------------------------------------------------------
+
+QStringList Volumes::directories() {
+    QMutexLocker locker(&mutex);
+    QStringList dirs;
+    if (!meeting_dir.isEmpty())
+        dirs << meeting_dir;
+    foreach (const QString &dir, placed)
+        if (!dirs.contains(dir))
+            dirs << dir;
+    return dirs;
+}
+
+// ---------------------------------------------------------------------
+
+QStringList Volumes::streamsIn(const QString &dir) {
+    QMutexLocker locker(&mutex);
+    return placed.keys(dir);
+}
+
+// ---------------------------------------------------------------------
+
+QStringList Volumes::directories(const QString &meeting) {
+    QStringList dirs;
+    std::vector<std::string> found =
+        MeetingDir::directories(meeting.toStdString());
+    for (size_t i = 0; i < found.size(); i++)
+        dirs << QString::fromStdString(found[i]);
+    return dirs;
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,84 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef VOLUMES_H
+#define VOLUMES_H
+
+#include <QMutex>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+/// Placement of the recording streams on output volumes.
+///
+/// By default every stream is written to the meeting directory.  A
+/// stream whose "volumes/<stream>" setting names a mount point, for
+/// example volumes/capture2=/media/ssd2, is written to a directory of
+/// the same name as the meeting directory on that volume instead, so
+/// that several cameras do not share the bandwidth of one disk.
+///
+/// The first time a volume directory is used, it gets a meeting.txt
+/// pointing back to the meeting directory, and the meeting directory
+/// a line "stream directory" in volumes.txt.  The tools find the
+/// scattered files of a meeting through these two files.
+class Volumes
+{
+public:
+    /// Forget the placements of the previous meeting
+    static void setMeeting(const QString &dir);
+    static QString meeting();
+
+    /// Directory for the files of a stream, created if needed.  Falls
+    /// back to the meeting directory if the volume is not usable.
+    static QString directory(const QString &stream);
+
+    /// How the manifest refers to a file of a stream: the bare name in
+    /// the meeting directory, the absolute path elsewhere
+    static QString locate(const QString &stream, const QString &file);
+
+    /// The meeting directory and the volume directories in use
+    static QStringList directories();
+
+    /// Streams placed in a directory, for the free space forecast
+    static QStringList streamsIn(const QString &dir);
+
+    /// The meeting directory and the volume directories listed in its
+    /// volumes.txt
+    static QStringList directories(const QString &meeting);
+
+private:
+    static QMutex mutex;
+    static QString meeting_dir;
+    /// stream -> directory, only streams outside the meeting directory
+    static QMap<QString, QString> placed;
+    /// streams already resolved
+    static QStringList resolved;
+};
+
+#endif // VOLUMES_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
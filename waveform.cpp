@@ -0,0 +1,346 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <math.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <fstream>
+#include <iterator>
+
+#include "waveform.h"
+
+using namespace Waveform;
+
+static const char Magic[8] = { 'M', 'R', 'W', 'A', 'V', 'P', 'K', '1' };
+
+// ---------------------------------------------------------------------
+
+// Combines n equal-rate bins, weighting the RMS by the frames in each
+static WaveformBin combine(const WaveformBin *bins, const int *counts,
+                           int n, int stride) {
+    WaveformBin out = { 0, 0, 0 };
+    double sumsq = 0.0;
+    int total = 0;
+    for (int i = 0; i < n; ++i) {
+        const WaveformBin &b = bins[i*stride];
+        if (!counts[i])
+            continue;
+        if (!total || b.min < out.min)
+            out.min = b.min;
+        if (!total || b.max > out.max)
+            out.max = b.max;
+        sumsq += double(b.rms)*b.rms*counts[i];
+        total += counts[i];
+    }
+    if (total)
+        out.rms = uint16_t(sqrt(sumsq/total)+0.5);
+    return out;
+}
+
+// ---------------------------------------------------------------------
+
+WaveformWriter::WaveformWriter(int r, int c) : rate(r), channels(c),
+                                               file(NULL), frames_(0),
+                                               cur_min(c), cur_max(c),
+                                               cur_sumsq(c), cur_n(0),
+                                               block_bins(0)
+{
+    int bins = BlockFrames/SamplesPerBin[0];
+    block.resize(bins*channels);
+    block_n.resize(bins);
+}
+
+// ---------------------------------------------------------------------
+
+WaveformWriter::~WaveformWriter() {
+    close();
+}
+
+// ---------------------------------------------------------------------
+
+bool WaveformWriter::open(const std::string &filename) {
+    file = fopen(filename.c_str(), "wb");
+    if (!file)
+        return false;
+    frames_ = 0;
+    cur_n = 0;
+    block_bins = 0;
+    return writeHeader();
+}
+
+// ---------------------------------------------------------------------
+
+bool WaveformWriter::process(const int16_t *data, int frames) {
+    if (!file)
+        return false;
+
+    for (int i = 0; i < frames; ++i) {
+        const int16_t *x = data+i*channels;
+        if (cur_n == 0) {
+            for (int c = 0; c < channels; ++c) {
+                cur_min[c] = cur_max[c] = x[c];
+                cur_sumsq[c] = 0.0;
+            }
+        }
+        for (int c = 0; c < channels; ++c) {
+            if (x[c] < cur_min[c])
+                cur_min[c] = x[c];
+            if (x[c] > cur_max[c])
+                cur_max[c] = x[c];
+            cur_sumsq[c] += double(x[c])*x[c];
+        }
+        frames_++;
+        if (++cur_n == SamplesPerBin[0]) {
+            closeBin();
+            if (block_bins == BlockFrames/SamplesPerBin[0] && !writeBlock())
+                return false;
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+void WaveformWriter::closeBin() {
+    for (int c = 0; c < channels; ++c) {
+        WaveformBin &b = block[block_bins*channels+c];
+        b.min = cur_min[c];
+        b.max = cur_max[c];
+        b.rms = uint16_t(sqrt(cur_sumsq[c]/cur_n)+0.5);
+    }
+    block_n[block_bins++] = cur_n;
+    cur_n = 0;
+}
+
+// ---------------------------------------------------------------------
+
+// Level 0 as collected, then each coarser level from the one below
+bool WaveformWriter::writeBlock() {
+    int n0 = BlockFrames/SamplesPerBin[0];
+    for (int i = block_bins; i < n0; ++i) {
+        memset(&block[i*channels], 0, channels*sizeof(WaveformBin));
+        block_n[i] = 0;
+    }
+    std::vector<WaveformBin> out(block);
+
+    std::vector<WaveformBin> below(block);
+    std::vector<int> below_n(block_n);
+    for (int level = 1; level < Levels; ++level) {
+        int group = SamplesPerBin[level]/SamplesPerBin[level-1];
+        int n = BlockFrames/SamplesPerBin[level];
+        std::vector<WaveformBin> bins(n*channels);
+        std::vector<int> bins_n(n);
+        for (int i = 0; i < n; ++i) {
+            for (int c = 0; c < channels; ++c)
+                bins[i*channels+c] = combine(&below[i*group*channels+c],
+                                             &below_n[i*group], group,
+                                             channels);
+            for (int j = 0; j < group; ++j)
+                bins_n[i] += below_n[i*group+j];
+        }
+        out.insert(out.end(), bins.begin(), bins.end());
+        below.swap(bins);
+        below_n.swap(bins_n);
+    }
+
+    block_bins = 0;
+    if (fwrite(&out[0], sizeof(WaveformBin), out.size(), file) != out.size())
+        return false;
+    return writeHeader();
+}
+
+// ---------------------------------------------------------------------
+
+bool WaveformWriter::writeHeader() {
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, Magic, sizeof(h.magic));
+    h.version = 1;
+    h.header_bytes = sizeof(Header);
+    h.rate = rate;
+    h.channels = channels;
+    h.levels = Levels;
+    h.block_frames = BlockFrames;
+    for (int i = 0; i < Levels; ++i) {
+        h.samples_per_bin[i] = SamplesPerBin[i];
+        h.bins_per_block[i] = BlockFrames/SamplesPerBin[i];
+    }
+    // Only frames in written blocks are valid:
+    h.frames = frames_-block_bins*SamplesPerBin[0]-cur_n;
+
+    long end = ftell(file);
+    if (fseek(file, 0, SEEK_SET) || fwrite(&h, sizeof(h), 1, file) != 1)
+        return false;
+    if (end > long(sizeof(h)) && fseek(file, end, SEEK_SET))
+        return false;
+    return fflush(file) == 0;
+}
+
+// ---------------------------------------------------------------------
+
+bool WaveformWriter::close() {
+    if (!file)
+        return true;
+    if (cur_n)
+        closeBin();
+    bool ok = true;
+    if (block_bins)
+        ok = writeBlock();
+    ok = writeHeader() && ok;
+    ok = fclose(file) == 0 && ok;
+    file = NULL;
+    return ok;
+}
+
+// ---------------------------------------------------------------------
+
+WaveformReader::WaveformReader() : data(NULL), size(0), mapped(false),
+                                   header(NULL), block_bytes(0)
+{
+}
+
+// ---------------------------------------------------------------------
+
+WaveformReader::~WaveformReader() {
+    close();
+}
+
+// ---------------------------------------------------------------------
+
+bool WaveformReader::open(const std::string &filename) {
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= off_t(sizeof(Header))) {
+        void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            data = static_cast<const uint8_t*>(p);
+            size = st.st_size;
+            mapped = true;
+        }
+    }
+    ::close(fd);
+#endif
+
+    if (!data) {
+        std::ifstream in(filename.c_str(), std::ios::binary);
+        if (!in)
+            return false;
+        copy.assign(std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>());
+        if (copy.empty())
+            return false;
+        data = &copy[0];
+        size = copy.size();
+    }
+
+    header = reinterpret_cast<const Header*>(data);
+    if (size < sizeof(Header) || memcmp(header->magic, Magic, 8) ||
+        header->version != 1 || header->levels != unsigned(Levels) ||
+        header->channels == 0) {
+        close();
+        return false;
+    }
+
+    size_t bin_bytes = header->channels*sizeof(WaveformBin);
+    block_bytes = 0;
+    for (int i = 0; i < Levels; ++i) {
+        level_offset[i] = block_bytes;
+        block_bytes += header->bins_per_block[i]*bin_bytes;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+void WaveformReader::close() {
+#ifndef _WIN32
+    if (mapped)
+        munmap(const_cast<uint8_t*>(data), size);
+#endif
+    data = NULL;
+    size = 0;
+    mapped = false;
+    header = NULL;
+    copy.clear();
+}
+
+// ---------------------------------------------------------------------
+
+int64_t WaveformReader::frames() const {
+    if (!header)
+        return 0;
+    // Also limited by what was mapped, the writer may be ahead:
+    int64_t blocks = (size-header->header_bytes)/block_bytes;
+    int64_t frames = int64_t(header->frames);
+    return frames < blocks*header->block_frames ? frames :
+        blocks*header->block_frames;
+}
+
+// ---------------------------------------------------------------------
+
+int64_t WaveformReader::bins(int level) const {
+    if (!header || level < 0 || level >= Levels)
+        return 0;
+    int64_t spb = header->samples_per_bin[level];
+    return (frames()+spb-1)/spb;
+}
+
+// ---------------------------------------------------------------------
+
+const WaveformBin *WaveformReader::bin(int level, int64_t index) const {
+    if (index < 0 || index >= bins(level))
+        return NULL;
+    int64_t per_block = header->bins_per_block[level];
+    size_t offset = header->header_bytes+
+        (index/per_block)*block_bytes+level_offset[level]+
+        (index%per_block)*header->channels*sizeof(WaveformBin);
+    return reinterpret_cast<const WaveformBin*>(data+offset);
+}
+
+// ---------------------------------------------------------------------
+
+int WaveformReader::levelFor(int64_t max_bins) const {
+    for (int level = 0; level < Levels; ++level)
+        if (bins(level) <= max_bins)
+            return level;
+    return Levels-1;
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,163 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+// Plain C++ so that the tools can use this without Qt.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/// Multi-resolution waveform summary of a recording.
+///
+/// Each bin holds the minimum, maximum and RMS of one channel over
+/// 256, 4096 or 65536 sample frames (levels 0, 1 and 2).  The file is
+/// written incrementally in blocks of 65536 frames, each holding that
+/// span of all three levels:
+///
+///   header (64 bytes, see Header)
+///   block 0: 256 level-0 bins, 16 level-1 bins, 1 level-2 bin
+///   block 1: ...
+///
+/// where every bin is channels*WaveformBin.  Blocks have a fixed size,
+/// so any bin is found by arithmetic and the whole file can be mapped
+/// into memory; drawing a whole meeting at level 2 reads one bin per
+/// block.  The last block is zero-padded.  All values are little
+/// endian.
+struct WaveformBin {
+    int16_t min;
+    int16_t max;
+    /// RMS scaled like the samples, 0-32767
+    uint16_t rms;
+};
+
+namespace Waveform {
+    const int Levels = 3;
+    const int BlockFrames = 65536;
+    const int SamplesPerBin[Levels] = { 256, 4096, 65536 };
+
+    struct Header {
+        char magic[8];          // "MRWAVPK1"
+        uint32_t version;       // 1
+        uint32_t header_bytes;  // 64
+        uint32_t rate;
+        uint32_t channels;
+        uint32_t levels;
+        uint32_t block_frames;
+        uint32_t samples_per_bin[Levels];
+        uint32_t bins_per_block[Levels];
+        /// Valid frames, updated after every block
+        uint64_t frames;
+    };
+}
+
+// ---------------------------------------------------------------------
+
+/// Builds the file while recording
+class WaveformWriter
+{
+public:
+    WaveformWriter(int rate, int channels);
+    ~WaveformWriter();
+
+    bool open(const std::string &filename);
+    bool isOpen() const { return file != NULL; }
+
+    /// Interleaved frames; complete blocks are written at once
+    bool process(const int16_t *data, int frames);
+
+    /// Writes the partial last block and the final header
+    bool close();
+
+    int64_t frames() const { return frames_; }
+
+private:
+    void closeBin();
+    bool writeBlock();
+    bool writeHeader();
+
+    int rate;
+    int channels;
+    FILE *file;
+    int64_t frames_;
+
+    // Level-0 bin being filled, per channel
+    std::vector<int16_t> cur_min, cur_max;
+    std::vector<double> cur_sumsq;
+    int cur_n;
+
+    // Level-0 bins of the current block and their frame counts
+    std::vector<WaveformBin> block;
+    std::vector<int> block_n;
+    int block_bins;
+};
+
+// ---------------------------------------------------------------------
+
+/// Reads a file, mapped into memory where possible.  A file that is
+/// still being written can be opened; frames() tells how much of it
+/// is valid.
+class WaveformReader
+{
+public:
+    WaveformReader();
+    ~WaveformReader();
+
+    bool open(const std::string &filename);
+    void close();
+
+    int rate() const { return header ? header->rate : 0; }
+    int channels() const { return header ? header->channels : 0; }
+    int64_t frames() const;
+
+    /// Number of bins on a level
+    int64_t bins(int level) const;
+
+    /// Bins of all channels at index on the level, NULL if out of
+    /// range
+    const WaveformBin *bin(int level, int64_t index) const;
+
+    /// Finest level with no more than max_bins bins
+    int levelFor(int64_t max_bins) const;
+
+private:
+    const uint8_t *data;
+    size_t size;
+    bool mapped;
+    std::vector<uint8_t> copy;
+    const Waveform::Header *header;
+
+    size_t block_bytes;
+    size_t level_offset[Waveform::Levels];
+};
+
+#endif // WAVEFORM_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,84 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDebug>
+#include <QFile>
+#include <QElapsedTimer>
+
+#include "waveformthread.h"
+#include "metrics.h"
+
+// ---------------------------------------------------------------------
+
+WaveformThread::WaveformThread(const QString &st, const QString &dir,
+                               int r, int c, qint64 max)
+    : AudioSinkThread(st, "peaks", r, c, max),
+      filename(dir+"/"+st+".peaks"), writer(r, c), window_us(0)
+{
+}
+
+// ---------------------------------------------------------------------
+
+// Like the speech index, the pyramid can be rebuilt from the audio,
+// so errors are only logged.
+void WaveformThread::begin() {
+    if (!writer.open(QFile::encodeName(filename).constData()))
+        qWarning() << "WARNING: Failed to open" << filename;
+}
+
+// ---------------------------------------------------------------------
+
+bool WaveformThread::consume(const qint16 *data, int frames) {
+    if (!writer.isOpen())
+        return true;
+    QElapsedTimer timer;
+    timer.start();
+    if (!writer.process(data, frames)) {
+        qWarning() << "WARNING: Failed to write" << filename;
+        writer.close();
+    }
+    window_us += timer.nsecsElapsed()/1000;
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+void WaveformThread::end() {
+    if (writer.isOpen() && !writer.close())
+        qWarning() << "WARNING: Failed to close" << filename;
+    report(0);
+}
+
+// ---------------------------------------------------------------------
+
+void WaveformThread::report(qint64) {
+    Metrics::set(stream+".peaks_us", window_us);
+    window_us = 0;
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
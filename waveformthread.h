@@ -0,0 +1,59 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef WAVEFORMTHREAD_H
+#define WAVEFORMTHREAD_H
+
+#include "audiosink.h"
+#include "waveform.h"
+
+/// Maintains the waveform pyramid <stream>.peaks of a recorded stream.
+/// Blocks dropped from the queue arrive as silence, so the peaks stay
+/// aligned with the file.
+class WaveformThread : public AudioSinkThread
+{
+    Q_OBJECT
+
+public:
+    WaveformThread(const QString &stream, const QString &directory,
+                   int rate, int channels, qint64 max_bytes);
+
+protected:
+    void begin();
+    bool consume(const qint16 *data, int frames);
+    void end();
+    void report(qint64 backlog);
+
+private:
+    QString filename;
+    WaveformWriter writer;
+    qint64 window_us;
+};
+
+#endif // WAVEFORMTHREAD_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,178 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <QDataStream>
+#include <QDebug>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+#include "wavwriter.h"
+
+// ---------------------------------------------------------------------
+
+WavWriter::WavWriter() : rate(0), channels(0), bits(0), is_float(false),
+                         data_bytes(0), rf64(false), flush_ms(0)
+{
+}
+
+// ---------------------------------------------------------------------
+
+WavWriter::~WavWriter() {
+    close();
+}
+
+// ---------------------------------------------------------------------
+
+bool WavWriter::open(const QString &filename, int r, int c, int b, bool f) {
+    close();
+    rate = r;
+    channels = c;
+    bits = b;
+    is_float = f;
+    data_bytes = 0;
+    rf64 = false;
+
+    file.setFileName(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "WARNING: WavWriter failed to open" << filename
+                   << file.errorString();
+        return false;
+    }
+    // Written in place first, later updates are positional:
+    file.write(QByteArray(HeaderBytes, 0));
+    since_flush.start();
+    return writeHeader();
+}
+
+// ---------------------------------------------------------------------
+
+bool WavWriter::isOpen() const {
+    return file.isOpen();
+}
+
+// ---------------------------------------------------------------------
+
+bool WavWriter::write(const char *data, qint64 bytes) {
+    if (!file.isOpen())
+        return false;
+    qint64 n = file.write(data, bytes);
+    if (n > 0)
+        data_bytes += n;
+    if (n != bytes)
+        return false;
+    if (flush_ms > 0 && since_flush.elapsed() >= flush_ms)
+        return flush();
+    return true;
+}
+
+// ---------------------------------------------------------------------
+
+// The data goes to the OS before the sizes that cover it
+bool WavWriter::flush() {
+    if (!file.isOpen())
+        return false;
+    since_flush.restart();
+    return file.flush() && writeHeader();
+}
+
+// ---------------------------------------------------------------------
+
+void WavWriter::close() {
+    if (!file.isOpen())
+        return;
+    flush();
+    file.close();
+}
+
+// ---------------------------------------------------------------------
+
+QString WavWriter::errorString() const {
+    return file.errorString();
+}
+
+// ---------------------------------------------------------------------
+
+// RIFF (or RF64) header with a 28-byte JUNK (or ds64) chunk, fmt and
+// the data chunk header:
+//
+//    0 RIFF/RF64 size WAVE
+//   12 JUNK/ds64 28: riff size, data size, sample count (64 bits each),
+//                    table length
+//   48 fmt 16: ...
+//   72 data size
+bool WavWriter::writeHeader() {
+    qint64 riff_bytes = HeaderBytes-8+data_bytes;
+    rf64 = rf64 || riff_bytes > 0xffffffffLL;
+
+    QByteArray header;
+    QDataStream out(&header, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.writeRawData(rf64 ? "RF64" : "RIFF", 4);
+    out << quint32(rf64 ? 0xffffffffU : quint32(riff_bytes));
+    out.writeRawData("WAVE", 4);
+
+    out.writeRawData(rf64 ? "ds64" : "JUNK", 4);
+    out << quint32(28);
+    out << quint64(rf64 ? riff_bytes : 0);
+    out << quint64(rf64 ? data_bytes : 0);
+    out << quint64(rf64 && frameBytes() ? data_bytes/frameBytes() : 0);
+    out << quint32(0);
+
+    out.writeRawData("fmt ", 4);
+    out << quint32(16);
+    out << quint16(is_float ? 3 : 1);
+    out << quint16(channels);
+    out << quint32(rate);
+    out << quint32(rate*frameBytes());
+    out << quint16(frameBytes());
+    out << quint16(bits);
+    out.writeRawData("data", 4);
+    out << quint32(rf64 ? 0xffffffffU : quint32(data_bytes));
+
+    return writeAt(0, header);
+}
+
+// ---------------------------------------------------------------------
+
+bool WavWriter::writeAt(qint64 offset, const QByteArray &data) {
+#ifdef Q_OS_UNIX
+    // Buffered data must be out first, file.pos() is not touched:
+    if (!file.flush())
+        return false;
+    return pwrite(file.handle(), data.constData(), data.size(),
+                  offset) == data.size();
+#else
+    qint64 pos = file.pos();
+    bool ok = file.seek(offset) && file.write(data) == data.size();
+    return file.seek(pos) && ok;
+#endif
+}
+
+// ---------------------------------------------------------------------
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
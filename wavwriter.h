@@ -0,0 +1,86 @@
+/*
+  Copyright (c) 2015-2016 University of Helsinki
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef WAVWRITER_H
+#define WAVWRITER_H
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+/// Writes interleaved PCM to a WAV file.
+///
+/// The header has room for an RF64 ds64 chunk (as a JUNK chunk until
+/// needed), so a file that grows past 4 GiB is turned into RF64 in
+/// place.  Every flush interval the buffered data is handed to the
+/// OS and the size fields are rewritten with positional writes, so a
+/// file cut short by a crash is readable up to the last flush.
+class WavWriter
+{
+public:
+    WavWriter();
+    ~WavWriter();
+
+    /// bits is 8, 16 or 32 for integer samples, float for 32-bit float
+    bool open(const QString &filename, int rate, int channels, int bits,
+              bool is_float = false);
+    bool isOpen() const;
+    bool write(const char *data, qint64 bytes);
+    void close();
+
+    /// How often the sizes are made valid on disk, 0 only at close
+    void setFlushInterval(int ms) { flush_ms = ms; }
+    bool flush();
+
+    QString errorString() const;
+    qint64 dataBytes() const { return data_bytes; }
+    int frameBytes() const { return channels*bits/8; }
+    bool isRF64() const { return rf64; }
+
+    /// Bytes before the samples
+    static const int HeaderBytes = 80;
+
+private:
+    bool writeHeader();
+    bool writeAt(qint64 offset, const QByteArray &data);
+
+    QFile file;
+    int rate;
+    int channels;
+    int bits;
+    bool is_float;
+    qint64 data_bytes;
+    bool rf64;
+
+    int flush_ms;
+    QElapsedTimer since_flush;
+};
+
+#endif // WAVWRITER_H
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End: